@@ -64,32 +64,29 @@
 // Include Arduino header
 #include "Arduino.h"
 
+// Shared board defaults and log()
+#include "bRESTConfig.h"
+
+// String source shared with bREST
+#include "bRESTRequest.h"
+
 // MQTT packet size
 #undef MQTT_MAX_PACKET_SIZE
 #define MQTT_MAX_PACKET_SIZE 512
 
-// Using ESP8266 ?
-#if defined(ESP8266) || defined(ESP32)
-#include "stdlib_noniso.h"
-#endif
-
 // Which board?
 #if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__) || defined(CORE_WILDFIRE) || defined(ESP8266) || defined(ESP32)
 #define NUMBER_ANALOG_PINS 16
 #define NUMBER_DIGITAL_PINS 54
-#define OUTPUT_BUFFER_SIZE 2000
 #elif defined(__AVR_ATmega328P__) && !defined(ADAFRUIT_CC3000_H)
 #define NUMBER_ANALOG_PINS 6
 #define NUMBER_DIGITAL_PINS 14
-#define OUTPUT_BUFFER_SIZE 350
 #elif defined(ADAFRUIT_CC3000_H)
 #define NUMBER_ANALOG_PINS 6
 #define NUMBER_DIGITAL_PINS 14
-#define OUTPUT_BUFFER_SIZE 275
 #else
 #define NUMBER_ANALOG_PINS 6
 #define NUMBER_DIGITAL_PINS 14
-#define OUTPUT_BUFFER_SIZE 350
 #endif
 
 // Hardware data
@@ -108,6 +105,15 @@
 // Subscriptions
 #define NUMBER_SUBSCRIPTIONS 4
 
+// Size of command token between slashes, i.e. function name and its arguments. Longer tokens are cut.
+#ifndef ANSWER_SIZE
+  #if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__) || defined(CORE_WILDFIRE) || defined(ESP8266) || defined(ESP32)
+  #define ANSWER_SIZE 128
+  #else
+  #define ANSWER_SIZE 48
+  #endif
+#endif
+
 // Debug mode
 #ifndef DEBUG_MODE
 #define DEBUG_MODE 0
@@ -136,57 +142,6 @@
   #endif
 #endif
 
-// Enable it if print out bREST debug message. Default is disable.
-#ifndef DEBUG
-#define DEBUG                   0
-#endif
-
-// Enable it if print out Observer sub class debug message. Default is disable.
-#ifndef APP_DEBUG
-#define APP_DEBUG               0
-#endif
-
-static void log(String formatString,...) {
-#if APP_DEBUG
-
-    int i, j, count = 0;
-    va_list argv;
-    const char* fmt = formatString.c_str();
-    va_start(argv, formatString);
-    for(i = 0, j = 0; fmt[i] != '\0'; i++) {
-        if (fmt[i] == '%') {
-            count++;
-
-            Serial.write(reinterpret_cast<const uint8_t*>(fmt+j), i-j);
-
-            switch (fmt[++i]) {
-                case 'd': Serial.print(va_arg(argv, int));
-                    break;
-                case 'l': Serial.print(va_arg(argv, long));
-                    break;
-                case 'f': Serial.print(va_arg(argv, double));
-                    break;
-                case 'c': Serial.print((char) va_arg(argv, int));
-                    break;
-                case 's': Serial.print(va_arg(argv, char *));
-                    break;
-                case '%': Serial.print("%");
-                    break;
-                default:;
-            };
-
-            j = i+1;
-        }
-    };
-    va_end(argv);
-
-    if(i > j) {
-        Serial.write(reinterpret_cast<const uint8_t*>(fmt+j), i-j);
-    }
-
-#endif
-}
-
 class aREST {
 
 protected:
@@ -208,7 +163,13 @@ struct TypedVariable: Variable {
 
 public:
 
-aREST() {
+// Output buffer is owned by sub class, so that its size can be chosen per instance
+aREST(char* output_buffer, uint16_t output_buffer_size) {
+
+  buffer = output_buffer;
+  buffer_size = output_buffer_size;
+  owns_buffer = false;
+  reset_answer();
 
   command = 'u';
   pin_selected = false;
@@ -218,7 +179,12 @@ aREST() {
 
 }
 
-aREST(char* rest_remote_server, int rest_port) {
+aREST(char* output_buffer, uint16_t output_buffer_size, char* rest_remote_server, int rest_port) {
+
+  buffer = output_buffer;
+  buffer_size = output_buffer_size;
+  owns_buffer = false;
+  reset_answer();
 
   command = 'u';
   pin_selected = false;
@@ -231,7 +197,24 @@ aREST(char* rest_remote_server, int rest_port) {
 
 }
 
-virtual ~aREST() {}
+// Output buffer of OUTPUT_BUFFER_SIZE is allocated from heap once, as aREST did before buffers were sized per instance
+aREST(): aREST(new char[OUTPUT_BUFFER_SIZE], (uint16_t)OUTPUT_BUFFER_SIZE) {
+  owns_buffer = true;
+}
+
+aREST(char* rest_remote_server, int rest_port):
+  aREST(new char[OUTPUT_BUFFER_SIZE], (uint16_t)OUTPUT_BUFFER_SIZE, rest_remote_server, rest_port) {
+  owns_buffer = true;
+}
+
+// Output buffer is not copied
+aREST(const aREST& other) = delete;
+aREST& operator=(const aREST& other) = delete;
+
+virtual ~aREST() {
+  if (owns_buffer)
+    delete[] buffer;
+}
 
 template<typename T>
 void variable(const char *name, T *var) { 
@@ -250,7 +233,12 @@ void variable(const char *name, T *var) {
 #if defined(PubSubClient_h)
 
 // With default server
-aREST(PubSubClient& client) {
+aREST(char* output_buffer, uint16_t output_buffer_size, PubSubClient& client) {
+
+  buffer = output_buffer;
+  buffer_size = output_buffer_size;
+  owns_buffer = false;
+  reset_answer();
 
   command = 'u';
   pin_selected = false;
@@ -264,7 +252,12 @@ aREST(PubSubClient& client) {
 }
 
 // With another server
-aREST(PubSubClient& client, char* new_mqtt_server) {
+aREST(char* output_buffer, uint16_t output_buffer_size, PubSubClient& client, char* new_mqtt_server) {
+
+  buffer = output_buffer;
+  buffer_size = output_buffer_size;
+  owns_buffer = false;
+  reset_answer();
 
   command = 'u';
   pin_selected = false;
@@ -278,6 +271,17 @@ aREST(PubSubClient& client, char* new_mqtt_server) {
 
 }
 
+// With default server and output buffer from heap
+aREST(PubSubClient& client): aREST(new char[OUTPUT_BUFFER_SIZE], (uint16_t)OUTPUT_BUFFER_SIZE, client) {
+  owns_buffer = true;
+}
+
+// With another server and output buffer from heap
+aREST(PubSubClient& client, char* new_mqtt_server):
+  aREST(new char[OUTPUT_BUFFER_SIZE], (uint16_t)OUTPUT_BUFFER_SIZE, client, new_mqtt_server) {
+  owns_buffer = true;
+}
+
 // Get topic
 char* get_topic() {
   return out_topic;
@@ -387,7 +391,7 @@ void addToBufferF(const __FlashStringHelper *toAdd){
   PGM_P p = reinterpret_cast<PGM_P>(toAdd);
 
   for ( unsigned char c = pgm_read_byte(p++);
-        c != 0 && index < OUTPUT_BUFFER_SIZE;
+        c != 0 && index < buffer_size;
         c = pgm_read_byte(p++), index++) {
     buffer[index] = c;
   }
@@ -411,7 +415,7 @@ virtual void reset_status() {
     #endif
   }
 
-  answer = "";
+  reset_answer();
   command = 'u';
   pin_selected = false;
   state = 'u';
@@ -745,29 +749,11 @@ void handle(char * string) {
 }
 
 void handle_proto(char * string) {
-#if DEBUG
-  log("aREST::handle_proto -- scanning proto string...\n");
-#endif
-  // Check if there is data available to read
-  for (int i = 0; i < strlen(string); i++){
 
-    char c = string[i];
-    answer = answer + c;
+  // Strings take the same path as clients and serial ports
+  bRESTStringSource source(string);
+  handle_proto(source, false, 0, false);
 
-    // Process data
-    process(c);
-
-  }
-
-#if DEBUG
-  log("aREST::handle_proto -- finished scanning proto string!\n");
-  log("aREST::handle_proto -- sending command...\n");
-#endif
-  // Send command
-  send_command(false, false);
-#if DEBUG
-  log("aREST::handle_proto -- sent command!\n");
-#endif
 }
 
 template <typename T, typename V>
@@ -808,7 +794,7 @@ void handle_proto(T& serial, bool headers, uint8_t read_delay, bool decode)
     char c = serial.read();
     if (0 != read_delay)
         delay(read_delay);
-    //answer = answer + c;
+    append_answer(c);
 
     // Process data
     process(c);
@@ -831,27 +817,24 @@ void handle_proto(T& serial, bool headers, uint8_t read_delay, bool decode)
 // Process callback
 void handle_callback(PubSubClient& client, char* topic, byte* payload, unsigned int length) {
 
-  // Process received message
-  int i;
+  // Process received message. aREST processes a command token by token at each '/', so terminate it with " /".
   char mqtt_msg[100];
-  for(i = 0; i < length; i++) {
-    mqtt_msg[i] = payload[i];
+  if (length > sizeof(mqtt_msg) - 3) {
+    if (DEBUG_MODE) {
+      Serial.println(F("MQTT message is too long, dropped"));
+    }
+    return;
   }
-  mqtt_msg[i] = '\0';
-  String msgString = String(mqtt_msg);
+  memcpy(mqtt_msg, payload, length);
+  strcpy(mqtt_msg + length, " /");
 
   if (DEBUG_MODE) {
     Serial.print("Received message via MQTT: ");
-    Serial.println(msgString);
+    Serial.println(mqtt_msg);
   }
 
-  // Process aREST commands
-    String modified_message = String(msgString) + " /";
-    char char_message[100];
-    modified_message.toCharArray(char_message, 100);
-
     // Handle command with aREST
-    handle(char_message);
+    handle(mqtt_msg);
 
     // Read answer
     char * answer = getBuffer();
@@ -861,42 +844,14 @@ void handle_callback(PubSubClient& client, char* topic, byte* payload, unsigned
       Serial.print("Sending message via MQTT: ");
       Serial.println(answer);
       Serial.print("Size of MQTT message: ");
-      Serial.println(strlen(answer));
-      Serial.print("Size of client ID: ");
-      Serial.println(client_id.length());
+      Serial.println(index);
     }
 
-    int max_message_size = 128 - 20 - client_id.length();
-
-    if (strlen(answer) < max_message_size) {
-      client.publish(out_topic, answer);
+    // Send answer as one message. It is streamed to the network, past the packet buffer of PubSubClient.
+    if (index <= mqtt_max_message_size && client.beginPublish(out_topic, index, false)) {
+      client.write((const uint8_t*)answer, index);
+      client.endPublish();
     }
-    else {
-
-      // Max iteration
-      uint8_t max_iteration = (int)(strlen(answer)/max_message_size) + 1;
-
-      // Send data
-      for (uint8_t i = 0; i < max_iteration; i++) {
-        char intermediate_buffer[max_message_size+1];
-        memcpy(intermediate_buffer, buffer + i*max_message_size, max_message_size);
-        intermediate_buffer[max_message_size] = '\0';
-
-        if (DEBUG_MODE) {
-          Serial.print("Intermediate buffer: ");
-          Serial.println(intermediate_buffer);
-          Serial.print("Intermediate buffer size: ");
-          Serial.println(strlen(intermediate_buffer));
-        }
-
-        client.publish(out_topic, intermediate_buffer);
-
-    }
-
-   }
-
-    // Send message
-    // client.publish(out_topic, answer);
 
     // Reset buffer
     resetBuffer();
@@ -997,7 +952,7 @@ virtual void process(char c){
        if (answer[0] == 'r') {state = 'r';}
 
        // If not, get value we want to apply to the pin
-       else {value = answer.toInt(); state = 'w';}
+       else {value = atoi(answer); state = 'w';}
      }
 
      // If analog command has been selected, process the data accordingly
@@ -1007,7 +962,7 @@ virtual void process(char c){
        if (answer[0] == 'r') {state = 'r';}
 
        // Else, write analog value
-       else {value = answer.toInt(); state = 'w';}
+       else {value = atoi(answer); state = 'w';}
      }
 
      // If the command is already selected, get the pin
@@ -1018,7 +973,7 @@ virtual void process(char c){
          pin = 14 + answer[1] - '0';
        }
        else {
-         pin = answer.toInt();
+         pin = atoi(answer);
        }
 
        // Save pin for message
@@ -1066,13 +1021,13 @@ virtual void process(char c){
    }
 
      // Digital command received ?
-     if (answer.startsWith("digital")) {command = 'd';}
+     if (answer_starts_with("digital")) {command = 'd';}
 
      // Mode command received ?
-     if (answer.startsWith("mode")) {command = 'm';}
+     if (answer_starts_with("mode")) {command = 'm';}
 
      // Analog command received ?
-     if (answer.startsWith("analog")) {
+     if (answer_starts_with("analog")) {
       command = 'a';
 
       #if defined(ESP8266)
@@ -1086,7 +1041,7 @@ virtual void process(char c){
 
        // Check if variable name is in int array
        for (uint8_t i = 0; i < variables_index; i++){
-         if(answer.startsWith(variable_names[i])) {
+         if(answer_starts_with(variable_names[i])) {
 
            // End here
            pin_selected = true;
@@ -1102,7 +1057,7 @@ virtual void process(char c){
 
        // Check if function name is in array
        for (uint8_t i = 0; i < functions_index; i++){
-         if(answer.startsWith(functions_names[i])) {
+         if(answer_starts_with(functions_names[i])) {
 
            // End here
            pin_selected = true;
@@ -1115,11 +1070,15 @@ virtual void process(char c){
            // Get command
            arguments = "";
            uint8_t header_length = strlen(functions_names[i]);
-           if (answer.substring(header_length, header_length + 1) == "?") {
-             uint8_t footer_start = answer.length();
-             if (answer.endsWith(" HTTP/"))
+           if (answer[header_length] == '?') {
+             uint16_t footer_start = answer_length;
+             if (footer_start >= 6 && 0 == strcmp(answer + footer_start - 6, " HTTP/"))
                footer_start -= 6; // length of " HTTP/"
-             arguments = answer.substring(header_length + 8, footer_start);
+             // skip "?params="
+             if (header_length + 8 < footer_start) {
+               answer[footer_start] = '\0';
+               arguments = answer + header_length + 8;
+             }
            }
 
            break;   // We found what we're looking for
@@ -1160,10 +1119,28 @@ virtual void process(char c){
 
      }
 
-     answer = "";
+     reset_answer();
     }
 }
 
+// Append one character to the current token, without heap
+void append_answer(char c) {
+  if (answer_length < ANSWER_SIZE) {
+    answer[answer_length++] = c;
+    answer[answer_length] = '\0';
+  }
+}
+
+// Short tokens read as padded with NUL, as String did
+void reset_answer() {
+  answer_length = 0;
+  memset(answer, 0, 4);
+}
+
+bool answer_starts_with(const char* prefix) {
+  return 0 == strncmp(answer, prefix, strlen(prefix));
+}
+
 
 // Modifies arguments in place
 void urldecode(String &arguments) {
@@ -1607,15 +1584,15 @@ void removeLastBufferChar() {
 
 
 void addQuote() {
-  if(index < OUTPUT_BUFFER_SIZE) {
+  if(index < buffer_size) {
     buffer[index] = '\"';
     index++;
   }  
 }
 
 void addToBufferFromSerialPort(const char * toAdd) {
-    for (int i = 0; i < strlen(toAdd) && index < OUTPUT_BUFFER_SIZE; i++, index++)
-      buffer[index] = toAdd[i];
+    for (; *toAdd != '\0' && index < buffer_size; toAdd++, index++)
+      buffer[index] = *toAdd;
 }
 
 // Add to output buffer
@@ -1635,16 +1612,16 @@ void addToBuffer(const char * toAdd, bool quotable){
     addQuote();
   }
 
-  for (int i = 0; i < strlen(toAdd) && index < OUTPUT_BUFFER_SIZE; i++, index++) {
+  for (; *toAdd != '\0' && index < buffer_size; toAdd++, index++) {
     // Handle quoting quotes and backslashes
-    if(toAdd[i] == '"' || toAdd[i] == '\\') {
-      if(index == OUTPUT_BUFFER_SIZE - 1)   // No room!
+    if(*toAdd == '"' || *toAdd == '\\') {
+      if(index == buffer_size - 1)   // No room!
         return;
       buffer[index] = '\\';
       index++;
     }
 
-    buffer[index] = toAdd[i];
+    buffer[index] = *toAdd;
   }
 
   if(quotable) {
@@ -1720,7 +1697,7 @@ void addToBuffer(const __FlashStringHelper *toAdd, bool quotable){
   PGM_P p = reinterpret_cast<PGM_P>(toAdd);
 
   for ( unsigned char c = pgm_read_byte(p++);
-        c != 0 && index < OUTPUT_BUFFER_SIZE;
+        c != 0 && index < buffer_size;
         c = pgm_read_byte(p++), index++) {
     buffer[index] = c;
   }
@@ -1807,7 +1784,7 @@ char * getBuffer() {
 
 void resetBuffer(){
 
-  memset(&buffer[0], 0, sizeof(buffer));
+  memset(&buffer[0], 0, buffer_size);
   // free(buffer);
 
 }
@@ -1902,10 +1879,17 @@ void initFreeMemory(){
 void setMQTTServer(char* new_mqtt_server){
   mqtt_server = new_mqtt_server;
 }
+
+// Set largest message the broker accepts. Larger answers are dropped.
+void setMQTTMaxMessageSize(uint32_t size){
+  mqtt_max_message_size = size;
+}
 #endif
 
 protected:
-  String answer;
+  // token received since last slash, NUL terminated. Bytes up to index 3 stay readable for short tokens.
+  char answer[ANSWER_SIZE + 4];
+  uint16_t answer_length;
   char command;
   uint8_t pin;
   uint8_t message_pin;
@@ -1920,8 +1904,11 @@ protected:
   String id;
   String arguments;
 
-  // Output uffer
-  char buffer[OUTPUT_BUFFER_SIZE];
+  // Output buffer
+  char* buffer;
+  uint16_t buffer_size;
+  // buffer is allocated by aREST and freed by its destructor
+  bool owns_buffer;
   uint16_t index;
 
   // Status LED
@@ -1948,6 +1935,7 @@ protected:
   // aREST.io server
   char* mqtt_server = "104.131.78.157";
   bool private_mqtt_server;
+  uint32_t mqtt_max_message_size = MAX_MQTT_MESSAGE_SIZE;
 
   #endif
 
@@ -1,12 +1,25 @@
 /*
   bREST library for Arduino. A fork from aREST repo.
+
+  bREST core does not depend on aREST. Include bRESTaRESTAdapter.h for aREST pin, variable and function commands.
 */
 #ifndef bREST_H
 #define bREST_H
 
-#include <stdarg.h>
-
-#include "aREST.h"
+#include "bRESTConfig.h"
+#include "bRESTRequest.h"
+#include "bRESTFormats.h"
+#include "bRESTTemplate.h"
+#include "bRESTRouteTable.h"
+#include "bRESTArena.h"
+#include "bRESTMetrics.h"
+#include "bRESTTrace.h"
+#include "bRESTCapture.h"
+#include "bRESTStream.h"
+#include "bRESTWebSocket.h"
+#include "bRESTBatch.h"
+#include "bRESTAllocTracking.h"
+#include "bRESTUrlCache.h"
 
 // Set maximum length of URL, eg "/pin1/?mode=digital&value=high". Default is 256.
 #ifndef MAX_URL_LENGTH
@@ -28,6 +41,16 @@
 #define MAX_HTTP_BODY_LENGTH    1
 #endif
 
+// Set size of request arena beyond URL buffer, for scratch strings of handlers. Default is 64.
+#ifndef MAX_ARENA_SCRATCH_SIZE
+#define MAX_ARENA_SCRATCH_SIZE  64
+#endif
+
+// Fail to compile if buffers of any bRESTInstance exceed the budget in bytes. Default is half of SRAM on ATmega328.
+#if !defined(BREST_RAM_BUDGET) && defined(__AVR_ATmega328P__)
+#define BREST_RAM_BUDGET        1024
+#endif
+
 typedef enum {
     STATE_START,
     STATE_IGNORE,
@@ -42,6 +65,15 @@ typedef enum {
     STATE_IN_PUT_METHOD_P,
     STATE_IN_PUT_METHOD_U,
     STATE_IN_PUT_METHOD_T,
+    STATE_IN_POST_METHOD_O,
+    STATE_IN_POST_METHOD_S,
+    STATE_IN_POST_METHOD_T,
+    STATE_IN_DELETE_METHOD_D,
+    STATE_IN_DELETE_METHOD_DE,
+    STATE_IN_DELETE_METHOD_DEL,
+    STATE_IN_DELETE_METHOD_DELE,
+    STATE_IN_DELETE_METHOD_DELET,
+    STATE_IN_DELETE_METHOD_DELETE,
     STATE_IN_FIRST_SPACE,
     STATE_IN_URI,
     STATE_IN_FIRST_CR,
@@ -94,6 +126,33 @@ static String get_state_string(PARSER_STATE s) {
     case STATE_IN_PUT_METHOD_T:
         a = "STATE_IN_PUT_METHOD_T";
         break;
+    case STATE_IN_POST_METHOD_O:
+        a = "STATE_IN_POST_METHOD_O";
+        break;
+    case STATE_IN_POST_METHOD_S:
+        a = "STATE_IN_POST_METHOD_S";
+        break;
+    case STATE_IN_POST_METHOD_T:
+        a = "STATE_IN_POST_METHOD_T";
+        break;
+    case STATE_IN_DELETE_METHOD_D:
+        a = "STATE_IN_DELETE_METHOD_D";
+        break;
+    case STATE_IN_DELETE_METHOD_DE:
+        a = "STATE_IN_DELETE_METHOD_DE";
+        break;
+    case STATE_IN_DELETE_METHOD_DEL:
+        a = "STATE_IN_DELETE_METHOD_DEL";
+        break;
+    case STATE_IN_DELETE_METHOD_DELE:
+        a = "STATE_IN_DELETE_METHOD_DELE";
+        break;
+    case STATE_IN_DELETE_METHOD_DELET:
+        a = "STATE_IN_DELETE_METHOD_DELET";
+        break;
+    case STATE_IN_DELETE_METHOD_DELETE:
+        a = "STATE_IN_DELETE_METHOD_DELETE";
+        break;
     case STATE_IN_FIRST_SPACE:
         a = "STATE_IN_FIRST_SPACE";
         break;
@@ -122,12 +181,6 @@ static String get_state_string(PARSER_STATE s) {
 }
 #endif
 
-typedef enum {
-    HTTP_METHOD_GET,
-    HTTP_METHOD_PUT,
-    HTTP_METHOD_UNSET
-} HTTP_METHOD;
-
 typedef enum {
     CODE_OK                             = 200,
     CODE_ERROR_NO_VALID_DATA            = 501,
@@ -135,11 +188,145 @@ typedef enum {
     CODE_ERROR_INVALID_URL              = 503,
     CODE_ERROR_NO_OBSERVERS_ACTIVATED   = 504,
     CODE_ERROR_INVALID_COMMAND          = 505,
-    CODE_ERROR_INVALID_HTTP_METHOD      = 506
+    CODE_ERROR_INVALID_HTTP_METHOD      = 506,
+    CODE_ERROR_TOO_MANY_SUBSCRIBERS     = 507
 } MESSAGE_STATUS_CODE;
 
+// HTTP headers of JSON responses
+#define HTTP_JSON_HEADER_OK     "HTTP/1.1 200 OK\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n"
+#define HTTP_JSON_HEADER_ERROR  "HTTP/1.1 500\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n"
+#define HTTP_JSON_HEADER_METHOD_NOT_ALLOWED "HTTP/1.1 405 Method Not Allowed\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n"
+
+// Error messages, without braces
+#define MSG_URL_OVERFLOW        "\"message\":\"URL parsing overflow!\",\"code\":502"
+#define MSG_BODY_OVERFLOW       "\"message\":\"HTTP body parsing overflow!\",\"code\":502"
+#define MSG_INVALID_URL         "\"message\":\"Invalid URL request!\",\"code\":503"
+#define MSG_NO_OBSERVERS        "\"message\":\"Request has been processed. But no observers are activated!\",\"code\":504"
+#define MSG_METHOD_NOT_ALLOWED  "\"message\":\"Method not allowed!\",\"code\":506"
+
+// Error responses are templates, with HTTP header, or as one line without it
+constexpr char RESPONSE_URL_OVERFLOW[] PROGMEM = HTTP_JSON_HEADER_ERROR "{" MSG_URL_OVERFLOW "}\r\n";
+constexpr char LINE_URL_OVERFLOW[] PROGMEM = MSG_URL_OVERFLOW "\n";
+constexpr char RESPONSE_BODY_OVERFLOW[] PROGMEM = HTTP_JSON_HEADER_ERROR "{" MSG_BODY_OVERFLOW "}\r\n";
+constexpr char LINE_BODY_OVERFLOW[] PROGMEM = MSG_BODY_OVERFLOW "\n";
+constexpr char RESPONSE_INVALID_URL[] PROGMEM = HTTP_JSON_HEADER_ERROR "{" MSG_INVALID_URL "}\r\n";
+constexpr char LINE_INVALID_URL[] PROGMEM = MSG_INVALID_URL "\n";
+constexpr char RESPONSE_NO_OBSERVERS[] PROGMEM = HTTP_JSON_HEADER_OK "{" MSG_NO_OBSERVERS "}\r\n";
+constexpr char LINE_NO_OBSERVERS[] PROGMEM = MSG_NO_OBSERVERS "\n";
+constexpr char RESPONSE_METHOD_NOT_ALLOWED[] PROGMEM =
+    HTTP_JSON_HEADER_METHOD_NOT_ALLOWED "{" MSG_METHOD_NOT_ALLOWED "}\r\n";
+constexpr char LINE_METHOD_NOT_ALLOWED[] PROGMEM = MSG_METHOD_NOT_ALLOWED "\n";
+constexpr char RESPONSE_TOO_MANY_STREAMS[] PROGMEM =
+    HTTP_JSON_HEADER_ERROR "{\"message\":\"Too many stream subscribers!\",\"code\":507}\r\n";
+constexpr char RESPONSE_TOO_MANY_WEBSOCKETS[] PROGMEM =
+    HTTP_JSON_HEADER_ERROR "{\"message\":\"Too many WebSocket connections!\",\"code\":507}\r\n";
+constexpr char RESPONSE_INVALID_BATCH[] PROGMEM =
+    HTTP_JSON_HEADER_ERROR "{\"message\":\"Invalid batch operation!\",\"code\":503,\"index\":" BREST_INT_SLOT "}\r\n";
+constexpr char LINE_INVALID_BATCH[] PROGMEM =
+    "{\"message\":\"Invalid batch operation!\",\"code\":503,\"index\":" BREST_INT_SLOT "}\r\n";
+
+typedef enum {
+    PARSE_OK,
+    PARSE_INVALID,
+    PARSE_URL_OVERFLOW,
+    PARSE_BODY_OVERFLOW
+} PARSE_RESULT;
+
+#if BREST_METRICS
+// Error codes counted by bRESTMetrics, from CODE_ERROR_NO_VALID_DATA
+#define NUM_METRICS_ERROR_CODES (CODE_ERROR_TOO_MANY_SUBSCRIBERS - CODE_ERROR_NO_VALID_DATA + 1)
+
+/**
+ * @brief The bRESTResourceMetrics struct counts requests and update latency of one resource.
+ */
+struct bRESTResourceMetrics {
+    uint32_t requests[HTTP_METHOD_UNSET];
+    bRESTHistogram update;
+
+    bRESTResourceMetrics() {
+        memset(requests, 0, sizeof(requests));
+    }
+};
+
+/**
+ * @brief The bRESTMetrics struct counts stage latency, errors, overflows and truncated responses of one bREST.
+ */
+struct bRESTMetrics {
+    bRESTHistogram stages[STAGE_COUNT];
+    uint32_t errors[NUM_METRICS_ERROR_CODES];
+    uint32_t url_overflows;
+    uint32_t body_overflows;
+    uint32_t truncated_responses;
+
+    bRESTMetrics() {
+        memset(errors, 0, sizeof(errors));
+        url_overflows = 0;
+        body_overflows = 0;
+        truncated_responses = 0;
+    }
+};
+#endif
+
+/**
+ * @brief The bRESTCapacities struct sizes buffers of one bRESTInstance. Defaults come from global macros.
+ * @tparam URL_LENGTH maximum length of URL
+ * @tparam NUM_PARMS maximum number of URL parameters
+ * @tparam NUM_RESOURCES maximum number of observer resources
+ * @tparam HTTP_BODY_LENGTH maximum length of HTTP body
+ * @tparam OUTPUT_SIZE size of output buffer
+ * @tparam ARENA_SIZE size of request arena. It holds URL and scratch strings of handlers.
+ */
+template<unsigned int URL_LENGTH = MAX_URL_LENGTH,
+         unsigned int NUM_PARMS = MAX_NUM_PARMS,
+         unsigned int NUM_RESOURCES = MAX_NUM_RESOURCES,
+         unsigned int HTTP_BODY_LENGTH = MAX_HTTP_BODY_LENGTH,
+         unsigned long OUTPUT_SIZE = OUTPUT_BUFFER_SIZE,
+         unsigned long ARENA_SIZE = URL_LENGTH + 1UL + MAX_ARENA_SCRATCH_SIZE>
+struct bRESTCapacities {
+    static const unsigned int max_url_length = URL_LENGTH;
+    static const unsigned int max_num_parms = NUM_PARMS;
+    static const unsigned int max_num_resources = NUM_RESOURCES;
+    static const unsigned int max_http_body_length = HTTP_BODY_LENGTH;
+    static const unsigned long output_buffer_size = OUTPUT_SIZE;
+    static const unsigned long arena_size = ARENA_SIZE;
+
+    // static RAM held by buffers of one instance in bytes
+    static const unsigned long ram_budget = 2UL * NUM_PARMS * (sizeof(char*) + sizeof(String))
+                                          + NUM_RESOURCES * sizeof(void*)
+                                          + HTTP_BODY_LENGTH
+                                          + OUTPUT_SIZE
+                                          + ARENA_SIZE;
+};
+
 //define bREST class
 class bREST;
+class Observer;
+struct bRESTDefaultStorage;
+
+/**
+ * @brief The bRESTStorage struct hands buffers of bRESTInstance and their capacities to bREST.
+ */
+struct bRESTStorage {
+    char* output_buffer;
+    uint16_t output_buffer_size;
+    char* arena;
+    uint16_t arena_size;
+    char** parms;
+    char** value;
+    String* parm_strings;
+    String* value_strings;
+    Observer** observer_list;
+    unsigned char* http_body;
+    unsigned int max_url_length;
+    unsigned int max_num_parms;
+    unsigned int max_num_resources;
+    unsigned int max_http_body_length;
+};
+
+/**
+ * Call back of resource for one HTTP method. StaticObserver resolves them at compile time.
+ */
+typedef void (*ObserverMethodHandler)(Observer* observer, const bRESTRequest& request, bREST* rest);
 
 /**
  * @brief The Observer class is an abstract class for subscribed resource.
@@ -147,8 +334,20 @@ class bREST;
  */
 class Observer {
 protected:
-    // unique resource ID
+    // unique resource ID. It is empty if ID lives in flash.
     String id;
+    // unique resource ID in flash. NULL if ID is copied into RAM.
+    const __FlashStringHelper* flash_id;
+    // call backs by HTTP method, NULL for methods not allowed. NULL if on_request() serves all requests.
+    const ObserverMethodHandler* method_handlers;
+#if BREST_METRICS
+    bRESTResourceMetrics metrics;
+#endif
+#if BREST_ALLOC_TRACKING
+    bRESTAllocUsage alloc_usage;
+#endif
+
+    friend class bREST;
 
     /**
      * @brief find_parm find the index of parameters for key
@@ -168,70 +367,258 @@ protected:
         return found_index;
     }
 
+    /**
+     * @brief find_parm find the index of parameters for key
+     * @param parms parameter arrays
+     * @param parm_count the number of parameter array
+     * @param key parameter key
+     * @return index of parameter if key is found. Otherwise, return -1
+     */
+    int find_parm(char* parms[], int parm_count, const char* key) {
+        for (int i = 0; i < parm_count; i++) {
+            if (0 == strcasecmp(parms[i], key))
+                return i;
+        }
+        return -1;
+    }
+
 public:
     Observer(String id) {
         this->id = id;
+        this->flash_id = NULL;
+        this->method_handlers = NULL;
+    }
+
+    /**
+     * @brief Observer constructor with resource ID in flash. No RAM is spent on ID.
+     * @details i.e. Observer(F("switch")) in function scope, or for global object:
+     *      const char SWITCH_ID[] PROGMEM = "switch";
+     *      PowerPlug powerPlug(FPSTR(SWITCH_ID));
+     * @param id resource ID in flash
+     */
+    Observer(const __FlashStringHelper* id) {
+        this->flash_id = id;
+        this->method_handlers = NULL;
+    }
+
+    /**
+     * @brief Observer constructor for resource dispatched by a compile-time RouteTable. Its resource ID lives in flash.
+     */
+    Observer() {
+        this->flash_id = NULL;
+        this->method_handlers = NULL;
     }
 
     virtual ~Observer() {}
+
+    /**
+     * @brief on_request a call back method by bREST class.
+     * @details Parameters and values point into the request arena, so no heap is allocated. They are valid until
+     *          the call returns. Default implementation copies them into Strings held by bREST and calls update().
+     * @param method HTTP method of RESTful request
+     * @param parms an array of parameter of RESTful request
+     * @param value an array of value of RESTful request
+     * @param parm_count number of element in parameter array
+     * @param rest bREST object for appending returned JSON message
+     */
+    virtual void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest);
+
     /**
-     * @brief update a call back method by bREST class.
+     * @brief update a call back method by bREST class, with parameters copied into Strings.
+     * @details Override on_request() instead to keep the request path free of heap allocation.
      * @param method HTTP method of RESTful request
      * @param parms an array of parameter of RESTful request
      * @param value an array of value of RESTful request
      * @param parm_count number of element in parameter array. It assumes that the number of element between parameter array and value array are the same.
      * @param rest bREST object for appending returned JSON message
      */
-    virtual void update(HTTP_METHOD method, String parms[], String value[], int parm_count, bREST* rest) = 0;
+    virtual void update(HTTP_METHOD method, String parms[], String value[], int parm_count, bREST* rest);
+
+    /**
+     * @brief allows check whether resource serves HTTP method. Resources served by on_request() allow GET and PUT.
+     * @param method HTTP method of request
+     * @return true if method is allowed. Otherwise, false.
+     */
+    bool allows(HTTP_METHOD method) const {
+        if (method >= HTTP_METHOD_UNSET)
+            return false;
+        if (method_handlers != NULL)
+            return method_handlers[method] != NULL;
+        return HTTP_METHOD_GET == method || HTTP_METHOD_PUT == method;
+    }
+
+    /**
+     * @brief is_concurrent check whether call backs may run concurrently on multi-threaded host server.
+     * @details Call backs of a resource are serialized by default. Override it to return true if they are thread safe.
+     * @return true if call backs are thread safe. Otherwise, false.
+     */
+    virtual bool is_concurrent() {
+        return false;
+    }
 
     /**
      * @brief get_resource_id get resource ID
      * @return a string of resource ID
      */
     String get_id() {
-        return id;
+        return (flash_id != NULL)? String(flash_id): id;
+    }
+
+    /**
+     * @brief matches_id compare resource ID case insensitively without copying it
+     * @param resource_id resource ID of request
+     * @return true if resource ID matches. Otherwise, false.
+     */
+    bool matches_id(const char* resource_id) {
+        if (flash_id != NULL)
+            return 0 == strcasecmp_P(resource_id, reinterpret_cast<PGM_P>(flash_id));
+        return 0 == strcasecmp(resource_id, id.c_str());
+    }
+
+#if BREST_METRICS
+    /**
+     * @brief get_metrics get request counters and update() latency of this resource
+     * @return resource metrics
+     */
+    bRESTResourceMetrics& get_metrics() {
+        return metrics;
+    }
+#endif
+
+#if BREST_ALLOC_TRACKING
+    /**
+     * @brief get_alloc_usage get heap allocations made by call backs of this resource, and stack high water of its requests
+     * @return heap and stack usage
+     */
+    bRESTAllocUsage& get_alloc_usage() {
+        return alloc_usage;
     }
+#endif
 
 };
 
-class bREST: public aREST {
+class bREST {
+    friend class Observer;
 
 protected:
     PARSER_STATE parser_state;
     PARSER_STATE uri_final_state;
     PARSER_STATE http_body_final_state;
-    HTTP_METHOD http_method;
-    String http_url;
+    // URL, resource ID, parms and value live in the request arena
+    char* http_url;
     unsigned int url_length_counter;
-    unsigned int body_length_counter;
     unsigned int process_char_counter;
-    String parms[MAX_NUM_PARMS];
-    String value[MAX_NUM_PARMS];
-    String resource_id;
-    unsigned int parm_counter;
-    Observer* observer_list[MAX_NUM_RESOURCES];
+    // request being served. Parsers of all transports fill it, and dispatch() serves it.
+    bRESTRequest request;
+    // parms and value of request, observer_list and http_body point to storage owned by bRESTInstance
+    bRESTArena arena;
+    Observer** observer_list;
+    // parms and value of request copied for Observer::update(). Strings keep their heap buffers between requests.
+    String* parm_strings;
+    String* value_strings;
     unsigned int observer_counter;
-    unsigned char http_body[MAX_HTTP_BODY_LENGTH];
+    RouteTable route_table;
+    unsigned char* http_body;
+    unsigned int max_url_length;
+    unsigned int max_num_parms;
+    unsigned int max_num_resources;
+    unsigned int max_http_body_length;
+
+    // Output buffer
+    char* buffer;
+    uint16_t buffer_size;
+    uint16_t index;
+    // response did not fit in output buffer
+    bool truncated;
+    // error code of current request, or CODE_OK
+    MESSAGE_STATUS_CODE last_status;
+    // format the writer renders: negotiated one for resources, JSON otherwise
+    RESPONSE_FORMAT response_format;
+    // format of the last response, kept after request ends
+    RESPONSE_FORMAT last_response_format;
+    // keys written since start_json_msg(), and where its message starts in output buffer
+    uint16_t message_key_count;
+    uint16_t message_start;
+#if BREST_BATCH
+    // messages are elements of /_batch array, which ends with line break once
+    bool in_batch;
+#endif
 
-public:
-    bREST():aREST() {
-        reset_uri_state_vars();
-        reset_body_state_vars();
-        observer_counter = 0;
-    }
+#if BREST_METRICS
+    bRESTMetrics metrics;
+    // network client of handle() while its request is served, so that metrics larger than output buffer are sent
+    // in parts. NULL on other transports.
+    void* output_client;
+    size_t (*write_output_client)(void* client, const uint8_t* buffer, size_t size);
+#endif
+    // start of current stage by metrics_clock()
+    uint32_t stage_start;
+
+#if BREST_ALLOC_TRACKING
+    bRESTStackPainter stack_painter;
+    // allocation counters when request starts
+    bRESTAllocCounters request_start;
+    bRESTAllocUsage last_request_usage;
+    bRESTAllocUsage alloc_usage;
+    // the last resource fired by request
+    Observer* fired_observer;
+#endif
+
+#if BREST_STREAMS
+    bRESTStreamSlot streams[MAX_STREAM_SUBSCRIBERS];
+    // resource subscribed by current request with ?stream=1
+    Observer* stream_observer;
+#endif
+
+#if BREST_WEBSOCKET
+    bRESTWebSocket websockets[MAX_WEBSOCKETS];
+    // Sec-WebSocket-Key of current request, and how much of its header name the current header line matches
+    char websocket_key[WEBSOCKET_KEY_LENGTH + 1];
+    uint8_t websocket_key_length;
+    uint8_t websocket_key_match;
+    // current request is upgraded to WebSocket
+    bool websocket_upgrade;
+#endif
+
+#if BREST_BINARY_FORMATS
+    bRESTAcceptScanner accept_scanner;
+#endif
+
+#if BREST_URL_CACHE
+    bRESTUrlCache url_cache;
+    // hash of request URI received by process() so far
+    uint32_t url_hash;
+    // resource of current request was looked up, by cache or while filling it
+    bool is_observer_resolved;
+    // resource found by route table, or the only one of observer list with resource ID. Otherwise, NULL.
+    Observer* resolved_observer;
+    // index of resolved observer in observer list, 0xFFFF if routed
+    uint16_t resolved_index;
+#endif
+
+    // buffers allocated by bREST(), NULL if they are owned by bRESTInstance
+    bRESTDefaultStorage* default_storage;
 
     /**
-     * @brief bREST constructor
-     * @param rest_remote_server REST server IP
-     * @param rest_port REST server port number
+     * @brief bREST constructor. Use bRESTInstance to allocate bREST with its buffers.
+     * @param storage buffers and their capacities
      */
-    bREST(char* rest_remote_server, int rest_port): aREST(rest_remote_server, rest_port) {
-        reset_uri_state_vars();
-        reset_body_state_vars();
-        observer_counter = 0;
+    bREST(const bRESTStorage& storage): default_storage(NULL) {
+        init_storage(storage);
     }
 
-    virtual ~bREST() override {}
+public:
+    /**
+     * @brief bREST constructor with buffers of default capacities, allocated from heap once.
+     * @details bRESTInstance<> has the same buffers in static RAM, and is sized at compile time.
+     */
+    bREST();
+
+    // resources, routes and buffers are not copied
+    bREST(const bREST& other) = delete;
+    bREST& operator=(const bREST& other) = delete;
+
+    virtual ~bREST();
 
     /**
      * @brief add_observer add new resource to REST server
@@ -239,14 +626,29 @@ public:
      * @return true if successful. Otherwise, false
      */
     bool add_observer(Observer* new_resource) {
-        if (observer_counter < MAX_NUM_RESOURCES) {
+        if (observer_counter < max_num_resources) {
             observer_list[observer_counter++] = new_resource;
+#if BREST_URL_CACHE
+            url_cache.clear();
+#endif
             return true;
         } else {
             return false;
         }
     }
 
+    /**
+     * @brief set_route_table dispatch requests through a compile-time route table built by BREST_ROUTE_TABLE().
+     * @details Routed resources are looked up before observers added by add_observer().
+     * @param table route table
+     */
+    void set_route_table(const RouteTable& table) {
+        route_table = table;
+#if BREST_URL_CACHE
+        url_cache.clear();
+#endif
+    }
+
     /**
      * @brief append_key_value_pair_to_json Add key value pair to returned JSON message.
      * @param key
@@ -254,7 +656,7 @@ public:
      */
     void append_key_value_pair_to_json(const String& key, bool value) {
         append_key_to_json(key);
-        addToBuffer(value, false);
+        append_value(value);
     }
 
     /**
@@ -264,7 +666,7 @@ public:
      */
     void append_key_value_pair_to_json(const String& key, const String& value) {
         append_key_to_json(key);
-        addToBuffer(value, true);
+        append_value(value);
     }
 
     /**
@@ -274,7 +676,7 @@ public:
      */
     void append_key_value_pair_to_json(const String& key, int value) {
         append_key_to_json(key);
-        addToBuffer(value, false);
+        append_value(value);
     }
 
     /**
@@ -284,7 +686,7 @@ public:
      */
     void append_key_value_pair_to_json(const String& key, float value) {
         append_key_to_json(key);
-        addToBuffer(value, false);
+        append_value(value);
     }
 
     /**
@@ -294,28 +696,140 @@ public:
      */
     void append_key_value_pair_to_json(const String& key, const char* value) {
         append_key_to_json(key);
-        addToBuffer(value, true);
+        append_value(value);
+    }
+
+    /**
+     * @brief append_key_value_pair_to_json Add key value pair to returned JSON message without String temporaries.
+     * @param key
+     * @param value
+     */
+    void append_key_value_pair_to_json(const char* key, bool value) {
+        append_key_to_json(key);
+        append_value(value);
+    }
+
+    void append_key_value_pair_to_json(const char* key, int value) {
+        append_key_to_json(key);
+        append_value(value);
+    }
+
+    void append_key_value_pair_to_json(const char* key, float value) {
+        append_key_to_json(key);
+        append_value(value);
+    }
+
+    void append_key_value_pair_to_json(const char* key, const char* value) {
+        append_key_to_json(key);
+        append_value(value);
+    }
+
+    /**
+     * @brief append_key_value_pair_to_json Add key value pair to returned JSON message. Key is copied from flash.
+     * @param key key in flash, i.e. F("code")
+     * @param value
+     */
+    void append_key_value_pair_to_json(const __FlashStringHelper* key, bool value) {
+        append_key_to_json(key);
+        append_value(value);
+    }
+
+    void append_key_value_pair_to_json(const __FlashStringHelper* key, int value) {
+        append_key_to_json(key);
+        append_value(value);
+    }
+
+    void append_key_value_pair_to_json(const __FlashStringHelper* key, float value) {
+        append_key_to_json(key);
+        append_value(value);
+    }
+
+    void append_key_value_pair_to_json(const __FlashStringHelper* key, const char* value) {
+        append_key_to_json(key);
+        append_value(value);
+    }
+
+    /**
+     * @brief append_key_value_pair_to_json Add key value pair to returned JSON message. Both are copied from flash.
+     * @param key key in flash, i.e. F("message")
+     * @param value value in flash, i.e. F("Affirmative!")
+     */
+    void append_key_value_pair_to_json(const __FlashStringHelper* key, const __FlashStringHelper* value) {
+        append_key_to_json(key);
+        append_value(value);
+    }
+
+    /**
+     * @brief put add key value pair to message, after a separator unless it is the first one. Message is rendered in
+     *        the format client asked for: JSON, CBOR or MessagePack.
+     * @param key String, NUL terminated string or key in flash, i.e. F("angle")
+     * @param value bool, int, float, String, NUL terminated string or string in flash
+     */
+    template <typename KEY, typename VALUE>
+    void put(const KEY& key, const VALUE& value) {
+        if (message_key_count != 0)
+            append_comma_to_json();
+        append_key_value_pair_to_json(key, value);
+    }
+
+    /**
+     * @brief put_fragment add key value pair whose key is a JSON fragment in flash, i.e. PSTR(",\"angle\":"), as
+     *        BREST_SERIALIZER() generates. Separator of the first pair is skipped, and binary formats take the name
+     *        between the quotes.
+     * @param fragment separator, quoted key and colon in flash
+     * @param value bool, long, unsigned long, float, String, NUL terminated string or string in flash
+     */
+    template <typename VALUE>
+    void put_fragment(PGM_P fragment, const VALUE& value) {
+        append_key_fragment(fragment);
+        append_value(value);
     }
 
     /**
-     * @brief append_comma_to_json Add comma separator to JSON message.
+     * @brief append_comma_to_json Add comma separator to JSON message. Binary formats have no separator.
      */
     void append_comma_to_json() {
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON)
+            return;
+#endif
         addToBufferF(F(","));
     }
 
     /**
-     * @brief start_json_msg start JSON message.
+     * @brief start_json_msg start JSON message, or map of binary format.
      */
     void start_json_msg() {
+        message_key_count = 0;
+        message_start = index;
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON) {
+            // size of map is known when message ends, so its head is one byte placeholder until then
+            uint8_t placeholder = 0;
+            append_bytes(&placeholder, 1);
+            return;
+        }
+#endif
         // wrap JSON left bracket
         addToBufferF(F("{"));
     }
 
     /**
-     * @brief end_json_msg end JSON message.
+     * @brief end_json_msg end JSON message, or map of binary format.
      */
     void end_json_msg() {
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON) {
+            end_binary_map();
+            return;
+        }
+#endif
+#if BREST_BATCH
+        if (in_batch) {
+            addToBufferF(F("}"));
+            return;
+        }
+#endif
         // wrap JSON right bracket
         addToBufferF(F("}\r\n"));
     }
@@ -333,98 +847,629 @@ public:
      * @return  length of HTTP body
      */
     unsigned int get_http_body_length() {
-        return this->body_length_counter;
+        return this->request.body_length;
     }
 
     unsigned int get_process_char_counter() {
         return this->process_char_counter;
     }
+
     /**
-     * @brief get_method get string value of http method
-     * @param method
-     * @return a string of http method
+     * @brief get_arena get request arena for scratch strings of handler. They are released when request ends.
+     * @return request arena
      */
-    static String get_method(HTTP_METHOD method) {
-        switch(method) {
-        case HTTP_METHOD_GET:
-            return "GET";
-        case HTTP_METHOD_PUT:
-            return "PUT";
-        default:
-            return "UNSET";
-        }
+    bRESTArena& get_arena() {
+        return this->arena;
     }
 
-protected:
     /**
-     * @brief process parses one and only one Request-Line i.e. (Method SP Request-URI SP HTTP-Version CRLF). Disregard the rest of HTTP conversation.
-     *
-     * @details
-     *  - Support two methods: GET and PUT. Disregard the rest of HTTP methods.
-     *      + GET method refers to READ value,
-     *      + PUT method refers to WRITE value.
-     *  - Support two types of request URI:
-     *      + absoluteURI. i.e. http://wherever.com/pin1/?mode=digital&value=high
-     *      + abs_path. i.e. /pin1/?mode=digital&value=high
-     *
-     * @ref [RFC2616](https://www.ietf.org/rfc/rfc2616.txt)
-     * @param c one character from character stream
+     * @brief get_arena_high_water_mark get the largest number of arena bytes used by one request
+     * @return high water mark in bytes
      */
-    void process(char c) override {
-        process_char_counter++;
-        switch(parser_state) {
-        // The length of URI is too long.
-        case STATE_OVERFLOW_URI:
-            if (c == '\r')
-                parser_state = STATE_IN_FIRST_CR;
-            break;
-
-        case STATE_START:
-            if (c == 'G')
-                parser_state = STATE_IN_GET_METHOD_G;
-            else if (c == 'P')
-                parser_state = STATE_IN_PUT_METHOD_P;
-            else
-                parser_state = STATE_IGNORE_URI;
-            break;
-        // parse GET
-        case STATE_IN_GET_METHOD_G:
-            parser_state = (c == 'E')? STATE_IN_GET_METHOD_E: STATE_IGNORE_URI;
-            break;
-        case STATE_IN_GET_METHOD_E:
-            parser_state = (c == 'T')? STATE_IN_GET_METHOD_T: STATE_IGNORE_URI;
-            break;
+    uint16_t get_arena_high_water_mark() {
+        return this->arena.get_high_water_mark();
+    }
 
-        // parse PUT
-        case STATE_IN_PUT_METHOD_P:
-            parser_state = (c == 'U')? STATE_IN_PUT_METHOD_U: STATE_IGNORE_URI;
-            break;
-        case STATE_IN_PUT_METHOD_U:
-            parser_state = (c == 'T')? STATE_IN_PUT_METHOD_T: STATE_IGNORE_URI;
-            break;
+#if BREST_METRICS
+    /**
+     * @brief get_metrics get stage latency, error and overflow counters. They are served on /_metrics as well.
+     * @return metrics
+     */
+    bRESTMetrics& get_metrics() {
+        return this->metrics;
+    }
+#endif
 
-        // end of parsing PUT and GET
-        case STATE_IN_GET_METHOD_T:
-            parser_state = (c == ' ')? STATE_IN_FIRST_SPACE: STATE_IGNORE_URI;
-            http_method = HTTP_METHOD_GET;
-            break;
+#if BREST_URL_CACHE
+    /**
+     * @brief get_url_cache get request line cache, i.e. its hit, miss and eviction counters
+     * @return request line cache
+     */
+    bRESTUrlCache& get_url_cache() {
+        return this->url_cache;
+    }
+#endif
 
-        case STATE_IN_PUT_METHOD_T:
-            parser_state = (c == ' ')? STATE_IN_FIRST_SPACE: STATE_IGNORE_URI;
-            http_method = HTTP_METHOD_PUT;
-            break;
+    /**
+     * @brief record_error count an error response in metrics. Call it from handler that replies with error code.
+     * @param code error code
+     */
+    void record_error(MESSAGE_STATUS_CODE code) {
+        last_status = code;
+#if BREST_METRICS
+        if (code >= CODE_ERROR_NO_VALID_DATA && code < CODE_ERROR_NO_VALID_DATA + NUM_METRICS_ERROR_CODES)
+            metrics.errors[code - CODE_ERROR_NO_VALID_DATA]++;
+#endif
+    }
 
-        case STATE_IN_FIRST_SPACE:
+    /**
+     * @brief get_last_status get status of the last request, for transports that report it out of band, i.e. CoAP
+     * @return error code recorded by record_error(), or CODE_OK
+     */
+    MESSAGE_STATUS_CODE get_last_status() {
+        return this->last_status;
+    }
+
+    /**
+     * @brief get_response_format get format of the last response, for transports that report it out of band, i.e.
+     *        Content-Format of CoAP
+     * @return format
+     */
+    RESPONSE_FORMAT get_response_format() {
+        return this->last_response_format;
+    }
+
+#if BREST_ALLOC_TRACKING
+    /**
+     * @brief get_last_request_usage get heap allocations and stack usage of the last request, i.e. to assert zero
+     *        allocations per request in tests
+     * @return usage of the last request
+     */
+    const bRESTAllocUsage& get_last_request_usage() {
+        return this->last_request_usage;
+    }
+
+    /**
+     * @brief get_alloc_usage get heap and stack usage accumulated over all requests
+     * @return usage of all requests
+     */
+    bRESTAllocUsage& get_alloc_usage() {
+        return this->alloc_usage;
+    }
+#endif
+
+    /**
+     * @brief is_truncated check whether response did not fit in output buffer
+     * @return true if response is truncated. Otherwise, false.
+     */
+    bool is_truncated() {
+        return this->truncated;
+    }
+
+#if BREST_STREAMS
+    /**
+     * @brief notify_change mark resource changed. Its stream subscribers receive the new state on flush_streams().
+     * @details It only sets flags, so it may be called from timer call back. Changes before flush are coalesced.
+     * @param p_resource changed resource
+     */
+    void notify_change(Observer* p_resource) {
+        for (uint8_t i = 0; i < MAX_STREAM_SUBSCRIBERS; i++) {
+            if (streams[i].observer == p_resource)
+                streams[i].pending = true;
+        }
+    }
+
+    /**
+     * @brief flush_streams push pending events to stream subscribers and drop disconnected ones. Call it in loop().
+     */
+    void flush_streams() {
+        for (uint8_t i = 0; i < MAX_STREAM_SUBSCRIBERS; i++) {
+            bRESTStreamSlot& slot = streams[i];
+            if (NULL == slot.observer)
+                continue;
+            if (!slot.is_connected()) {
+                slot.release();
+                continue;
+            }
+
+            slot.flush();
+            // render latest state only after previous event is sent
+            if (slot.pending && slot.is_idle()) {
+                render_event(slot);
+                slot.flush();
+            }
+        }
+    }
+
+    /**
+     * @brief get_subscriber_count get number of stream subscribers
+     * @return number of subscribers
+     */
+    uint8_t get_subscriber_count() {
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < MAX_STREAM_SUBSCRIBERS; i++) {
+            if (streams[i].observer != NULL)
+                count++;
+        }
+        return count;
+    }
+#endif
+
+#if BREST_WEBSOCKET
+    /**
+     * @brief poll_websockets serve messages of WebSocket connections and drop closed ones. Call it in loop().
+     */
+    void poll_websockets() {
+        for (uint8_t i = 0; i < MAX_WEBSOCKETS; i++) {
+            bRESTWebSocket& websocket = websockets[i];
+            if (!websocket.is_open())
+                continue;
+            if (!websocket.is_connected()) {
+                websocket.release();
+                continue;
+            }
+
+            WS_RECEIVE received;
+            while (websocket.is_open() && (received = websocket.receive()) != WS_RECEIVE_NONE)
+                serve_websocket(websocket, received);
+        }
+    }
+
+    /**
+     * @brief get_websocket_count get number of open WebSocket connections
+     * @return number of connections
+     */
+    uint8_t get_websocket_count() {
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < MAX_WEBSOCKETS; i++) {
+            if (websockets[i].is_open())
+                count++;
+        }
+        return count;
+    }
+#endif
+
+    /**
+     * @brief loop push pending stream events and serve WebSocket messages. Call it in loop() of sketch.
+     */
+    void loop() {
+#if BREST_STREAMS
+        flush_streams();
+#endif
+#if BREST_WEBSOCKET
+        poll_websockets();
+#endif
+    }
+
+    /**
+     * @brief get_method get string value of http method
+     * @param method
+     * @return a string of http method
+     */
+    static String get_method(HTTP_METHOD method) {
+        switch(method) {
+        case HTTP_METHOD_GET:
+            return "GET";
+        case HTTP_METHOD_PUT:
+            return "PUT";
+        case HTTP_METHOD_POST:
+            return "POST";
+        case HTTP_METHOD_DELETE:
+            return "DELETE";
+        default:
+            return "UNSET";
+        }
+    }
+
+    /**
+     * @brief handle serve one HTTP request from network client, i.e. WiFiClient or EthernetClient.
+     * @param client network client. Connection is closed after response is sent.
+     */
+    template <typename T>
+    void handle(T& client) {
+        if (client.available()) {
+#if DEBUG
+            log("bREST::handle() received request.\n");
+#endif
+            begin_request();
+#if BREST_METRICS
+            output_client = &client;
+            write_output_client = &write_output_to<T>;
+#endif
+            handle_proto(client, true, 0, true);
+#if BREST_METRICS
+            output_client = NULL;
+#endif
+            sendBuffer(client, 0, 0);
+            end_request();
+            hold_or_stop(client);
+            reset_status();
+        }
+    }
+
+    /**
+     * @brief handle serve one request from serial port without HTTP headers.
+     * @param serial serial port
+     */
+    void handle(HardwareSerial& serial) {
+        handle_serial(serial);
+    }
+
+#if defined(CORE_TEENSY)
+    void handle(usb_serial_class& serial) {
+        handle_serial(serial);
+    }
+#endif
+
+#if defined(__AVR_ATmega32U4__)
+    void handle(Serial_& serial) {
+        handle_serial(serial);
+    }
+#endif
+
+    /**
+     * @brief handle serve one request from a NUL terminated string without HTTP headers.
+     * @details Response stays in output buffer until resetBuffer(). Read it with getBuffer().
+     * @param string request
+     */
+    void handle(char* string) {
+        begin_request();
+        bRESTStringSource source(string);
+        handle_proto(source, false, 0, false);
+        finish_request();
+    }
+
+    /**
+     * @brief handle_compact serve one compact request, i.e. "PUT servo1 angle=120", without HTTP headers.
+     * @details Response follows reserved bytes in output buffer, where transport puts its frame header. It stays in
+     *          output buffer until resetBuffer().
+     * @param request compact request. It needs no NUL terminator.
+     * @param length length of request
+     * @param reserved number of bytes reserved in front of response
+     */
+    void handle_compact(const char* request, uint16_t length, uint16_t reserved = 0) {
+        begin_request();
+        stage_start = metrics_clock();
+        index = reserved;
+        if (parse_compact_request(request, length)) {
+            send_command(false, false);
+        } else {
+            end_parse_stage();
+            dispatch(PARSE_INVALID, false);
+        }
+        finish_request();
+    }
+
+    /**
+     * @brief handle_message serve one message of a publish/subscribe transport, i.e. MQTT, without HTTP headers.
+     * @details Response stays in output buffer until resetBuffer(). Read it with getBuffer() and get_buffer_length().
+     * @param method HTTP method the message stands for
+     * @param resource NUL terminated resource ID. It is used in place.
+     * @param payload parameters "key=value&key=value". It needs no NUL terminator.
+     * @param length length of payload
+     * @param format format of response, i.e. picked by topic
+     */
+    void handle_message(HTTP_METHOD method, char* resource, const uint8_t* payload, uint16_t length,
+                        RESPONSE_FORMAT format = RESPONSE_FORMAT_JSON) {
+        begin_request();
+        stage_start = metrics_clock();
+        request.method = method;
+        request.resource_id = resource;
+        request.format = format;
+        PARSE_RESULT parsed = PARSE_URL_OVERFLOW;
+        if (length <= max_url_length) {
+            // payload lacks NUL terminator, so its parameters are split in URL buffer
+            memcpy(http_url, payload, length);
+            http_url[length] = '\0';
+            url_length_counter = length;
+            parsed = (0 == length || parse_parms(http_url))? PARSE_OK: PARSE_INVALID;
+        }
+        end_parse_stage();
+        dispatch(parsed, false);
+        finish_request();
+    }
+
+    /**
+     * @brief handle_request serve a request that transport parsed on its own, without HTTP headers.
+     * @details Response stays in output buffer until resetBuffer(). Read it with getBuffer() and get_buffer_length().
+     * @param parsed request. Its strings are used in place, and parameters beyond max_num_parms are dropped.
+     */
+    void handle_request(const bRESTRequest& parsed) {
+        begin_request();
+        request.method = parsed.method;
+        request.resource_id = parsed.resource_id;
+        request.parm_count = (parsed.parm_count < max_num_parms)? parsed.parm_count: max_num_parms;
+        memcpy(request.parms, parsed.parms, request.parm_count * sizeof(char*));
+        memcpy(request.value, parsed.value, request.parm_count * sizeof(char*));
+        request.body = parsed.body;
+        request.body_length = parsed.body_length;
+        request.format = parsed.format;
+        stage_start = metrics_clock();
+        dispatch(PARSE_OK, false);
+        finish_request();
+    }
+
+    /**
+     * @brief get_request get request being served, i.e. for typed parameters in Observer::on_request():
+     *        rest->get_request().get_int(F("angle"), 90)
+     * @return request
+     */
+    const bRESTRequest& get_request() {
+        return this->request;
+    }
+
+    /**
+     * @brief getBuffer get NUL terminated output buffer
+     * @return output buffer
+     */
+    char* getBuffer() {
+        buffer[(index < buffer_size)? index: buffer_size - 1] = '\0';
+        return buffer;
+    }
+
+    /**
+     * @brief get_buffer_length get the length of response in output buffer
+     * @return length of output buffer
+     */
+    uint16_t get_buffer_length() {
+        return index;
+    }
+
+    void resetBuffer() {
+        index = 0;
+        truncated = false;
+    }
+
+    void addToBufferF(const __FlashStringHelper* toAdd) {
+        PGM_P p = reinterpret_cast<PGM_P>(toAdd);
+
+        for (unsigned char c = pgm_read_byte(p++); c != 0; c = pgm_read_byte(p++)) {
+            if (index >= buffer_size) {
+                truncated = true;
+                return;
+            }
+            buffer[index++] = c;
+        }
+    }
+
+    /**
+     * @brief append_template_text append text in flash to output buffer as it is. Used by bRESTTemplate.
+     * @param text text in flash
+     * @param length number of bytes
+     */
+    void append_template_text(PGM_P text, uint16_t length) {
+        if (length > buffer_size - index) {
+            length = buffer_size - index;
+            truncated = true;
+        }
+        memcpy_P(buffer + index, text, length);
+        index += length;
+    }
+
+    /**
+     * @brief addToBuffer append string to output buffer. Quotes and backslashes are escaped.
+     * @param toAdd string
+     * @param quotable wrap string with quotes
+     */
+    void addToBuffer(const char* toAdd, bool quotable) {
+        if (quotable)
+            addQuote();
+
+        for (; *toAdd != '\0'; toAdd++) {
+            // Handle quoting quotes and backslashes
+            bool escaped = (*toAdd == '"' || *toAdd == '\\');
+            if (index + escaped >= buffer_size) {   // No room!
+                truncated = true;
+                return;
+            }
+            if (escaped)
+                buffer[index++] = '\\';
+            buffer[index++] = *toAdd;
+        }
+
+        if (quotable)
+            addQuote();
+    }
+
+    void addToBuffer(const String& toAdd, bool quotable) {
+        addToBuffer(toAdd.c_str(), quotable);
+    }
+
+    void addToBuffer(bool toAdd, bool quotable) {
+        addToBuffer(toAdd ? "true" : "false", false);
+    }
+
+    void addToBuffer(int toAdd, bool quotable) {
+        char number[12];
+        addToBuffer(ltoa(toAdd, number, 10), false);   // Numbers don't get quoted
+    }
+
+    void addToBuffer(uint16_t toAdd, bool quotable) {
+        char number[12];
+        addToBuffer(ultoa(toAdd, number, 10), false);   // Numbers don't get quoted
+    }
+
+    void addToBuffer(uint32_t toAdd, bool quotable) {
+        char number[12];
+        addToBuffer(ultoa(toAdd, number, 10), false);   // Numbers don't get quoted
+    }
+
+    void addToBuffer(long toAdd, bool quotable) {
+        char number[21];
+        addToBuffer(ltoa(toAdd, number, 10), false);   // Numbers don't get quoted
+    }
+
+    void addToBuffer(float toAdd, bool quotable) {
+        char number[24];
+        addToBuffer(dtostrf(toAdd, 1, 2, number), false);   // Numbers don't get quoted
+    }
+
+    /**
+     * @brief addToBuffer append string in flash to output buffer. Quotes and backslashes are escaped.
+     * @param toAdd string in flash
+     * @param quotable wrap string with quotes
+     */
+    void addToBuffer(const __FlashStringHelper* toAdd, bool quotable) {
+        if (quotable)
+            addQuote();
+
+        PGM_P p = reinterpret_cast<PGM_P>(toAdd);
+        for (char c = pgm_read_byte(p++); c != '\0'; c = pgm_read_byte(p++)) {
+            // Handle quoting quotes and backslashes
+            bool escaped = (c == '"' || c == '\\');
+            if (index + escaped >= buffer_size) {   // No room!
+                truncated = true;
+                return;
+            }
+            if (escaped)
+                buffer[index++] = '\\';
+            buffer[index++] = c;
+        }
+
+        if (quotable)
+            addQuote();
+    }
+
+    /**
+     * @brief append_raw_to_json append JSON text to output buffer as it is.
+     * @param json JSON text
+     */
+    void append_raw_to_json(const char* json) {
+        for (; *json != '\0'; json++) {
+            if (index >= buffer_size) {
+                truncated = true;
+                return;
+            }
+            buffer[index++] = *json;
+        }
+    }
+
+protected:
+    /**
+     * @brief process parses one and only one Request-Line i.e. (Method SP Request-URI SP HTTP-Version CRLF). Disregard the rest of HTTP conversation.
+     *
+     * @details
+     *  - Support four methods: GET, PUT, POST and DELETE. Disregard the rest of HTTP methods.
+     *      + GET method refers to READ value,
+     *      + PUT method refers to WRITE value,
+     *      + POST and DELETE methods are served by resources which allow them.
+     *  - Support two types of request URI:
+     *      + absoluteURI. i.e. http://wherever.com/pin1/?mode=digital&value=high
+     *      + abs_path. i.e. /pin1/?mode=digital&value=high
+     *
+     * @ref [RFC2616](https://www.ietf.org/rfc/rfc2616.txt)
+     * @param c one character from character stream
+     */
+    virtual void process(char c) {
+#if BREST_TRACE
+        PARSER_STATE previous_state = parser_state;
+#endif
+        process_char_counter++;
+#if BREST_WEBSOCKET
+        if (STATE_IN_FIRST_LF == parser_state || STATE_IGNORE == parser_state)
+            scan_websocket_key(c);
+#endif
+#if BREST_BINARY_FORMATS
+        if (STATE_IN_FIRST_LF == parser_state || STATE_IGNORE == parser_state)
+            accept_scanner.scan(c, STATE_IN_FIRST_LF == parser_state, request.format);
+#endif
+        switch(parser_state) {
+        // The length of URI is too long.
+        case STATE_OVERFLOW_URI:
+            if (c == '\r')
+                parser_state = STATE_IN_FIRST_CR;
+            break;
+
+        case STATE_START:
+            if (c == 'G')
+                parser_state = STATE_IN_GET_METHOD_G;
+            else if (c == 'P')
+                parser_state = STATE_IN_PUT_METHOD_P;
+            else if (c == 'D')
+                parser_state = STATE_IN_DELETE_METHOD_D;
+            else
+                parser_state = STATE_IGNORE_URI;
+            break;
+        // parse GET
+        case STATE_IN_GET_METHOD_G:
+            parser_state = (c == 'E')? STATE_IN_GET_METHOD_E: STATE_IGNORE_URI;
+            break;
+        case STATE_IN_GET_METHOD_E:
+            parser_state = (c == 'T')? STATE_IN_GET_METHOD_T: STATE_IGNORE_URI;
+            break;
+
+        // parse PUT, and POST sharing its P
+        case STATE_IN_PUT_METHOD_P:
+            if (c == 'U')
+                parser_state = STATE_IN_PUT_METHOD_U;
+            else if (c == 'O')
+                parser_state = STATE_IN_POST_METHOD_O;
+            else
+                parser_state = STATE_IGNORE_URI;
+            break;
+        case STATE_IN_PUT_METHOD_U:
+            parser_state = (c == 'T')? STATE_IN_PUT_METHOD_T: STATE_IGNORE_URI;
+            break;
+
+        // parse POST
+        case STATE_IN_POST_METHOD_O:
+            parser_state = (c == 'S')? STATE_IN_POST_METHOD_S: STATE_IGNORE_URI;
+            break;
+        case STATE_IN_POST_METHOD_S:
+            parser_state = (c == 'T')? STATE_IN_POST_METHOD_T: STATE_IGNORE_URI;
+            break;
+
+        // parse DELETE
+        case STATE_IN_DELETE_METHOD_D:
+            parser_state = (c == 'E')? STATE_IN_DELETE_METHOD_DE: STATE_IGNORE_URI;
+            break;
+        case STATE_IN_DELETE_METHOD_DE:
+            parser_state = (c == 'L')? STATE_IN_DELETE_METHOD_DEL: STATE_IGNORE_URI;
+            break;
+        case STATE_IN_DELETE_METHOD_DEL:
+            parser_state = (c == 'E')? STATE_IN_DELETE_METHOD_DELE: STATE_IGNORE_URI;
+            break;
+        case STATE_IN_DELETE_METHOD_DELE:
+            parser_state = (c == 'T')? STATE_IN_DELETE_METHOD_DELET: STATE_IGNORE_URI;
+            break;
+        case STATE_IN_DELETE_METHOD_DELET:
+            parser_state = (c == 'E')? STATE_IN_DELETE_METHOD_DELETE: STATE_IGNORE_URI;
+            break;
+
+        // end of parsing methods
+        case STATE_IN_GET_METHOD_T:
+            parser_state = (c == ' ')? STATE_IN_FIRST_SPACE: STATE_IGNORE_URI;
+            request.method = HTTP_METHOD_GET;
+            break;
+
+        case STATE_IN_PUT_METHOD_T:
+            parser_state = (c == ' ')? STATE_IN_FIRST_SPACE: STATE_IGNORE_URI;
+            request.method = HTTP_METHOD_PUT;
+            break;
+
+        case STATE_IN_POST_METHOD_T:
+            parser_state = (c == ' ')? STATE_IN_FIRST_SPACE: STATE_IGNORE_URI;
+            request.method = HTTP_METHOD_POST;
+            break;
+
+        case STATE_IN_DELETE_METHOD_DELETE:
+            parser_state = (c == ' ')? STATE_IN_FIRST_SPACE: STATE_IGNORE_URI;
+            request.method = HTTP_METHOD_DELETE;
+            break;
+
+        case STATE_IN_FIRST_SPACE:
             if (c == 'h' || c == '/') {
                 parser_state = STATE_IN_URI;
-                url_length_counter += 1;
-                http_url += c;
+                http_url[url_length_counter++] = c;
+#if BREST_URL_CACHE
+                url_hash = bRESTUrlCache::hash_char(url_hash, c);
+#endif
             } else
                 parser_state = STATE_IGNORE_URI;
             break;
 
         case STATE_IN_URI:
-            if (url_length_counter >= MAX_URL_LENGTH)  {
+            if (url_length_counter >= max_url_length)  {
                 parser_state = STATE_OVERFLOW_URI;
                 uri_final_state = STATE_OVERFLOW_URI;
                 break;
@@ -433,6 +1478,7 @@ protected:
             if (c == ' ') {
                 parser_state = STATE_IGNORE;
                 uri_final_state = STATE_ACCEPT_URI;
+                http_url[url_length_counter] = '\0';
             } else if (c == '\r') {
                 reset_uri_state_vars();
                 parser_state = STATE_IN_FIRST_CR;
@@ -440,8 +1486,10 @@ protected:
                 reset_uri_state_vars();
                 parser_state = STATE_IGNORE;
             } else {
-                url_length_counter += 1;
-                http_url += c;
+                http_url[url_length_counter++] = c;
+#if BREST_URL_CACHE
+                url_hash = bRESTUrlCache::hash_char(url_hash, c);
+#endif
             }
             break;
 
@@ -457,170 +1505,1623 @@ protected:
                 parser_state = STATE_IN_FIRST_CR;
             break;
 
-        case STATE_IN_FIRST_CR:
-            if (c == '\n')
-                parser_state = STATE_IN_FIRST_LF;
-            else
-                parser_state = STATE_IGNORE;
-            break;
+        case STATE_IN_FIRST_CR:
+            if (c == '\n')
+                parser_state = STATE_IN_FIRST_LF;
+            else
+                parser_state = STATE_IGNORE;
+            break;
+
+        case STATE_IN_FIRST_LF:
+            if (c == '\r')
+                parser_state = STATE_IN_SECOND_CR;
+            else
+                parser_state = STATE_IGNORE;
+            break;
+
+        case STATE_IN_SECOND_CR:
+            if (c == '\n')
+                parser_state = STATE_IN_SECOND_LF;
+            else
+                parser_state = STATE_IGNORE;
+            break;
+
+        case STATE_IN_SECOND_LF:
+            parser_state = STATE_IN_BODY;
+            http_body_final_state = STATE_IN_BODY;
+            http_body[request.body_length++] = c;
+            break;
+
+        case STATE_IN_BODY:
+            if (request.body_length >= max_http_body_length) {
+                parser_state = STATE_OVERFLOW_BODY;
+                http_body_final_state = STATE_OVERFLOW_BODY;
+            } else
+                http_body[request.body_length++] = c;
+            break;
+
+        case STATE_OVERFLOW_BODY:
+            if (c == '\r')
+                parser_state = STATE_IN_FIRST_CR;
+            break;
+
+        // final states are never parser states
+        default:
+            break;
+        } // end of switch
+
+#if BREST_TRACE
+        if (parser_state != previous_state)
+            BREST_TRACE_EVENT(TRACE_PARSER_STATE, (uint8_t)c, parser_state);
+#endif
+    }
+
+    /**
+     * @brief send_command executes command based on method and request URI from HTTP request
+     * @param headers
+     * @param decodeArgs
+     * @return
+     */
+    virtual bool send_command(bool headers, bool decodeArgs) {
+#if DEBUG
+        log("uri_final_state(%s), http_body_final_state(%s), parser_state(%s)\n",
+            get_state_string(uri_final_state).c_str(),
+            get_state_string(http_body_final_state).c_str(),
+            get_state_string(parser_state).c_str());
+#endif
+        // parse stage started with the request, and ends once request line is decoded and split
+        PARSE_RESULT parsed = PARSE_OK;
+        if (uri_final_state == STATE_OVERFLOW_URI) {
+            parsed = PARSE_URL_OVERFLOW;
+        } else if (http_body_final_state == STATE_OVERFLOW_BODY) {
+            parsed = PARSE_BODY_OVERFLOW;
+        } else if (uri_final_state != STATE_ACCEPT_URI) {
+            parsed = PARSE_INVALID;
+        } else {
+            bool is_url_valid = parse_request_line(decodeArgs);
+            BREST_TRACE_EVENT(TRACE_PARSE_URL, url_length_counter, is_url_valid? request.parm_count: 0xFFFF);
+            if (!is_url_valid)
+                parsed = PARSE_INVALID;
+        }
+        end_parse_stage();
+
+#if BREST_WEBSOCKET
+        if (PARSE_OK == parsed && headers && is_websocket_request()) {
+            fire_websocket();
+            return true;
+        }
+#endif
+
+        dispatch(parsed, headers);
+        return true;
+
+    }
+
+    /**
+     * @brief parse_request_line parse request URI received by process() into request, through request line cache
+     * @param decode percent-decode URI
+     * @return true if URI is valid. Otherwise, false.
+     */
+    bool parse_request_line(bool decode) {
+#if BREST_URL_CACHE
+        // URIs of compact requests do not come through process(), so they are not hashed
+        bool is_cacheable = process_char_counter > 0 && url_length_counter <= URL_CACHE_LINE_LENGTH;
+        char line[URL_CACHE_LINE_LENGTH];
+        if (is_cacheable) {
+            const bRESTUrlCacheEntry* entry = url_cache.find(url_hash, request.method, decode, http_url,
+                                                             url_length_counter);
+            if (entry != NULL) {
+                bRESTUrlCache::restore(*entry, http_url, request);
+                resolve_observer(entry->observer, entry->observer_index);
+                return true;
+            }
+            memcpy(line, http_url, url_length_counter);
+        }
+#endif
+
+        if(decode)
+            urldecode(http_url);   // Modifies http url
+#if BREST_URL_CACHE
+        // parse_url() splits URL in place, so take its length before
+        uint16_t parsed_length = strlen(http_url) + 1;
+#endif
+
+        if (!parse_url())
+            return false;
+
+#if BREST_URL_CACHE
+        if (is_cacheable) {
+            uint16_t observer_index = 0xFFFF;
+            Observer* observer = find_observer(request.resource_id, observer_index);
+            resolve_observer(observer, observer_index);
+            url_cache.store(url_hash, decode, line, url_length_counter, http_url, parsed_length, request,
+                            observer, observer_index);
+        }
+#endif
+        return true;
+    }
+
+    // index of resolved observer in observer list for tracing, 0xFFFF if routed
+    uint16_t get_resolved_index() {
+#if BREST_URL_CACHE
+        if (is_observer_resolved)
+            return resolved_index;
+#endif
+        return 0xFFFF;
+    }
+
+#if BREST_URL_CACHE
+    void resolve_observer(Observer* observer, uint16_t observer_index) {
+        resolved_observer = observer;
+        resolved_index = observer_index;
+        is_observer_resolved = true;
+    }
+
+    /**
+     * @brief find_observer find the one resource serving resource ID, in route table, then in observer list
+     * @param id resource ID
+     * @param observer_index set to index of observer in observer list. Left as is if routed.
+     * @return resource, or NULL if there is none or several observers share resource ID
+     */
+    Observer* find_observer(char* id, uint16_t& observer_index) {
+        Observer* p_routed = route_table.lookup(id);
+        if (p_routed != NULL)
+            return p_routed;
+
+        Observer* p_found = NULL;
+        for (unsigned int i = 0; i < observer_counter; i++) {
+            if (observer_list[i]->matches_id(id)) {
+                if (p_found != NULL)
+                    return NULL;
+                p_found = observer_list[i];
+                observer_index = i;
+            }
+        }
+        return p_found;
+    }
+#endif
+
+    /**
+     * @brief dispatch serve request of any transport. Every transport ends in it, after parsing into request.
+     * @details Parser errors are replied with error messages. Otherwise, request is routed to reserved endpoint or
+     *          to resources.
+     * @param parsed result of parser
+     * @param headers should include HTTP headers
+     */
+    void dispatch(PARSE_RESULT parsed, bool headers) {
+        switch (parsed) {
+        case PARSE_URL_OVERFLOW:
+#if BREST_METRICS
+            metrics.url_overflows++;
+#endif
+            append_msg_url_overflow(headers);
+            return;
+
+        case PARSE_BODY_OVERFLOW:
+#if BREST_METRICS
+            metrics.body_overflows++;
+#endif
+            append_msg_body_overflow(headers);
+            return;
+
+        case PARSE_INVALID:
+            append_msg_invalid_request(headers);
+            return;
+
+        default:
+            break;
+        }
+
+#if DEBUG
+       log("bREST::dispatch() -- Method: %s", bREST::get_method(request.method).c_str());
+        for(int i = 0; i < request.parm_count; i++) {
+            log(", Parm: %s = %s", request.parms[i], request.value[i]);
+        }
+        log("\n");
+#endif
+
+#if BREST_METRICS
+        if (0 == strcasecmp_P(request.resource_id, PSTR(METRICS_RESOURCE_ID))) {
+            append_metrics(headers);
+            return;
+        }
+#endif
+
+#if BREST_TRACE
+        if (0 == strcasecmp_P(request.resource_id, PSTR(TRACE_RESOURCE_ID))) {
+            append_trace(headers);
+            return;
+        }
+#endif
+
+#if BREST_CAPTURE
+        if (0 == strcasecmp_P(request.resource_id, PSTR(CAPTURE_RESOURCE_ID))) {
+            append_capture(headers);
+            return;
+        }
+#endif
+
+#if BREST_BATCH
+        if (0 == strcasecmp_P(request.resource_id, PSTR(BATCH_RESOURCE_ID))) {
+            append_batch(headers);
+            return;
+        }
+#endif
+
+        // error messages and reserved endpoints above are JSON text. Resources render the format client asked for.
+        response_format = request.format;
+        MESSAGE_STATUS_CODE status = notify_observers(headers);
+        if (CODE_ERROR_INVALID_HTTP_METHOD == status) {
+            response_format = RESPONSE_FORMAT_JSON;
+            append_msg_method_not_allowed(headers);
+        } else if (CODE_ERROR_NO_OBSERVERS_ACTIVATED == status) {
+            response_format = RESPONSE_FORMAT_JSON;
+            record_error(CODE_ERROR_NO_OBSERVERS_ACTIVATED);
+            if(headers)
+                BREST_TEMPLATE(RESPONSE_NO_OBSERVERS)::fill(this);
+            else
+                BREST_TEMPLATE(LINE_NO_OBSERVERS)::fill(this);
+        }
+    }
+
+    /**
+     * @brief notify_observers notifies subscribed observer to process HTTP request.
+     * @details Resources that do not allow method of request are not fired, and nothing is written for them.
+     * @param headers should include HTTP headers
+     * @return CODE_OK if trigger any observer update. CODE_ERROR_INVALID_HTTP_METHOD if resources are found but none
+     *         allows method. Otherwise, CODE_ERROR_NO_OBSERVERS_ACTIVATED.
+     */
+    MESSAGE_STATUS_CODE notify_observers(bool headers) {
+        bool is_observer_fired = false;
+        bool is_method_refused = false;
+
+        // resolved by request line cache, a NULL observer skips route table but not observer list
+#if BREST_URL_CACHE
+        Observer* p_resolved = is_observer_resolved? resolved_observer: route_table.lookup(request.resource_id);
+#else
+        Observer* p_resolved = route_table.lookup(request.resource_id);
+#endif
+        if (p_resolved != NULL) {
+            if (!p_resolved->allows(request.method)) {
+                BREST_TRACE_EVENT(TRACE_NOTIFY_NONE, route_table.route_count, observer_counter);
+                return CODE_ERROR_INVALID_HTTP_METHOD;
+            }
+            BREST_TRACE_EVENT(TRACE_NOTIFY_OBSERVER, get_resolved_index(), request.method);
+#if BREST_STREAMS
+            if (headers && is_stream_request()) {
+                fire_stream(p_resolved);
+                return CODE_OK;
+            }
+#endif
+            if(headers)
+                append_http_header(true);
+
+            fire_observer(p_resolved);
+            return CODE_OK;
+        }
+
+        for (unsigned int i = 0 ; i < observer_counter; i++) {
+
+            Observer* p_resource = observer_list[i];
+
+            if(p_resource->matches_id(request.resource_id)) {
+                if (!p_resource->allows(request.method)) {
+                    is_method_refused = true;
+                    continue;
+                }
+                is_observer_fired = true;
+                BREST_TRACE_EVENT(TRACE_NOTIFY_OBSERVER, i, request.method);
+#if BREST_STREAMS
+                if (headers && is_stream_request()) {
+                    fire_stream(p_resource);
+                    return CODE_OK;
+                }
+#endif
+
+                if(headers)
+                    append_http_header(true);
+
+                fire_observer(p_resource);
+            }
+        }
+
+        if (is_observer_fired)
+            return CODE_OK;
+
+        BREST_TRACE_EVENT(TRACE_NOTIFY_NONE, route_table.route_count, observer_counter);
+        return is_method_refused? CODE_ERROR_INVALID_HTTP_METHOD: CODE_ERROR_NO_OBSERVERS_ACTIVATED;
+    }
+
+#if BREST_STREAMS
+    /**
+     * @brief is_stream_request check whether current request is GET with parameter stream=1
+     * @return true if client subscribes to resource. Otherwise, false.
+     */
+    bool is_stream_request() {
+        return HTTP_METHOD_GET == request.method && request.get_bool(F("stream"), false);
+    }
+
+    /**
+     * @brief fire_stream reply with event stream headers and the first event, and mark client to subscribe
+     * @param p_resource subscribed resource
+     */
+    void fire_stream(Observer* p_resource) {
+        // events are JSON text
+        response_format = RESPONSE_FORMAT_JSON;
+        if (MAX_STREAM_SUBSCRIBERS == get_subscriber_count()) {
+            record_error(CODE_ERROR_TOO_MANY_SUBSCRIBERS);
+            BREST_TEMPLATE(RESPONSE_TOO_MANY_STREAMS)::fill(this);
+            return;
+        }
+
+        addToBufferF(F("HTTP/1.1 200 OK\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n\r\ndata: "));
+        // events render resource without parameters, so does the first one
+        request.parm_count = 0;
+        fire_observer(p_resource);
+        addToBufferF(F("\n"));
+        stream_observer = p_resource;
+    }
+
+    /**
+     * @brief subscribe hold client to push events of resource
+     * @param client network client
+     * @param p_resource subscribed resource
+     */
+    template <typename T>
+    void subscribe(T& client, Observer* p_resource) {
+        for (uint8_t i = 0; i < MAX_STREAM_SUBSCRIBERS; i++) {
+            if (NULL == streams[i].observer) {
+                if (streams[i].attach(client, p_resource))
+                    return;
+                break;
+            }
+        }
+        client.stop();
+    }
+
+    /**
+     * @brief render_event render GET representation of resource as event into event buffer of subscriber
+     * @param slot subscriber
+     */
+    void render_event(bRESTStreamSlot& slot) {
+        char* response_buffer = buffer;
+        uint16_t response_buffer_size = buffer_size;
+        uint16_t response_index = index;
+        bool response_truncated = truncated;
+        HTTP_METHOD request_method = request.method;
+        unsigned int request_parm_counter = request.parm_count;
+
+        buffer = slot.event;
+        buffer_size = MAX_STREAM_EVENT_SIZE;
+        index = 0;
+        truncated = false;
+        request.method = HTTP_METHOD_GET;
+        request.parm_count = 0;
+
+        addToBufferF(F("data: "));
+        invoke(slot.observer);
+        addToBufferF(F("\n"));
+        // a truncated event is not valid JSON
+        slot.length = truncated? 0: index;
+        slot.sent = 0;
+        slot.pending = false;
+        record_truncation();
+
+        buffer = response_buffer;
+        buffer_size = response_buffer_size;
+        index = response_index;
+        truncated = response_truncated;
+        request.method = request_method;
+        request.parm_count = request_parm_counter;
+    }
+#endif
+
+    /**
+     * @brief hold_or_stop keep connection of client that subscribes to stream or upgrades to WebSocket. Otherwise,
+     *        close it.
+     * @param client network client
+     */
+    template <typename T>
+    void hold_or_stop(T& client) {
+#if BREST_WEBSOCKET
+        if (websocket_upgrade) {
+            open_websocket(client);
+            return;
+        }
+#endif
+#if BREST_STREAMS
+        if (stream_observer != NULL) {
+            subscribe(client, stream_observer);
+            return;
+        }
+#endif
+        client.stop();
+    }
+
+#if BREST_WEBSOCKET
+    /**
+     * @brief scan_websocket_key match header lines against "Sec-WebSocket-Key:" and collect its value
+     * @param c one character of header line
+     */
+    void scan_websocket_key(char c) {
+        // header line starts
+        if (STATE_IN_FIRST_LF == parser_state)
+            websocket_key_match = 0;
+
+        if (websocket_key_match < WEBSOCKET_KEY_HEADER_LENGTH) {
+            const char* header = PSTR("sec-websocket-key:");
+            if (tolower(c) == (char)pgm_read_byte(header + websocket_key_match))
+                websocket_key_match++;
+            else
+                websocket_key_match = WEBSOCKET_KEY_NO_MATCH;
+        } else if (WEBSOCKET_KEY_HEADER_LENGTH == websocket_key_match) {
+            if (c == '\r')
+                websocket_key_match = WEBSOCKET_KEY_NO_MATCH;
+            else if (c == ' ' || c == '\t')
+                return;
+            else if (websocket_key_length < WEBSOCKET_KEY_LENGTH)
+                websocket_key[websocket_key_length++] = c;
+            else
+                // too long to be a key
+                websocket_key_length = WEBSOCKET_KEY_LENGTH + 1;
+        }
+    }
+
+    /**
+     * @brief is_websocket_request check whether current request is GET with Sec-WebSocket-Key header
+     * @return true if client asks to upgrade to WebSocket. Otherwise, false.
+     */
+    bool is_websocket_request() {
+        return HTTP_METHOD_GET == request.method && WEBSOCKET_KEY_LENGTH == websocket_key_length;
+    }
+
+    /**
+     * @brief fire_websocket reply with handshake of RFC 6455, and mark client to upgrade
+     */
+    void fire_websocket() {
+        if (MAX_WEBSOCKETS == get_websocket_count()) {
+            record_error(CODE_ERROR_TOO_MANY_SUBSCRIBERS);
+            BREST_TEMPLATE(RESPONSE_TOO_MANY_WEBSOCKETS)::fill(this);
+            return;
+        }
+
+        char accept[WEBSOCKET_ACCEPT_LENGTH + 1];
+        websocket_key[WEBSOCKET_KEY_LENGTH] = '\0';
+        brest_websocket_accept(websocket_key, accept);
+        addToBufferF(F("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: "));
+        addToBuffer(accept, false);
+        addToBufferF(F("\r\n\r\n"));
+        // a truncated handshake fails on client anyway
+        websocket_upgrade = !truncated;
+    }
+
+    /**
+     * @brief open_websocket hold client in a free WebSocket connection
+     * @param client network client
+     */
+    template <typename T>
+    void open_websocket(T& client) {
+        for (uint8_t i = 0; i < MAX_WEBSOCKETS; i++) {
+            if (!websockets[i].is_open()) {
+                if (websockets[i].attach(client))
+                    return;
+                break;
+            }
+        }
+        client.stop();
+    }
+
+    /**
+     * @brief serve_websocket react on received message or control frame
+     * @param websocket connection
+     * @param received result of bRESTWebSocket::receive()
+     */
+    void serve_websocket(bRESTWebSocket& websocket, WS_RECEIVE received) {
+        switch (received) {
+        case WS_RECEIVE_MESSAGE:
+            serve_websocket_message(websocket);
+            break;
+
+        case WS_RECEIVE_CONTROL:
+            if (WS_OPCODE_PING == websocket.get_control_opcode()) {
+                websocket.send_frame(WS_OPCODE_PONG, websocket.get_control(), websocket.get_control_length());
+            } else if (WS_OPCODE_CLOSE == websocket.get_control_opcode()) {
+                // echo status code of client
+                websocket.send_frame(WS_OPCODE_CLOSE, websocket.get_control(),
+                                     (websocket.get_control_length() < 2)? websocket.get_control_length(): 2);
+                websocket.release();
+            }
+            break;
+
+        case WS_RECEIVE_TOO_BIG:
+            websocket.send_close(WEBSOCKET_CLOSE_TOO_BIG);
+            websocket.release();
+            break;
+
+        default:
+            websocket.send_close(WEBSOCKET_CLOSE_PROTOCOL_ERROR);
+            websocket.release();
+            break;
+        }
+    }
+
+    /**
+     * @brief serve_websocket_message dispatch message as compact request and send response as one text frame
+     * @param websocket connection
+     */
+    void serve_websocket_message(bRESTWebSocket& websocket) {
+        // reserve room for frame header in front of response
+        handle_compact((const char*)websocket.get_message(), websocket.get_message_length(),
+                       WEBSOCKET_FRAME_HEADER_RESERVE);
+
+        uint32_t start = metrics_clock();
+        uint16_t length = index - WEBSOCKET_FRAME_HEADER_RESERVE;
+        uint8_t* frame = (uint8_t*)buffer + WEBSOCKET_FRAME_HEADER_RESERVE - bRESTWebSocket::frame_header_size(length);
+        bRESTWebSocket::encode_frame_header(frame, WS_OPCODE_TEXT, length);
+        websocket.write_frame(frame, (uint8_t*)buffer + index - frame);
+        record_stage(STAGE_SEND, start);
+        resetBuffer();
+    }
+#endif
+
+    /**
+     * @brief parse_compact_request translate a compact request into request URI and method
+     * @details "PUT servo1 angle=120 speed=2" is "/servo1/?angle=120&speed=2", and "GET /servo1/?id=1" is taken as is.
+     * @param message compact request, not NUL terminated
+     * @param length length of message
+     * @return true if message has method and resource. Otherwise, false.
+     */
+    bool parse_compact_request(const char* message, uint16_t length) {
+        const char* end = message + length;
+        const char* method = message;
+        while (message < end && !is_compact_separator(*message))
+            message++;
+        if (3 == message - method && 0 == strncmp_P(method, PSTR("GET"), 3))
+            request.method = HTTP_METHOD_GET;
+        else if (3 == message - method && 0 == strncmp_P(method, PSTR("PUT"), 3))
+            request.method = HTTP_METHOD_PUT;
+        else if (4 == message - method && 0 == strncmp_P(method, PSTR("POST"), 4))
+            request.method = HTTP_METHOD_POST;
+        else if (6 == message - method && 0 == strncmp_P(method, PSTR("DELETE"), 6))
+            request.method = HTTP_METHOD_DELETE;
+        else
+            return false;
+
+        url_length_counter = 0;
+        bool is_resource = true;
+        bool has_parms = false;
+        while (true) {
+            while (message < end && is_compact_separator(*message))
+                message++;
+            if (message == end)
+                break;
+
+            if (is_resource) {
+                if (*message != '/')
+                    append_to_url('/');
+            } else if (!has_parms) {
+                if (url_length_counter > 0 && http_url[url_length_counter - 1] != '/')
+                    append_to_url('/');
+                append_to_url('?');
+                has_parms = true;
+            } else {
+                append_to_url('&');
+            }
+
+            for (; message < end && !is_compact_separator(*message); message++) {
+                has_parms = has_parms || ('?' == *message);
+                append_to_url(*message);
+            }
+            is_resource = false;
+        }
+
+        if (is_resource)
+            return false;
+        if (uri_final_state != STATE_OVERFLOW_URI) {
+            http_url[url_length_counter] = '\0';
+            uri_final_state = STATE_ACCEPT_URI;
+        }
+        return true;
+    }
+
+    static bool is_compact_separator(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    void append_to_url(char c) {
+        if (url_length_counter >= max_url_length)
+            uri_final_state = STATE_OVERFLOW_URI;
+        else
+            http_url[url_length_counter++] = c;
+    }
+
+#if BREST_BATCH
+    /**
+     * @brief append_batch run operations of /_batch and reply with JSON array of their results
+     * @param headers should include HTTP headers
+     */
+    void append_batch(bool headers) {
+        // requests of operations overwrite parms, so take batch parameters first
+        const char* query_ops = request.get(F("ops"));
+        bool atomic = request.get_bool(F("atomic"), false);
+        bRESTBatchOperations operations(query_ops, (const char*)request.body, request.body_length);
+
+        // request URI of each operation is parsed in a buffer of its own
+        char operation_url[MAX_BATCH_OPERATION_LENGTH + 1];
+        char* batch_url = http_url;
+        unsigned int batch_max_url_length = max_url_length;
+        http_url = operation_url;
+        max_url_length = MAX_BATCH_OPERATION_LENGTH;
+
+        int invalid = atomic? find_invalid_batch_operation(operations): -1;
+        if (invalid != -1) {
+            record_error(CODE_ERROR_INVALID_URL);
+            if (headers)
+                BREST_TEMPLATE(RESPONSE_INVALID_BATCH)::fill(this, invalid);
+            else
+                BREST_TEMPLATE(LINE_INVALID_BATCH)::fill(this, invalid);
+        } else {
+            if (headers)
+                append_http_header(true);
+            addToBufferF(F("["));
+            in_batch = true;
+            run_batch_operations(operations);
+            in_batch = false;
+            addToBufferF(F("]\r\n"));
+            // errors of operations are reported in their elements
+            last_status = CODE_OK;
+        }
+
+        http_url = batch_url;
+        max_url_length = batch_max_url_length;
+    }
+
+    /**
+     * @brief find_invalid_batch_operation check that every operation parses and has a resource
+     * @param operations operations of batch
+     * @return index of the first invalid operation, or -1 if all are valid
+     */
+    int find_invalid_batch_operation(bRESTBatchOperations& operations) {
+        const char* operation;
+        uint16_t length;
+        operations.rewind();
+        for (int i = 0; operations.next(operation, length); i++) {
+            if (!prepare_batch_operation(operation, length) || !has_observer(request.resource_id, request.method))
+                return i;
+        }
+        return -1;
+    }
+
+    /**
+     * @brief run_batch_operations dispatch operations in order and append their results as array elements
+     * @param operations operations of batch
+     */
+    void run_batch_operations(bRESTBatchOperations& operations) {
+        const char* operation;
+        uint16_t length;
+        operations.rewind();
+        for (int i = 0; operations.next(operation, length); i++) {
+            if (i > 0)
+                addToBufferF(F(","));
+
+            uint16_t element_start = index;
+            MESSAGE_STATUS_CODE status = prepare_batch_operation(operation, length)? notify_observers(false):
+                                                                                     CODE_ERROR_INVALID_URL;
+            if (status != CODE_OK)
+                record_error(status);
+
+            if (CODE_ERROR_INVALID_URL == status) {
+                addToBufferF(F("{" MSG_INVALID_URL "}"));
+            } else if (CODE_ERROR_NO_OBSERVERS_ACTIVATED == status) {
+                addToBufferF(F("{" MSG_NO_OBSERVERS "}"));
+            } else if (CODE_ERROR_INVALID_HTTP_METHOD == status) {
+                addToBufferF(F("{" MSG_METHOD_NOT_ALLOWED "}"));
+            } else if (index == element_start) {
+                // resource replied nothing
+                addToBufferF(F("null"));
+            } else if (index >= element_start + 2 && '\r' == buffer[index - 2] && '\n' == buffer[index - 1]) {
+                // resource rendered a whole message itself, i.e. from a template
+                index -= 2;
+            }
+        }
+    }
+
+    /**
+     * @brief prepare_batch_operation parse operation into method, resource ID and parameters of current request
+     * @param operation compact request
+     * @param length length of operation
+     * @return true if operation is valid. Otherwise, false.
+     */
+    bool prepare_batch_operation(const char* operation, uint16_t length) {
+        uri_final_state = STATE_START;
+        request.parm_count = 0;
+#if BREST_URL_CACHE
+        is_observer_resolved = false;
+#endif
+        return parse_compact_request(operation, length) && STATE_ACCEPT_URI == uri_final_state && parse_url();
+    }
+
+    /**
+     * @brief has_observer check whether route table or observer list has resource allowing method
+     * @param id resource ID
+     * @param method HTTP method
+     * @return true if found. Otherwise, false.
+     */
+    bool has_observer(char* id, HTTP_METHOD method) {
+        Observer* p_routed = route_table.lookup(id);
+        if (p_routed != NULL)
+            return p_routed->allows(method);
+        for (unsigned int i = 0; i < observer_counter; i++) {
+            if (observer_list[i]->matches_id(id) && observer_list[i]->allows(method))
+                return true;
+        }
+        return false;
+    }
+#endif
+
+    /**
+     * @brief The ObserverCall struct holds clock and allocation counters when resource call back starts.
+     */
+    struct ObserverCall {
+        uint32_t start;
+#if BREST_ALLOC_TRACKING
+        bRESTAllocCounters allocations;
+#endif
+    };
+
+    /**
+     * @brief fire_observer fire resource call back and record dispatch latency.
+     * @param p_resource resource
+     */
+    void fire_observer(Observer* p_resource) {
+        record_stage(STAGE_DISPATCH, stage_start);
+        invoke(p_resource);
+        stage_start = metrics_clock();
+    }
+
+    /**
+     * @brief invoke run resource call back and account it to resource.
+     * @details Override it to wrap call back, i.e. host server serializes resources across threads.
+     * @param p_resource resource
+     */
+    virtual void invoke(Observer* p_resource) {
+        ObserverCall call = begin_call();
+        call_observer(p_resource);
+        end_call(p_resource, call);
+    }
+
+    /**
+     * @brief call_observer run resource call back with parameters of current request
+     * @param p_resource resource
+     */
+    void call_observer(Observer* p_resource) {
+        if (NULL == p_resource->method_handlers) {
+            p_resource->on_request(request.method, request.parms, request.value, request.parm_count, this);
+            return;
+        }
+        // notify_observers() checks that resource allows method
+        ObserverMethodHandler handler = p_resource->method_handlers[request.method];
+        if (handler != NULL)
+            handler(p_resource, request, this);
+    }
+
+    ObserverCall begin_call() {
+        ObserverCall call;
+        call.start = metrics_clock();
+#if BREST_ALLOC_TRACKING
+        call.allocations = bRESTAllocCounters::instance();
+#endif
+        return call;
+    }
+
+    /**
+     * @brief end_call record update() latency and allocations of resource call back
+     * @param p_resource resource
+     * @param call taken by begin_call() before call back
+     */
+    void end_call(Observer* p_resource, const ObserverCall& call) {
+#if BREST_ALLOC_TRACKING
+        bRESTAllocUsage callback_usage;
+        callback_usage.allocations = bRESTAllocCounters::instance().allocations - call.allocations.allocations;
+        callback_usage.allocated_bytes = bRESTAllocCounters::instance().allocated_bytes - call.allocations.allocated_bytes;
+        p_resource->alloc_usage.add(callback_usage);
+        fired_observer = p_resource;
+#endif
+
+#if BREST_METRICS
+        uint32_t elapsed = metrics_clock() - call.start;
+        metrics.stages[STAGE_UPDATE].record(elapsed);
+        p_resource->metrics.update.record(elapsed);
+        if (request.method < HTTP_METHOD_UNSET)
+            p_resource->metrics.requests[request.method]++;
+#endif
+    }
+
+    /**
+     * @brief begin_request paint free stack and take allocation counters when request starts
+     */
+    void begin_request() {
+        last_status = CODE_OK;
+#if BREST_ALLOC_TRACKING
+        request_start = bRESTAllocCounters::instance();
+        fired_observer = NULL;
+        stack_painter.paint();
+#endif
+    }
+
+    /**
+     * @brief end_request account heap and stack usage of request to bREST and to the fired resource
+     */
+    void end_request() {
+#if BREST_ALLOC_TRACKING
+        last_request_usage.allocations = bRESTAllocCounters::instance().allocations - request_start.allocations;
+        last_request_usage.allocated_bytes = bRESTAllocCounters::instance().allocated_bytes - request_start.allocated_bytes;
+        last_request_usage.max_request_allocations = last_request_usage.allocations;
+        last_request_usage.stack_high_water = stack_painter.high_water();
+        alloc_usage.add(last_request_usage);
+
+        if (fired_observer != NULL) {
+            bRESTAllocUsage& usage = fired_observer->alloc_usage;
+            if (last_request_usage.allocations > usage.max_request_allocations)
+                usage.max_request_allocations = last_request_usage.allocations;
+            if (last_request_usage.stack_high_water > usage.stack_high_water)
+                usage.stack_high_water = last_request_usage.stack_high_water;
+        }
+#endif
+    }
+
+    /**
+     * @brief finish_request account request whose response stays in output buffer, and get ready for next one
+     */
+    void finish_request() {
+        end_request();
+        record_truncation();
+        reset_status();
+    }
+
+    /**
+     * @brief metrics_clock read clock of stage latency. It costs nothing if metrics are disabled.
+     * @return microseconds
+     */
+    static uint32_t metrics_clock() {
+#if BREST_METRICS
+        return micros();
+#else
+        return 0;
+#endif
+    }
+
+    /**
+     * @brief record_stage record latency of request stage
+     * @param stage request stage
+     * @param start start of stage by metrics_clock()
+     */
+    void record_stage(METRICS_STAGE stage, uint32_t start) {
+#if BREST_METRICS
+        metrics.stages[stage].record(metrics_clock() - start);
+#endif
+    }
+
+    /**
+     * @brief end_parse_stage record parse latency since stage_start, and start dispatch stage
+     */
+    void end_parse_stage() {
+        record_stage(STAGE_PARSE, stage_start);
+        stage_start = metrics_clock();
+    }
+
+    /**
+     * @brief record_truncation count response that did not fit in output buffer
+     */
+    void record_truncation() {
+#if BREST_METRICS
+        if (truncated)
+            metrics.truncated_responses++;
+#endif
+    }
+
+    void append_http_header(bool isOK) {
+        if(isOK)
+            addToBufferF(F("HTTP/1.1 200 OK\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: "));
+        else
+            addToBufferF(F("HTTP/1.1 500\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: "));
+        addToBufferF(get_content_type(response_format));
+        addToBufferF(F("\r\nConnection: close\r\n\r\n"));
+    }
+
+    void append_msg_url_overflow(bool headers) {
+        record_error(CODE_ERROR_URL_PARSING_OVERFLOW);
+        if (headers)
+            BREST_TEMPLATE(RESPONSE_URL_OVERFLOW)::fill(this);
+        else
+            BREST_TEMPLATE(LINE_URL_OVERFLOW)::fill(this);
+    }
+
+    void append_msg_body_overflow(bool headers) {
+        record_error(CODE_ERROR_URL_PARSING_OVERFLOW);
+        if (headers)
+            BREST_TEMPLATE(RESPONSE_BODY_OVERFLOW)::fill(this);
+        else
+            BREST_TEMPLATE(LINE_BODY_OVERFLOW)::fill(this);
+    }
+
+    void append_msg_invalid_request(bool headers) {
+        record_error(CODE_ERROR_INVALID_URL);
+        if (headers)
+            BREST_TEMPLATE(RESPONSE_INVALID_URL)::fill(this);
+        else
+            BREST_TEMPLATE(LINE_INVALID_URL)::fill(this);
+    }
+
+    void append_msg_method_not_allowed(bool headers) {
+        record_error(CODE_ERROR_INVALID_HTTP_METHOD);
+        if (headers)
+            BREST_TEMPLATE(RESPONSE_METHOD_NOT_ALLOWED)::fill(this);
+        else
+            BREST_TEMPLATE(LINE_METHOD_NOT_ALLOWED)::fill(this);
+    }
+
+    void append_key_to_json(const String& key) {
+        append_key_to_json(key.c_str());
+    }
+
+    void append_key_to_json(const char* key) {
+        message_key_count++;
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON) {
+            append_binary_string(key);
+            return;
+        }
+#endif
+        addToBufferF(F("\""));
+        addToBuffer(key, false);
+        addToBufferF(F("\":"));
+    }
+
+    void append_key_to_json(const __FlashStringHelper* key) {
+        message_key_count++;
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON) {
+            append_binary_string(key);
+            return;
+        }
+#endif
+        addToBufferF(F("\""));
+        addToBuffer(key, false);
+        addToBufferF(F("\":"));
+    }
+
+    void append_key_fragment(PGM_P fragment) {
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON) {
+            message_key_count++;
+            // name lies between ," and ":
+            append_binary_string(fragment + 2, strlen_P(fragment) - 4);
+            return;
+        }
+#endif
+        addToBufferF(FPSTR((0 == message_key_count++)? fragment + 1: fragment));
+    }
+
+    /**
+     * @brief append_value append value of key value pair in response format. Strings are quoted in JSON.
+     * @param value
+     */
+    void append_value(bool value) {
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON) {
+            uint8_t head[BINARY_FORMAT_HEAD_SIZE];
+            append_bytes(head, bRESTBinaryFormat::encode_bool(response_format, value, head));
+            return;
+        }
+#endif
+        addToBuffer(value, false);
+    }
+
+    void append_value(int value) {
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON) {
+            uint8_t head[BINARY_FORMAT_HEAD_SIZE];
+            append_bytes(head, bRESTBinaryFormat::encode_int(response_format, value, head));
+            return;
+        }
+#endif
+        addToBuffer(value, false);
+    }
+
+    void append_value(long value) {
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON) {
+            uint8_t head[BINARY_FORMAT_HEAD_SIZE];
+            append_bytes(head, bRESTBinaryFormat::encode_int(response_format, value, head));
+            return;
+        }
+#endif
+        char number[21];
+        addToBuffer(ltoa(value, number, 10), false);   // Numbers don't get quoted
+    }
+
+    void append_value(unsigned long value) {
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON) {
+            uint8_t head[BINARY_FORMAT_HEAD_SIZE];
+            append_bytes(head, bRESTBinaryFormat::encode_uint(response_format, value, head));
+            return;
+        }
+#endif
+        char number[21];
+        addToBuffer(ultoa(value, number, 10), false);   // Numbers don't get quoted
+    }
+
+    void append_value(float value) {
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON) {
+            uint8_t head[BINARY_FORMAT_HEAD_SIZE];
+            append_bytes(head, bRESTBinaryFormat::encode_float(response_format, value, head));
+            return;
+        }
+#endif
+        addToBuffer(value, false);
+    }
+
+    void append_value(const String& value) {
+        append_value(value.c_str());
+    }
 
-        case STATE_IN_FIRST_LF:
-            if (c == '\r')
-                parser_state = STATE_IN_SECOND_CR;
-            else
-                parser_state = STATE_IGNORE;
-            break;
+    void append_value(const char* value) {
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON) {
+            append_binary_string(value);
+            return;
+        }
+#endif
+        addToBuffer(value, true);
+    }
 
-        case STATE_IN_SECOND_CR:
-            if (c == '\n')
-                parser_state = STATE_IN_SECOND_LF;
-            else
-                parser_state = STATE_IGNORE;
-            break;
+    void append_value(const __FlashStringHelper* value) {
+#if BREST_BINARY_FORMATS
+        if (response_format != RESPONSE_FORMAT_JSON) {
+            append_binary_string(value);
+            return;
+        }
+#endif
+        addToBuffer(value, true);
+    }
 
-        case STATE_IN_SECOND_LF:
-            parser_state = STATE_IN_BODY;
-            http_body_final_state = STATE_IN_BODY;
-            http_body[body_length_counter++] = c;
-            break;
+#if BREST_BINARY_FORMATS
+    /**
+     * @brief append_bytes append bytes of binary format, all or none, so that a truncated response stays decodable
+     *        up to where it is cut
+     * @param bytes bytes
+     * @param length number of bytes
+     */
+    void append_bytes(const uint8_t* bytes, uint16_t length) {
+        if (index + length > buffer_size) {
+            truncated = true;
+            return;
+        }
+        memcpy(buffer + index, bytes, length);
+        index += length;
+    }
 
-        case STATE_IN_BODY:
-            if (body_length_counter >= MAX_HTTP_BODY_LENGTH) {
-                parser_state = STATE_OVERFLOW_BODY;
-                http_body_final_state = STATE_OVERFLOW_BODY;
-            } else
-                http_body[body_length_counter++] = c;
-            break;
+    void append_binary_string(const char* string) {
+        uint16_t length = strlen(string);
+        uint8_t head[BINARY_FORMAT_HEAD_SIZE];
+        uint8_t head_length = bRESTBinaryFormat::encode_string_head(response_format, length, head);
+        if (index + head_length + length > buffer_size) {
+            truncated = true;
+            return;
+        }
+        append_bytes(head, head_length);
+        append_bytes((const uint8_t*)string, length);
+    }
 
-        case STATE_OVERFLOW_BODY:
-            if (c == '\r')
-                parser_state = STATE_IN_FIRST_CR;
-            break;
+    void append_binary_string(const __FlashStringHelper* string) {
+        PGM_P p = reinterpret_cast<PGM_P>(string);
+        append_binary_string(p, strlen_P(p));
+    }
 
-        } // end of switch
+    /**
+     * @brief append_binary_string append string in flash
+     * @param p string in flash
+     * @param length number of characters, which need no NUL terminator
+     */
+    void append_binary_string(PGM_P p, uint16_t length) {
+        uint8_t head[BINARY_FORMAT_HEAD_SIZE];
+        uint8_t head_length = bRESTBinaryFormat::encode_string_head(response_format, length, head);
+        if (index + head_length + length > buffer_size) {
+            truncated = true;
+            return;
+        }
+        append_bytes(head, head_length);
+        memcpy_P(buffer + index, p, length);
+        index += length;
     }
 
     /**
-     * @brief send_command executes command based on method and request URI from HTTP request
-     * @param headers
-     * @param decodeArgs
-     * @return
+     * @brief end_binary_map write size of map over placeholder of start_json_msg(), moving pairs if it takes more
+     *        than one byte
      */
-    bool send_command(bool headers, bool decodeArgs) override {
-#if DEBUG
-        log("uri_final_state(%s), http_body_final_state(%s), parser_state(%s)\n",
-            get_state_string(uri_final_state).c_str(),
-            get_state_string(http_body_final_state).c_str(),
-            get_state_string(parser_state).c_str());
-#endif
-        if (uri_final_state == STATE_OVERFLOW_URI) {
-            append_msg_url_overflow(headers);
-            return true;
+    void end_binary_map() {
+        uint8_t head[BINARY_FORMAT_HEAD_SIZE];
+        uint8_t head_length = bRESTBinaryFormat::encode_map_head(response_format, message_key_count, head);
+        if (index <= message_start || index + head_length - 1 > buffer_size) {
+            truncated = true;
+            return;
         }
+        memmove(buffer + message_start + head_length, buffer + message_start + 1, index - message_start - 1);
+        memcpy(buffer + message_start, head, head_length);
+        index += head_length - 1;
+    }
+#endif
 
-        if (http_body_final_state == STATE_OVERFLOW_BODY) {
-            append_msg_body_overflow(headers);
-            return true;
+#if BREST_METRICS
+    /**
+     * @brief append_metrics serve metrics in Prometheus text format, or in JSON with parameter format=json.
+     * @param headers should include HTTP headers
+     */
+    void append_metrics(bool headers) {
+        const char* format = request.get(F("format"));
+        bool json = (format != NULL && 0 == strcasecmp_P(format, PSTR("json")));
+
+        if (json) {
+            if (headers)
+                append_http_header(true);
+            append_metrics_json();
+        } else {
+            if (headers)
+                addToBufferF(F("HTTP/1.1 200 OK\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n"));
+            append_metrics_prometheus();
         }
-        if (uri_final_state != STATE_ACCEPT_URI) {
-            append_msg_invalid_request(headers);
-            return true;
+    }
+
+    /**
+     * @brief append_metrics_prometheus append metrics in Prometheus text format
+     * @details Served by handle() to network client, whole lines are sent to client whenever output buffer runs out
+     *          of room, so exposition may be larger than output buffer. On other transports it ends at the last
+     *          whole line that fits, so that it stays valid.
+     */
+    void append_metrics_prometheus() {
+        uint16_t start = index;
+        reserve_prometheus_line(NULL, NULL);
+        addToBufferF(F("# TYPE brest_stage_duration_microseconds histogram\n"));
+        for (uint8_t stage = 0; stage < STAGE_COUNT; stage++)
+            append_prometheus_histogram(F("brest_stage_duration_microseconds"), F("stage"),
+                                        get_stage_name((METRICS_STAGE)stage), NULL, metrics.stages[stage]);
+
+        const __FlashStringHelper* flash_id;
+        const char* id;
+        reserve_prometheus_line(NULL, NULL);
+        addToBufferF(F("# TYPE brest_requests_total counter\n"));
+        for (unsigned int i = 0; i < get_resource_count(); i++) {
+            Observer* p_resource = get_resource(i, flash_id, id);
+            for (uint8_t method = 0; method < HTTP_METHOD_UNSET; method++) {
+                // methods resource refuses are never counted
+                if (!p_resource->allows((HTTP_METHOD)method))
+                    continue;
+                reserve_prometheus_line(flash_id, id);
+                addToBufferF(F("brest_requests_total{"));
+                append_prometheus_label(F("resource"), flash_id, id);
+                addToBufferF(F(",method=\""));
+                addToBuffer(get_method_name((HTTP_METHOD)method), false);
+                addToBufferF(F("\"} "));
+                addToBuffer(p_resource->metrics.requests[method], false);
+                addToBufferF(F("\n"));
+            }
         }
 
-        if(decodeArgs)
-            urldecode(http_url);   // Modifies http url
+        reserve_prometheus_line(NULL, NULL);
+        addToBufferF(F("# TYPE brest_update_duration_microseconds histogram\n"));
+        for (unsigned int i = 0; i < get_resource_count(); i++) {
+            Observer* p_resource = get_resource(i, flash_id, id);
+            append_prometheus_histogram(F("brest_update_duration_microseconds"), F("resource"),
+                                        flash_id, id, p_resource->metrics.update);
+        }
 
-        if(!parse_url()) {
-            append_msg_invalid_request(headers);
-            return true;
+        reserve_prometheus_line(NULL, NULL);
+        addToBufferF(F("# TYPE brest_errors_total counter\n"));
+        for (uint8_t i = 0; i < NUM_METRICS_ERROR_CODES; i++) {
+            reserve_prometheus_line(NULL, NULL);
+            addToBufferF(F("brest_errors_total{code=\""));
+            addToBuffer(CODE_ERROR_NO_VALID_DATA + i, false);
+            addToBufferF(F("\"} "));
+            addToBuffer(metrics.errors[i], false);
+            addToBufferF(F("\n"));
         }
 
-#if DEBUG
-       log("bREST::send_command() -- Method: %s", bREST::get_method(http_method).c_str());
-        for(int i = 0; i < parm_counter; i++) {
-            log(", Parm: %s = %s", parms[i].c_str(), value[i].c_str());
+        append_prometheus_counter(F("brest_url_overflows_total"), metrics.url_overflows);
+        append_prometheus_counter(F("brest_body_overflows_total"), metrics.body_overflows);
+        append_prometheus_counter(F("brest_truncated_responses_total"), metrics.truncated_responses);
+#if BREST_URL_CACHE
+        append_prometheus_counter(F("brest_url_cache_hits_total"), url_cache.hits);
+        append_prometheus_counter(F("brest_url_cache_misses_total"), url_cache.misses);
+        append_prometheus_counter(F("brest_url_cache_evictions_total"), url_cache.evictions);
+#endif
+
+#if BREST_ALLOC_TRACKING
+        append_prometheus_alloc_usage(F("brest_allocations_total"), F("counter"), &bRESTAllocUsage::allocations);
+        append_prometheus_alloc_usage(F("brest_allocated_bytes_total"), F("counter"), &bRESTAllocUsage::allocated_bytes);
+        append_prometheus_alloc_usage(F("brest_request_allocations_max"), F("gauge"), &bRESTAllocUsage::max_request_allocations);
+
+        reserve_prometheus_line(NULL, NULL);
+        addToBufferF(F("# TYPE brest_stack_high_water_bytes gauge\n"));
+        for (unsigned int i = 0; i < get_resource_count(); i++) {
+            Observer* p_resource = get_resource(i, flash_id, id);
+            reserve_prometheus_line(flash_id, id);
+            addToBufferF(F("brest_stack_high_water_bytes{"));
+            append_prometheus_label(F("resource"), flash_id, id);
+            addToBufferF(F("} "));
+            addToBuffer(p_resource->alloc_usage.stack_high_water, false);
+            addToBufferF(F("\n"));
         }
-        log("\n");
+        reserve_prometheus_line(NULL, NULL);
+        addToBufferF(F("brest_stack_high_water_bytes "));
+        addToBuffer(alloc_usage.stack_high_water, false);
+        addToBufferF(F("\n"));
 #endif
 
-        if(!notify_observers(headers)) {
-            if(headers) {
-                append_http_header(true);
-                addToBufferF(F("{\"message\":\"Request has been processed. But no observers are activated!\",\"code\":504}\r\n"));
-            } else {
-                addToBufferF(F("\"message\":\"Request has been processed. But no observers are activated!\",\"code\":504\n"));
-            }
+        if (truncated) {
+            while (index > start && buffer[index - 1] != '\n')
+                index--;
         }
+    }
 
-        return true;
+#if BREST_ALLOC_TRACKING
+    /**
+     * @brief append_prometheus_alloc_usage append one usage counter of each resource and of all requests
+     * @param name metric name
+     * @param type metric type
+     * @param field counter of bRESTAllocUsage
+     */
+    void append_prometheus_alloc_usage(const __FlashStringHelper* name, const __FlashStringHelper* type,
+                                       uint32_t bRESTAllocUsage::* field) {
+        const __FlashStringHelper* flash_id;
+        const char* id;
+        reserve_prometheus_line(NULL, NULL);
+        addToBufferF(F("# TYPE "));
+        addToBuffer(name, false);
+        addToBufferF(F(" "));
+        addToBuffer(type, false);
+        addToBufferF(F("\n"));
+        for (unsigned int i = 0; i < get_resource_count(); i++) {
+            Observer* p_resource = get_resource(i, flash_id, id);
+            reserve_prometheus_line(flash_id, id);
+            addToBuffer(name, false);
+            addToBufferF(F("{"));
+            append_prometheus_label(F("resource"), flash_id, id);
+            addToBufferF(F("} "));
+            addToBuffer(p_resource->alloc_usage.*field, false);
+            addToBufferF(F("\n"));
+        }
+        reserve_prometheus_line(NULL, NULL);
+        addToBuffer(name, false);
+        addToBufferF(F(" "));
+        addToBuffer(alloc_usage.*field, false);
+        addToBufferF(F("\n"));
+    }
 
+    void append_json_alloc_usage(const bRESTAllocUsage& usage) {
+        addToBufferF(F("{\"allocations\":"));
+        addToBuffer(usage.allocations, false);
+        addToBufferF(F(",\"allocated_bytes\":"));
+        addToBuffer(usage.allocated_bytes, false);
+        addToBufferF(F(",\"max_request_allocations\":"));
+        addToBuffer(usage.max_request_allocations, false);
+        addToBufferF(F(",\"stack_high_water\":"));
+        addToBuffer(usage.stack_high_water, false);
+        addToBufferF(F("}"));
     }
+#endif
 
     /**
-     * @brief notify_observers notifies subscribed observer to process HTTP request.
-     * @param headers should include HTTP headers
-     * @return true if trigger any observer update. Otherwise, false.
+     * @brief append_prometheus_histogram append cumulative buckets, sum and count of histogram.
+     * @details Empty buckets are skipped to fit output buffer. Bucket +Inf is always present.
+     * @param name metric name
+     * @param label label name
+     * @param flash_value label value in flash. NULL if it is in RAM.
+     * @param value label value in RAM
+     * @param histogram histogram
      */
-    bool notify_observers(bool headers) {
-        bool is_observer_fired = false;
+    void append_prometheus_histogram(const __FlashStringHelper* name, const __FlashStringHelper* label,
+                                     const __FlashStringHelper* flash_value, const char* value,
+                                     const bRESTHistogram& histogram) {
+        uint32_t cumulative = 0;
+        for (uint8_t i = 0; i < MAX_METRICS_BUCKETS; i++) {
+            cumulative += histogram.buckets[i];
+            bool is_last = (i == MAX_METRICS_BUCKETS - 1);
+            if (0 == histogram.buckets[i] && !is_last)
+                continue;
+
+            reserve_prometheus_line(flash_value, value);
+            addToBuffer(name, false);
+            addToBufferF(F("_bucket{"));
+            append_prometheus_label(label, flash_value, value);
+            addToBufferF(F(",le=\""));
+            if (is_last)
+                addToBufferF(F("+Inf"));
+            else
+                addToBuffer(bRESTHistogram::upper_bound(i), false);
+            addToBufferF(F("\"} "));
+            addToBuffer(cumulative, false);
+            addToBufferF(F("\n"));
+        }
 
-        for (int i = 0 ; i < observer_counter; i++) {
+        reserve_prometheus_line(flash_value, value);
+        addToBuffer(name, false);
+        addToBufferF(F("_sum{"));
+        append_prometheus_label(label, flash_value, value);
+        addToBufferF(F("} "));
+        addToBuffer(histogram.sum, false);
+        addToBufferF(F("\n"));
+
+        reserve_prometheus_line(flash_value, value);
+        addToBuffer(name, false);
+        addToBufferF(F("_count{"));
+        append_prometheus_label(label, flash_value, value);
+        addToBufferF(F("} "));
+        addToBuffer(histogram.count, false);
+        addToBufferF(F("\n"));
+    }
 
-            Observer* p_resource = observer_list[i];
+    /**
+     * @brief reserve_prometheus_line make room for the next line of exposition. If it may not fit, lines in output
+     *        buffer are sent to network client of handle() and output buffer starts over.
+     * @param flash_value resource ID of line in flash. NULL if it is in RAM.
+     * @param value resource ID of line in RAM. NULL if line has none.
+     */
+    void reserve_prometheus_line(const __FlashStringHelper* flash_value, const char* value) {
+        if (NULL == output_client || truncated || 0 == index)
+            return;
+
+        // quotes and backslashes of resource ID are escaped
+        size_t id_length = 0;
+        if (flash_value != NULL)
+            id_length = strlen_P(reinterpret_cast<PGM_P>(flash_value));
+        else if (value != NULL)
+            id_length = strlen(value);
+        if ((size_t)(buffer_size - index) >= METRICS_LINE_RESERVE + 2 * id_length)
+            return;
+
+        write_output_client(output_client, (const uint8_t*)buffer, index);
+        index = 0;
+    }
 
-            if(p_resource->get_id().equalsIgnoreCase(resource_id)) {
-                is_observer_fired = true;
+    template <typename T>
+    static size_t write_output_to(void* client, const uint8_t* bytes, size_t size) {
+        return static_cast<T*>(client)->write(bytes, size);
+    }
 
-                if(headers)
-                    append_http_header(true);
+    void append_prometheus_label(const __FlashStringHelper* label, const __FlashStringHelper* flash_value,
+                                 const char* value) {
+        addToBuffer(label, false);
+        addToBufferF(F("="));
+        if (flash_value != NULL)
+            addToBuffer(flash_value, true);
+        else
+            addToBuffer(value, true);
+    }
+
+    void append_prometheus_counter(const __FlashStringHelper* name, uint32_t counter) {
+        reserve_prometheus_line(NULL, NULL);
+        addToBufferF(F("# TYPE "));
+        addToBuffer(name, false);
+        addToBufferF(F(" counter\n"));
+        reserve_prometheus_line(NULL, NULL);
+        addToBuffer(name, false);
+        addToBufferF(F(" "));
+        addToBuffer(counter, false);
+        addToBufferF(F("\n"));
+    }
+
+    void append_metrics_json() {
+        start_json_msg();
 
-                // fire resource call back
-                p_resource->update(http_method, parms, value, parm_counter, this);
+        append_key_to_json(F("stages"));
+        addToBufferF(F("{"));
+        for (uint8_t stage = 0; stage < STAGE_COUNT; stage++) {
+            if (stage > 0)
+                append_comma_to_json();
+            append_key_to_json(get_stage_name((METRICS_STAGE)stage));
+            append_json_histogram(metrics.stages[stage]);
+        }
+        addToBufferF(F("},"));
+
+        append_key_to_json(F("resources"));
+        addToBufferF(F("["));
+        const __FlashStringHelper* flash_id;
+        const char* id;
+        for (unsigned int i = 0; i < get_resource_count(); i++) {
+            Observer* p_resource = get_resource(i, flash_id, id);
+            if (i > 0)
+                append_comma_to_json();
+            addToBufferF(F("{\"id\":"));
+            if (flash_id != NULL)
+                addToBuffer(flash_id, true);
+            else
+                addToBuffer(id, true);
+            addToBufferF(F(",\"requests\":{"));
+            for (uint8_t method = 0; method < HTTP_METHOD_UNSET; method++) {
+                if (method > 0)
+                    append_comma_to_json();
+                append_key_to_json(get_method_name((HTTP_METHOD)method));
+                addToBuffer(p_resource->metrics.requests[method], false);
             }
+            addToBufferF(F("},\"update\":"));
+            append_json_histogram(p_resource->metrics.update);
+#if BREST_ALLOC_TRACKING
+            addToBufferF(F(",\"usage\":"));
+            append_json_alloc_usage(p_resource->alloc_usage);
+#endif
+            addToBufferF(F("}"));
         }
+        addToBufferF(F("],"));
 
-        return is_observer_fired;
-    }
+        append_key_to_json(F("errors"));
+        addToBufferF(F("{"));
+        for (uint8_t i = 0; i < NUM_METRICS_ERROR_CODES; i++) {
+            if (i > 0)
+                append_comma_to_json();
+            addToBufferF(F("\""));
+            addToBuffer(CODE_ERROR_NO_VALID_DATA + i, false);
+            addToBufferF(F("\":"));
+            addToBuffer(metrics.errors[i], false);
+        }
+        addToBufferF(F("},"));
+
+        append_key_to_json(F("url_overflows"));
+        addToBuffer(metrics.url_overflows, false);
+        append_comma_to_json();
+        append_key_to_json(F("body_overflows"));
+        addToBuffer(metrics.body_overflows, false);
+        append_comma_to_json();
+        append_key_to_json(F("truncated_responses"));
+        addToBuffer(metrics.truncated_responses, false);
+#if BREST_URL_CACHE
+        append_comma_to_json();
+        append_key_to_json(F("url_cache"));
+        addToBufferF(F("{\"hits\":"));
+        addToBuffer(url_cache.hits, false);
+        addToBufferF(F(",\"misses\":"));
+        addToBuffer(url_cache.misses, false);
+        addToBufferF(F(",\"evictions\":"));
+        addToBuffer(url_cache.evictions, false);
+        addToBufferF(F("}"));
+#endif
+#if BREST_ALLOC_TRACKING
+        append_comma_to_json();
+        append_key_to_json(F("usage"));
+        append_json_alloc_usage(alloc_usage);
+#endif
 
-    void append_http_header(bool isOK) {
-        if(isOK)
-            addToBufferF(F("HTTP/1.1 200 OK\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n"));
-        else
-            addToBufferF(F("HTTP/1.1 500\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n"));
+        end_json_msg();
     }
 
-    void append_msg_url_overflow(bool headers) {
-        if (headers) {
-            append_http_header(false);
-            addToBufferF(F("{\"message\":\"URL parsing overflow!\",\"code\":502}\r\n"));
-        } else {
-            addToBufferF(F("\"message\":\"URL parsing overflow!\",\"code\":502\n"));
+    void append_json_histogram(const bRESTHistogram& histogram) {
+        addToBufferF(F("{\"count\":"));
+        addToBuffer(histogram.count, false);
+        addToBufferF(F(",\"sum\":"));
+        addToBuffer(histogram.sum, false);
+        addToBufferF(F(",\"buckets\":["));
+        for (uint8_t i = 0; i < MAX_METRICS_BUCKETS; i++) {
+            if (i > 0)
+                append_comma_to_json();
+            addToBuffer(histogram.buckets[i], false);
         }
+        addToBufferF(F("]}"));
     }
 
-    void append_msg_body_overflow(bool headers) {
-        if (headers) {
-            append_http_header(false);
-            addToBufferF(F("{\"message\":\"HTTP body parsing overflow!\",\"code\":502}\r\n"));
-        } else {
-            addToBufferF(F("\"message\":\"HTTP body parsing overflow!\",\"code\":502\n"));
+    /**
+     * @brief get_resource_count get the number of routed resources and observers
+     * @return number of resources
+     */
+    unsigned int get_resource_count() {
+        return route_table.route_count + observer_counter;
+    }
+
+    /**
+     * @brief get_resource get routed resource or observer by index. Routed resources come first.
+     * @param i resource index
+     * @param flash_id resource ID in flash. NULL if it is in RAM.
+     * @param id resource ID in RAM. NULL if it is in flash.
+     * @return resource
+     */
+    Observer* get_resource(unsigned int i, const __FlashStringHelper*& flash_id, const char*& id) {
+        if (i < route_table.route_count) {
+            flash_id = route_table.get_id(i);
+            id = NULL;
+            return route_table.get_observer(i);
         }
+
+        Observer* p_resource = observer_list[i - route_table.route_count];
+        flash_id = p_resource->flash_id;
+        id = (NULL == flash_id)? p_resource->id.c_str(): NULL;
+        return p_resource;
     }
 
-    void append_msg_invalid_request(bool headers) {
-        if (headers) {
-            append_http_header(false);
-            addToBufferF(F("{\"message\":\"Invalid URL request!\",\"code\":503}\r\n"));
-        } else {
-            addToBufferF(F("\"message\":\"Invalid URL request!\",\"code\":503\n"));
+    /**
+     * @brief get_method_name get name of http method without String allocation
+     * @param method
+     * @return name in flash
+     */
+    static const __FlashStringHelper* get_method_name(HTTP_METHOD method) {
+        switch(method) {
+        case HTTP_METHOD_GET:
+            return F("GET");
+        case HTTP_METHOD_PUT:
+            return F("PUT");
+        case HTTP_METHOD_POST:
+            return F("POST");
+        case HTTP_METHOD_DELETE:
+            return F("DELETE");
+        default:
+            return F("UNSET");
         }
     }
+#endif
 
-    void append_key_to_json(const String& key) {
-        addToBufferF(F("\""));
-        addToBuffer(key, false);
-        addToBufferF(F("\":"));
+#if BREST_TRACE
+    /**
+     * @brief append_trace serve trace records as JSON. Records are cleared with parameter clear=1.
+     * @param headers should include HTTP headers
+     */
+    void append_trace(bool headers) {
+        bRESTTrace& trace = bRESTTrace::instance();
+        char hex[2 * TRACE_RECORD_SIZE + 1];
+
+        if (headers)
+            append_http_header(true);
+        start_json_msg();
+        append_key_to_json(F("count"));
+        addToBuffer(trace.get_count(), false);
+        append_comma_to_json();
+        append_key_to_json(F("dropped"));
+        addToBuffer(trace.get_dropped(), false);
+        append_comma_to_json();
+        append_key_to_json(F("trace"));
+        addQuote();
+        for (uint16_t i = 0; i < trace.get_count(); i++)
+            addToBuffer(trace.encode(i, hex), false);
+        addQuote();
+        end_json_msg();
+
+        if (request.get_bool(F("clear"), false))
+            trace.clear();
+    }
+#endif
+
+#if BREST_CAPTURE
+    /**
+     * @brief append_capture serve captured requests as JSON. They are cleared with parameter clear=1.
+     * @param headers should include HTTP headers
+     */
+    void append_capture(bool headers) {
+        static const char HEX_DIGITS[] = "0123456789abcdef";
+        bRESTCapture& capture = bRESTCapture::instance();
+
+        if (headers)
+            append_http_header(true);
+        start_json_msg();
+        append_key_to_json(F("count"));
+        addToBuffer(capture.get_count(), false);
+        append_comma_to_json();
+        append_key_to_json(F("dropped"));
+        addToBuffer(capture.get_dropped(), false);
+        append_comma_to_json();
+        append_key_to_json(F("capture"));
+        addQuote();
+        char hex[3] = {0, 0, 0};
+        for (uint16_t i = 0; i < capture.get_length(); i++) {
+            hex[0] = HEX_DIGITS[capture.get_byte(i) >> 4];
+            hex[1] = HEX_DIGITS[capture.get_byte(i) & 0x0F];
+            addToBuffer(hex, false);
+        }
+        addQuote();
+        end_json_msg();
+
+        if (request.get_bool(F("clear"), false))
+            capture.clear();
     }
+#endif
 
     /**
      * @brief parse_url parse resource, parameter and value.
@@ -629,92 +3130,370 @@ protected:
     bool parse_url() {
 
 #if DEBUG
-        log("bREST::Parse URL: %s\n", http_url.c_str());
+        log("bREST::Parse URL: %s\n", http_url);
 #endif
 
+        char* url = http_url;
+
         // preprocess http://host:port
-        if (http_url.startsWith("http://")) {
-            // remove "http://"
-            http_url.remove(0, 7);
-            int index_of_slash = http_url.indexOf('/');
-            if (-1 == index_of_slash)
+        if (0 == strncmp(url, "http://", 7)) {
+            url = strchr(url + 7, '/');
+            if (NULL == url)
                 return false;
-            http_url.remove(0, index_of_slash);
         }
 
         // process abs_path
 
-        // remove '/' preceding to abs_path
-        http_url.remove(0, 1);
+        // skip '/' preceding to abs_path
+        if (*url != '\0')
+            url++;
 
-        int index_of_slash = http_url.indexOf('/');
+        request.resource_id = url;
+        char* slash = strchr(url, '/');
         // no parms are provided
-        if (-1 == index_of_slash) {
-            resource_id = http_url;
-            parm_counter = 0;
+        if (NULL == slash) {
+            request.parm_count = 0;
             return true;
         }
 
-        resource_id = http_url.substring(0, index_of_slash);
-
-        // remove the resource from url
-        http_url.remove(0, index_of_slash);
+        // terminate resource ID in place
+        *slash = '\0';
 
         // parm list must start with '/?'
-        if(!http_url.startsWith("/?"))
+        if (slash[1] != '?')
             return false;
 
-        // remove '/?'
-        http_url.remove(0, 2);
+        return parse_parms(slash + 2);
+    }
 
-        // process parameters and value
-        int index_of_amp;
-        do{
-            index_of_amp = http_url.indexOf('&');
-            String statement = (index_of_amp == -1)? http_url: http_url.substring(0, index_of_amp);
-            int index_of_assign = statement.indexOf('=');
-            if (-1 == index_of_assign)
-                return false;
-            parms[parm_counter] = statement.substring(0, index_of_assign);
-            if (statement.length() + 1 == parms[parm_counter].length())
+    /**
+     * @brief parse_parms split "key=value&key=value" in place into parms and value
+     * @param statement NUL terminated parameter list
+     * @return true if every parameter has value. Otherwise, false.
+     */
+    bool parse_parms(char* statement) {
+        do {
+            char* amp = strchr(statement, '&');
+            if (amp != NULL)
+                *amp = '\0';
+            char* assign = strchr(statement, '=');
+            if (NULL == assign)
                 return false;
-            value[parm_counter] = statement.substring(index_of_assign + 1);
-
-            // remove statment and &
-            if (index_of_amp != -1)
-                http_url.remove(0, index_of_amp + 1);
+            *assign = '\0';
+            request.parms[request.parm_count] = statement;
+            request.value[request.parm_count] = assign + 1;
 
-            parm_counter += 1;
-        } while(index_of_amp != -1 && parm_counter < MAX_NUM_PARMS);
+            statement = (amp != NULL)? amp + 1: NULL;
+            request.parm_count += 1;
+        } while(statement != NULL && request.parm_count < max_num_parms);
 
         return true;
     }
 
-    void reset_status() override {
-        aREST::reset_status();
+    virtual void reset_status() {
+        // writer renders JSON out of requests
+        last_response_format = response_format;
+        response_format = RESPONSE_FORMAT_JSON;
+        reset_request_arena();
         reset_uri_state_vars();
         reset_body_state_vars();
     }
 
+    /**
+     * @brief reset_request_arena release all request allocations in O(1) and carve URL buffer for next request.
+     */
+    void reset_request_arena() {
+        arena.reset();
+        http_url = arena.allocate_string(max_url_length);
+        request.resource_id = http_url;
+    }
+
+    template <typename T>
+    void handle_serial(T& serial) {
+        if (serial.available()) {
+            begin_request();
+            handle_proto(serial, false, 1, false);
+            sendBuffer(serial, 25, 1);
+            end_request();
+            reset_status();
+        }
+    }
+
+    template <typename T>
+    void handle_proto(T& serial, bool headers, uint8_t read_delay, bool decode) {
+#if DEBUG
+        log("bREST::handle_proto -- scanning proto string with delay(%d)...\n", read_delay);
+#endif
+#if BREST_CAPTURE
+        bRESTCapture::instance().begin_request((headers? CAPTURE_HEADERS: 0) | (decode? CAPTURE_DECODE: 0));
+#endif
+        stage_start = metrics_clock();
+        int available;
+        while ((available = serial.available()) > 0) {
+            char c = serial.read();
+#if BREST_CAPTURE
+            bRESTCapture::instance().receive(available, c);
+#endif
+            if (0 != read_delay)
+                delay(read_delay);
+            process(c);
+        }
+
+        send_command(headers, decode);
+#if BREST_CAPTURE
+        bRESTCapture::instance().end_request(buffer, index);
+#endif
+    }
+
+    /**
+     * @brief sendBuffer write output buffer to client and reset it.
+     * @param client client
+     * @param chunkSize write chunk by chunk if it is not zero
+     * @param wait_time delay in milliseconds between chunks
+     */
+    template <typename T>
+    void sendBuffer(T& client, uint8_t chunkSize, uint8_t wait_time) {
+        uint32_t start = metrics_clock();
+        if (chunkSize == 0) {
+            client.write((const uint8_t*)buffer, index);
+        } else {
+            for (uint16_t sent = 0; sent < index; sent += chunkSize) {
+                uint16_t length = (index - sent < chunkSize)? index - sent: chunkSize;
+                client.write((const uint8_t*)buffer + sent, length);
+                // Wait for client to get data
+                delay(wait_time);
+            }
+        }
+        record_stage(STAGE_SEND, start);
+        record_truncation();
+        BREST_TRACE_EVENT(TRACE_SEND_BUFFER, index, chunkSize);
+
+        resetBuffer();
+    }
+
+    void addQuote() {
+        if (index < buffer_size) {
+            buffer[index] = '\"';
+            index++;
+        } else {
+            truncated = true;
+        }
+    }
+
+    /**
+     * @brief urldecode decode percent-encoded and '+' characters in place.
+     * @param arguments NUL terminated string to decode
+     */
+    void urldecode(char* arguments) {
+        char* out = arguments;
+        for (const char* in = arguments; *in != '\0'; in++, out++) {
+            char a, b;
+            // %20 ==> in[0] = '%', a = '2', b = '0'
+            if (in[0] == '%' && isxdigit(a = in[1]) && isxdigit(b = in[2])) {
+                if (a >= 'a') a -= 'a'-'A';
+                if (a >= 'A') a -= ('A' - 10);
+                else          a -= '0';
+
+                if (b >= 'a') b -= 'a'-'A';
+                if (b >= 'A') b -= ('A' - 10);
+                else          b -= '0';
+
+                *out = char(16 * a + b);
+                in += 2;   // Skip ahead
+            } else if (*in == '+') {
+                *out = ' ';
+            } else {
+                *out = *in;
+            }
+        }
+
+        *out = '\0';    // Terminate string at new possibly reduced length
+    }
+
     /**
      * @brief reset_state_vars reset state variable for every line of HTTP conversation.
      */
     void reset_uri_state_vars() {
         parser_state = STATE_START;
         uri_final_state = STATE_START;
-        http_method = HTTP_METHOD_UNSET;
-        http_url = String("");
+        request.method = HTTP_METHOD_UNSET;
+        http_url[0] = '\0';
         url_length_counter = 0;
-        parm_counter = 0;
+        request.parm_count = 0;
+#if BREST_STREAMS
+        stream_observer = NULL;
+#endif
+#if BREST_URL_CACHE
+        url_hash = bRESTUrlCache::HASH_BASIS;
+        is_observer_resolved = false;
+#endif
     }
 
     void reset_body_state_vars() {
-        body_length_counter = 0;
+        request.body = http_body;
+        request.body_length = 0;
+        request.format = RESPONSE_FORMAT_JSON;
         process_char_counter = 0;
+#if BREST_WEBSOCKET
+        websocket_key_length = 0;
+        websocket_key_match = WEBSOCKET_KEY_NO_MATCH;
+        websocket_upgrade = false;
+#endif
+#if BREST_BINARY_FORMATS
+        accept_scanner.reset();
+#endif
         http_body_final_state = STATE_START;
-        memset((void*)http_body, 0, MAX_HTTP_BODY_LENGTH);
+        memset((void*)http_body, 0, max_http_body_length);
+    }
+
+private:
+    void init_storage(const bRESTStorage& storage) {
+        last_status = CODE_OK;
+        response_format = RESPONSE_FORMAT_JSON;
+        last_response_format = RESPONSE_FORMAT_JSON;
+        buffer = storage.output_buffer;
+        buffer_size = storage.output_buffer_size;
+        index = 0;
+#if BREST_METRICS
+        output_client = NULL;
+#endif
+        truncated = false;
+        message_key_count = 0;
+        message_start = 0;
+#if BREST_BATCH
+        in_batch = false;
+#endif
+        stage_start = 0;
+#if BREST_ALLOC_TRACKING
+        request_start = bRESTAllocCounters::instance();
+        fired_observer = NULL;
+#endif
+        request.parms = storage.parms;
+        request.value = storage.value;
+        observer_list = storage.observer_list;
+        parm_strings = storage.parm_strings;
+        value_strings = storage.value_strings;
+        http_body = storage.http_body;
+        max_url_length = storage.max_url_length;
+        max_num_parms = storage.max_num_parms;
+        max_num_resources = storage.max_num_resources;
+        max_http_body_length = storage.max_http_body_length;
+        // URL is carved out of arena by max_url_length, so capacities are set first
+        arena.init(storage.arena, storage.arena_size);
+        reset_request_arena();
+        reset_uri_state_vars();
+        reset_body_state_vars();
+        observer_counter = 0;
+        route_table.route_count = 0;
+    }
+};
+
+/**
+ * @brief The bRESTInstanceStorage class owns buffers of bRESTInstance.
+ * @details It is the first base class of bRESTInstance, so that buffers are constructed before bREST.
+ */
+template<typename CAPACITIES>
+class bRESTInstanceStorage {
+protected:
+    char output_buffer_storage[CAPACITIES::output_buffer_size];
+    char arena_storage[CAPACITIES::arena_size];
+    char* parms_storage[CAPACITIES::max_num_parms];
+    char* value_storage[CAPACITIES::max_num_parms];
+    Observer* observer_list_storage[CAPACITIES::max_num_resources];
+    String parm_string_storage[CAPACITIES::max_num_parms];
+    String value_string_storage[CAPACITIES::max_num_parms];
+    unsigned char http_body_storage[CAPACITIES::max_http_body_length];
+
+    bRESTStorage storage() {
+        bRESTStorage s;
+        s.output_buffer = output_buffer_storage;
+        s.output_buffer_size = CAPACITIES::output_buffer_size;
+        s.arena = arena_storage;
+        s.arena_size = CAPACITIES::arena_size;
+        s.parms = parms_storage;
+        s.value = value_storage;
+        s.observer_list = observer_list_storage;
+        s.parm_strings = parm_string_storage;
+        s.value_strings = value_string_storage;
+        s.http_body = http_body_storage;
+        s.max_url_length = CAPACITIES::max_url_length;
+        s.max_num_parms = CAPACITIES::max_num_parms;
+        s.max_num_resources = CAPACITIES::max_num_resources;
+        s.max_http_body_length = CAPACITIES::max_http_body_length;
+        return s;
     }
 };
 
+/**
+ * @brief The bRESTDefaultStorage struct owns buffers of bREST constructed without bRESTInstance.
+ */
+struct bRESTDefaultStorage: bRESTInstanceStorage<bRESTCapacities<> > {
+    using bRESTInstanceStorage<bRESTCapacities<> >::storage;
+};
+
+inline bREST::bREST(): default_storage(new bRESTDefaultStorage) {
+    init_storage(default_storage->storage());
+}
+
+inline bREST::~bREST() {
+#if BREST_STREAMS
+    for (uint8_t i = 0; i < MAX_STREAM_SUBSCRIBERS; i++)
+        streams[i].release();
+#endif
+#if BREST_WEBSOCKET
+    for (uint8_t i = 0; i < MAX_WEBSOCKETS; i++)
+        websockets[i].release();
+#endif
+    delete default_storage;
+}
+
+/**
+ * @brief The bRESTInstance class is a bREST with buffers sized by CAPACITIES.
+ * @details Each instance in a sketch may have its own footprint, i.e.
+ *      bRESTInstance<> wifi_rest;
+ *      bRESTInstance<bRESTCapacities<64, 2, 4, 1, 128> > serial_rest;
+ */
+template<typename CAPACITIES = bRESTCapacities<> >
+class bRESTInstance: private bRESTInstanceStorage<CAPACITIES>, public bREST {
+
+    static_assert(CAPACITIES::max_url_length > 0, "max_url_length must be positive");
+    static_assert(CAPACITIES::max_num_parms > 0, "max_num_parms must be positive");
+    static_assert(CAPACITIES::max_num_resources > 0, "max_num_resources must be positive");
+    static_assert(CAPACITIES::max_http_body_length > 0, "max_http_body_length must be positive");
+    static_assert(CAPACITIES::arena_size > CAPACITIES::max_url_length && CAPACITIES::arena_size <= 0xFFFFUL,
+                  "arena_size must hold URL and be at most 65535");
+    static_assert(CAPACITIES::output_buffer_size > 0 && CAPACITIES::output_buffer_size <= 0xFFFFUL,
+                  "output_buffer_size must be within 1 to 65535");
+#ifdef BREST_RAM_BUDGET
+    static_assert(CAPACITIES::ram_budget <= BREST_RAM_BUDGET,
+                  "bREST buffers exceed BREST_RAM_BUDGET. Shrink bRESTCapacities");
+#endif
+
+public:
+    typedef CAPACITIES Capacities;
+
+    bRESTInstance(): bREST(bRESTInstanceStorage<CAPACITIES>::storage()) {}
+};
+
+inline void Observer::on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) {
+    // assignment reuses heap buffer of String once it is large enough, so steady state allocates nothing
+    for (int i = 0; i < parm_count; i++) {
+        rest->parm_strings[i] = parms[i];
+        rest->value_strings[i] = value[i];
+    }
+
+    update(method, rest->parm_strings, rest->value_strings, parm_count, rest);
+}
+
+inline void Observer::update(HTTP_METHOD method, String parms[], String value[], int parm_count, bREST* rest) {
+    // neither on_request() nor update() is overridden
+    rest->record_error(CODE_ERROR_INVALID_COMMAND);
+    rest->start_json_msg();
+    rest->append_key_value_pair_to_json(F("message"), F("Invalid command!"));
+    rest->append_comma_to_json();
+    rest->append_key_value_pair_to_json(F("code"), CODE_ERROR_INVALID_COMMAND);
+    rest->end_json_msg();
+}
+
 #endif // BREST_H
 
@@ -0,0 +1,177 @@
+/*
+  Heap allocation and stack high water tracking for bREST.
+
+  Allocations are counted by malloc hooks. Define BREST_ALLOC_HOOKS 1 before including bREST.h in exactly one
+  translation unit of the program:
+    - On Linux host, hooks replace malloc, calloc and realloc and forward them to glibc.
+    - On boards, hooks wrap them. Link with -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc.
+
+  Stack high water is measured by painting the free stack below handle() with a pattern when request starts, and
+  counting the painted bytes overwritten when request ends. It saturates at BREST_STACK_PAINT_SIZE.
+*/
+#ifndef bREST_ALLOC_TRACKING_H
+#define bREST_ALLOC_TRACKING_H
+
+#include "bRESTConfig.h"
+
+// Enable it to track heap allocations and stack high water per request and per resource. Default is disable.
+#ifndef BREST_ALLOC_TRACKING
+#define BREST_ALLOC_TRACKING    0
+#endif
+
+// Enable it in one translation unit to count allocations by malloc hooks. Default is disable.
+#ifndef BREST_ALLOC_HOOKS
+#define BREST_ALLOC_HOOKS       0
+#endif
+
+// Set number of stack bytes painted below handle(). Default is 512.
+#ifndef BREST_STACK_PAINT_SIZE
+#define BREST_STACK_PAINT_SIZE  512
+#endif
+
+#define STACK_PAINT_PATTERN     0xC5
+
+/**
+ * @brief The bRESTAllocCounters struct counts heap allocations of the whole program.
+ * @details It has no constructor, so that it is zero before any static constructor calls malloc.
+ */
+struct bRESTAllocCounters {
+    uint32_t allocations;
+    uint32_t allocated_bytes;
+
+    static bRESTAllocCounters& instance() {
+        static bRESTAllocCounters counters;
+        return counters;
+    }
+
+    static void count(size_t size) {
+        bRESTAllocCounters& counters = instance();
+        counters.allocations++;
+        counters.allocated_bytes += size;
+    }
+};
+
+/**
+ * @brief The bRESTAllocUsage struct is heap and stack usage of one request, one resource or all requests.
+ */
+struct bRESTAllocUsage {
+    uint32_t allocations;
+    uint32_t allocated_bytes;
+    // the largest number of allocations in one request
+    uint32_t max_request_allocations;
+    // the largest stack usage of one request in bytes
+    uint16_t stack_high_water;
+
+    bRESTAllocUsage() {
+        reset();
+    }
+
+    void reset() {
+        allocations = 0;
+        allocated_bytes = 0;
+        max_request_allocations = 0;
+        stack_high_water = 0;
+    }
+
+    /**
+     * @brief add accumulate usage of one request
+     * @param request usage of one request
+     */
+    void add(const bRESTAllocUsage& request) {
+        allocations += request.allocations;
+        allocated_bytes += request.allocated_bytes;
+        if (request.allocations > max_request_allocations)
+            max_request_allocations = request.allocations;
+        if (request.stack_high_water > stack_high_water)
+            stack_high_water = request.stack_high_water;
+    }
+};
+
+/**
+ * @brief The bRESTStackPainter class measures stack high water by painting free stack. Stack must grow downwards.
+ */
+class bRESTStackPainter {
+protected:
+    // the lowest painted address
+    volatile uint8_t* bottom;
+
+public:
+    bRESTStackPainter() {
+        bottom = NULL;
+    }
+
+    /**
+     * @brief paint fill BREST_STACK_PAINT_SIZE bytes below caller's frame with pattern
+     */
+    __attribute__((noinline)) void paint() {
+        volatile uint8_t area[BREST_STACK_PAINT_SIZE];
+        for (uint16_t i = 0; i < BREST_STACK_PAINT_SIZE; i++)
+            area[i] = STACK_PAINT_PATTERN;
+        // area stays below stack pointer after return. It is only read back by high_water().
+        volatile uint8_t* painted = area;
+        __asm__ __volatile__("" : "+r"(painted));
+        bottom = painted;
+    }
+
+    /**
+     * @brief high_water count painted bytes overwritten since paint(). Caller must be in the same frame as paint().
+     * @return stack usage in bytes
+     */
+    __attribute__((noinline)) uint16_t high_water() {
+        if (NULL == bottom)
+            return 0;
+
+        uint16_t untouched = 0;
+        while (untouched < BREST_STACK_PAINT_SIZE && STACK_PAINT_PATTERN == bottom[untouched])
+            untouched++;
+        return BREST_STACK_PAINT_SIZE - untouched;
+    }
+};
+
+#if BREST_ALLOC_HOOKS
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+
+void* malloc(size_t size) __THROW {
+    bRESTAllocCounters::count(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) __THROW {
+    bRESTAllocCounters::count(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) __THROW {
+    bRESTAllocCounters::count(size);
+    return __libc_realloc(p, size);
+}
+}
+#else
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* p, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    bRESTAllocCounters::count(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    bRESTAllocCounters::count(count * size);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* p, size_t size) {
+    bRESTAllocCounters::count(size);
+    return __real_realloc(p, size);
+}
+}
+#endif
+#endif
+
+#endif // bREST_ALLOC_TRACKING_H
@@ -0,0 +1,122 @@
+/*
+  Per-request bump arena for bREST.
+
+  All transient strings of a request (URL, resource ID, parameters, values and handler scratch strings) are carved
+  out of one fixed buffer owned by the request context. Nothing is freed one by one: the whole arena is reset in
+  O(1) when the request ends, so the steady-state request path never calls malloc.
+*/
+#ifndef bREST_ARENA_H
+#define bREST_ARENA_H
+
+#include "Arduino.h"
+
+/**
+ * @brief The bRESTArena class is a fixed-size bump allocator.
+ */
+class bRESTArena {
+protected:
+    char* base;
+    uint16_t capacity;
+    uint16_t used;
+    uint16_t high_water_mark;
+    uint16_t failed_allocations;
+
+public:
+    bRESTArena() {
+        init(NULL, 0);
+    }
+
+    /**
+     * @brief init hand storage to arena
+     * @param storage arena buffer
+     * @param size size of arena buffer
+     */
+    void init(char* storage, uint16_t size) {
+        base = storage;
+        capacity = size;
+        used = 0;
+        high_water_mark = 0;
+        failed_allocations = 0;
+    }
+
+    /**
+     * @brief allocate carve size bytes out of arena. Memory is aligned for pointers.
+     * @param size number of bytes
+     * @return memory if arena has room. Otherwise, NULL.
+     */
+    void* allocate(uint16_t size) {
+        uint16_t padding = (uint16_t)(-(uintptr_t)(base + used) & (sizeof(void*) - 1));
+        return allocate_at(used + padding, size);
+    }
+
+    /**
+     * @brief allocate_string carve a string of length characters and its NUL terminator out of arena.
+     * @param length number of characters
+     * @return string if arena has room. Otherwise, NULL.
+     */
+    char* allocate_string(uint16_t length) {
+        char* s = (char*)allocate_at(used, length + 1);
+        if (s != NULL)
+            s[0] = '\0';
+        return s;
+    }
+
+    /**
+     * @brief duplicate copy string into arena.
+     * @param s string
+     * @return copy if arena has room. Otherwise, NULL.
+     */
+    char* duplicate(const char* s) {
+        uint16_t length = strlen(s);
+        char* copy = allocate_string(length);
+        if (copy != NULL)
+            memcpy(copy, s, length + 1);
+        return copy;
+    }
+
+    /**
+     * @brief reset release all allocations of the request in O(1).
+     */
+    void reset() {
+        used = 0;
+    }
+
+    uint16_t get_capacity() {
+        return capacity;
+    }
+
+    uint16_t get_used() {
+        return used;
+    }
+
+    /**
+     * @brief get_high_water_mark get the largest number of bytes ever used by one request
+     * @return high water mark in bytes
+     */
+    uint16_t get_high_water_mark() {
+        return high_water_mark;
+    }
+
+    /**
+     * @brief get_failed_allocations get the number of allocations refused for lack of room
+     * @return number of failed allocations
+     */
+    uint16_t get_failed_allocations() {
+        return failed_allocations;
+    }
+
+protected:
+    void* allocate_at(uint16_t offset, uint16_t size) {
+        if (offset > capacity || size > capacity - offset) {
+            failed_allocations++;
+            return NULL;
+        }
+
+        used = offset + size;
+        if (used > high_water_mark)
+            high_water_mark = used;
+        return base + offset;
+    }
+};
+
+#endif // bREST_ARENA_H
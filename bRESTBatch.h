@@ -0,0 +1,102 @@
+/*
+  Batch endpoint of bREST.
+
+  GET or PUT /_batch runs many resource operations in one request. Operations are compact requests, the same as
+  WebSocket messages, separated by ';' or line breaks. They come from query parameter ops, then from HTTP body:
+      PUT /_batch/?ops=PUT+relay1+open=true;PUT+relay2+open=false
+
+      PUT /_batch/?atomic=1 HTTP/1.1
+      ...
+      PUT relay1 open=true
+      PUT relay2 open=false
+  Each operation is dispatched to its resource in order, and the response is one JSON array of their results. With
+  atomic=1, all operations are checked first and none is run if any is invalid. Either way, all of them are run before
+  any byte of response is sent, so relays switch together.
+*/
+#ifndef bREST_BATCH_H
+#define bREST_BATCH_H
+
+#include "bRESTConfig.h"
+
+// Enable it to serve /_batch. Default is disable.
+#ifndef BREST_BATCH
+#define BREST_BATCH             0
+#endif
+
+// Set maximum length of request URI of one operation. Its buffer is on stack while batch runs. Default is 64.
+#ifndef MAX_BATCH_OPERATION_LENGTH
+#define MAX_BATCH_OPERATION_LENGTH  64
+#endif
+
+// Reserved resource ID of batch endpoint
+#define BATCH_RESOURCE_ID       "_batch"
+
+#if BREST_BATCH
+
+/**
+ * @brief The bRESTBatchOperations class walks operations of query and of body in place, without copying them.
+ */
+class bRESTBatchOperations {
+protected:
+    const char* lists[2];
+    uint16_t lengths[2];
+    uint8_t list;
+    uint16_t position;
+
+public:
+    /**
+     * @brief bRESTBatchOperations constructor
+     * @param query operations of query parameter, or NULL
+     * @param body operations of HTTP body
+     * @param body_length length of body
+     */
+    bRESTBatchOperations(const char* query, const char* body, uint16_t body_length) {
+        lists[0] = query;
+        lengths[0] = (query != NULL)? strlen(query): 0;
+        lists[1] = body;
+        lengths[1] = body_length;
+        rewind();
+    }
+
+    void rewind() {
+        list = 0;
+        position = 0;
+    }
+
+    /**
+     * @brief next find the next operation
+     * @param operation start of operation. It is not NUL terminated.
+     * @param length length of operation
+     * @return true if found. Otherwise, false.
+     */
+    bool next(const char*& operation, uint16_t& length) {
+        while (list < 2) {
+            const char* ops = lists[list];
+            while (position < lengths[list] && is_separator(ops[position]))
+                position++;
+            if (position == lengths[list]) {
+                list++;
+                position = 0;
+                continue;
+            }
+
+            uint16_t start = position;
+            while (position < lengths[list] && !is_separator(ops[position]))
+                position++;
+            operation = ops + start;
+            length = position - start;
+            return true;
+        }
+        return false;
+    }
+
+protected:
+    // body is padded with NUL
+    static bool is_separator(char c) {
+        return c == ';' || c == '\r' || c == '\n' || c == '\0';
+    }
+};
+
+#endif // BREST_BATCH
+
+#endif // bREST_BATCH_H
@@ -0,0 +1,259 @@
+/*
+  Request capture for deterministic replay.
+
+  Capture mode records raw inbound bytes of every request into a RAM ring buffer, together with chunk boundaries as
+  the transport delivered them, the arrival time of each chunk, and length, CRC-32 and duration of the response.
+  Download the buffer with bRESTCapture::instance().dump(Serial) or GET /_capture, and replay it on host with
+  extras/host/bRESTReplay.h.
+
+  Captured byte stream is a sequence of entries. Integers are little endian:
+      'Q' length(2) flags(1) start(4)       request. length covers the request and its chunk and response entries.
+                                            flags: CAPTURE_HEADERS, CAPTURE_DECODE. start: micros() of first byte
+      'C' offset(4) length(2) bytes         chunk. offset: micros() since start of request
+      'S' duration(4) length(2) crc32(4)    response. duration: micros() from start of request to end of dispatch
+  The oldest requests are evicted when buffer is full. The capture buffer is shared by all bREST instances and is not
+  thread safe.
+*/
+#ifndef bREST_CAPTURE_H
+#define bREST_CAPTURE_H
+
+#include "bRESTConfig.h"
+
+// Enable it to capture requests into ring buffer. Default is disable.
+#ifndef BREST_CAPTURE
+#define BREST_CAPTURE           0
+#endif
+
+// Set size of capture ring buffer in bytes. /_capture serves it as hex, so keep it below half of output buffer.
+// Default is 512.
+#ifndef MAX_CAPTURE_BYTES
+#define MAX_CAPTURE_BYTES       512
+#endif
+
+// Reserved resource ID of capture dump endpoint
+#define CAPTURE_RESOURCE_ID     "_capture"
+
+#define CAPTURE_REQUEST_ENTRY   'Q'
+#define CAPTURE_CHUNK_ENTRY     'C'
+#define CAPTURE_RESPONSE_ENTRY  'S'
+
+// Size of request, chunk and response entries without chunk bytes
+#define CAPTURE_REQUEST_SIZE    8
+#define CAPTURE_CHUNK_SIZE      7
+#define CAPTURE_RESPONSE_SIZE   11
+
+typedef enum {
+    // response has HTTP headers
+    CAPTURE_HEADERS         = 0x01,
+    // URL is percent decoded
+    CAPTURE_DECODE          = 0x02
+} CAPTURE_FLAG;
+
+/**
+ * @brief The bRESTCapture class is a ring buffer of captured requests. The oldest request is evicted when it is full.
+ */
+class bRESTCapture {
+protected:
+    uint8_t bytes[MAX_CAPTURE_BYTES];
+    // start of the oldest request
+    uint16_t tail;
+    // next byte to write
+    uint16_t head;
+    // bytes of complete requests
+    uint16_t used;
+    // start and length of request being captured
+    uint16_t request_start;
+    uint16_t request_length;
+    uint32_t request_time;
+    // bytes left in current chunk
+    uint16_t chunk_remaining;
+    bool capturing;
+    // number of complete requests
+    uint16_t count;
+    // number of requests evicted, or too large to capture
+    uint32_t dropped;
+
+public:
+    bRESTCapture() {
+        clear();
+    }
+
+    /**
+     * @brief instance get the capture ring buffer shared by all bREST instances
+     * @return capture ring buffer
+     */
+    static bRESTCapture& instance() {
+        static bRESTCapture capture;
+        return capture;
+    }
+
+    /**
+     * @brief begin_request start capturing request
+     * @param flags CAPTURE_FLAG bits
+     */
+    void begin_request(uint8_t flags) {
+        request_time = micros();
+        request_start = head;
+        request_length = 0;
+        chunk_remaining = 0;
+        capturing = true;
+
+        // length is patched by end_request()
+        write_byte(CAPTURE_REQUEST_ENTRY);
+        write_uint(0, 2);
+        write_byte(flags);
+        write_uint(request_time, 4);
+    }
+
+    /**
+     * @brief receive capture one inbound byte
+     * @param available bytes available in transport before reading this one. It starts a new chunk after the current
+     *        one is read.
+     * @param c inbound byte
+     */
+    void receive(int available, char c) {
+        if (0 == chunk_remaining) {
+            chunk_remaining = (available > 0xFFFF)? 0xFFFF: available;
+            write_byte(CAPTURE_CHUNK_ENTRY);
+            write_uint(micros() - request_time, 4);
+            write_uint(chunk_remaining, 2);
+        }
+        write_byte(c);
+        chunk_remaining--;
+    }
+
+    /**
+     * @brief receive capture string of bytes as one chunk
+     * @param string inbound bytes
+     * @param length number of bytes
+     */
+    void receive(const char* string, uint16_t length) {
+        for (uint16_t i = 0; i < length; i++)
+            receive(length - i, string[i]);
+    }
+
+    /**
+     * @brief end_request finish capturing request with its response
+     * @param response response in output buffer
+     * @param length response length
+     */
+    void end_request(const char* response, uint16_t length) {
+        uint32_t duration = micros() - request_time;
+        write_byte(CAPTURE_RESPONSE_ENTRY);
+        write_uint(duration, 4);
+        write_uint(length, 2);
+        write_uint(crc32((const uint8_t*)response, length), 4);
+        if (!capturing)
+            return;
+
+        bytes[(request_start + 1) % MAX_CAPTURE_BYTES] = (uint8_t)request_length;
+        bytes[(request_start + 2) % MAX_CAPTURE_BYTES] = (uint8_t)(request_length >> 8);
+        used += request_length;
+        count++;
+        capturing = false;
+    }
+
+    void clear() {
+        tail = 0;
+        head = 0;
+        used = 0;
+        count = 0;
+        dropped = 0;
+        capturing = false;
+        chunk_remaining = 0;
+    }
+
+    uint16_t get_count() {
+        return count;
+    }
+
+    uint32_t get_dropped() {
+        return dropped;
+    }
+
+    /**
+     * @brief get_length get number of captured bytes of complete requests
+     * @return number of bytes
+     */
+    uint16_t get_length() {
+        return used;
+    }
+
+    /**
+     * @brief get_byte get captured byte of complete requests
+     * @param i byte index. 0 is the first byte of the oldest request.
+     * @return captured byte
+     */
+    uint8_t get_byte(uint16_t i) {
+        return bytes[(tail + i) % MAX_CAPTURE_BYTES];
+    }
+
+    /**
+     * @brief dump print complete requests as one JSON line, i.e. {"count":2,"dropped":0,"capture":"<hex entries>"}
+     * @details /_capture serves the same JSON. Requests are kept.
+     * @param out serial port or any Print
+     */
+    void dump(Print& out) {
+        static const char HEX_DIGITS[] = "0123456789abcdef";
+        out.print(F("{\"count\":"));
+        out.print(count);
+        out.print(F(",\"dropped\":"));
+        out.print(dropped);
+        out.print(F(",\"capture\":\""));
+        for (uint16_t i = 0; i < used; i++) {
+            out.write(HEX_DIGITS[get_byte(i) >> 4]);
+            out.write(HEX_DIGITS[get_byte(i) & 0x0F]);
+        }
+        out.print(F("\"}\r\n"));
+    }
+
+    /**
+     * @brief crc32 update CRC-32 (IEEE 802.3) of bytes. Bitwise, so that it needs no table in RAM or flash.
+     * @param data bytes
+     * @param length number of bytes
+     * @param crc CRC of preceding bytes. 0 to start.
+     * @return CRC
+     */
+    static uint32_t crc32(const uint8_t* data, uint16_t length, uint32_t crc = 0) {
+        crc = ~crc;
+        for (uint16_t i = 0; i < length; i++) {
+            crc ^= data[i];
+            for (uint8_t bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
+        return ~crc;
+    }
+
+protected:
+    void write_uint(uint32_t value, uint8_t size) {
+        for (uint8_t i = 0; i < size; i++)
+            write_byte((uint8_t)(value >> (8 * i)));
+    }
+
+    void write_byte(uint8_t b) {
+        if (!capturing)
+            return;
+
+        // evict the oldest requests to make room
+        while (used + request_length >= MAX_CAPTURE_BYTES && count > 0) {
+            uint16_t length = bytes[(tail + 1) % MAX_CAPTURE_BYTES] | (bytes[(tail + 2) % MAX_CAPTURE_BYTES] << 8);
+            tail = (tail + length) % MAX_CAPTURE_BYTES;
+            used -= length;
+            count--;
+            dropped++;
+        }
+        // request alone does not fit
+        if (used + request_length >= MAX_CAPTURE_BYTES) {
+            head = request_start;
+            capturing = false;
+            dropped++;
+            return;
+        }
+
+        bytes[head] = b;
+        head = (head + 1 == MAX_CAPTURE_BYTES)? 0: head + 1;
+        request_length++;
+    }
+};
+
+#endif // bREST_CAPTURE_H
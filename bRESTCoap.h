@@ -0,0 +1,455 @@
+/*
+  CoAP transport of bREST (RFC 7252).
+
+  One UDP datagram carries one request, so battery-powered clients on lossy links need no TCP connection:
+      GET  coap://plug1/switch                Uri-Path "switch"
+      PUT  coap://plug1/switch?open=true      Uri-Path "switch", Uri-Query "open=true"
+  Uri-Path and Uri-Query options are decoded in place into resource ID and parameters, and payload "key=value" is
+  appended to parameters, so the request reaches Observer::on_request() like any other. Confirmable requests are
+  answered with piggybacked acknowledgements, and non-confirmable ones with non-confirmable responses. The last
+  exchanges are remembered by message ID, so a retransmitted request is answered again without firing its resource.
+  Accept option 60 asks for a CBOR response, labelled with Content-Format 60, if binary formats are enabled.
+
+  It works with any UDP in the shape of WiFiUDP:
+      WiFiUDP udp;
+      bRESTCoap<WiFiUDP> coap(rest, udp);
+      coap.begin();
+      void loop() {
+          coap.poll();
+      }
+*/
+#ifndef bREST_COAP_H
+#define bREST_COAP_H
+
+#include "bREST.h"
+
+// Set size of receive buffer, the largest request datagram. Larger requests are answered 4.13. Default is 128.
+#ifndef MAX_COAP_MESSAGE_SIZE
+#define MAX_COAP_MESSAGE_SIZE   128
+#endif
+
+// Set number of exchanges remembered to detect duplicates. Default is 4.
+#ifndef MAX_COAP_EXCHANGES
+#define MAX_COAP_EXCHANGES      4
+#endif
+
+// Set size of response kept with each exchange to answer duplicates. Larger responses are not kept. Default is 64.
+#ifndef MAX_COAP_CACHED_RESPONSE_SIZE
+#define MAX_COAP_CACHED_RESPONSE_SIZE   64
+#endif
+
+#define COAP_DEFAULT_PORT       5683
+// EXCHANGE_LIFETIME of RFC 7252 in milliseconds
+#define COAP_EXCHANGE_LIFETIME  247000UL
+
+#define COAP_VERSION            1
+#define COAP_HEADER_SIZE        4
+#define COAP_MAX_TOKEN_LENGTH   8
+#define COAP_PAYLOAD_MARKER     0xFF
+#define COAP_CONTENT_FORMAT_JSON    50
+#define COAP_CONTENT_FORMAT_CBOR    60
+#define COAP_CODE(code_class, detail)   ((code_class) << 5 | (detail))
+
+typedef enum {
+    COAP_TYPE_CON,
+    COAP_TYPE_NON,
+    COAP_TYPE_ACK,
+    COAP_TYPE_RST
+} COAP_TYPE;
+
+typedef enum {
+    COAP_EMPTY                      = COAP_CODE(0, 0),
+    COAP_GET                        = COAP_CODE(0, 1),
+    COAP_POST                       = COAP_CODE(0, 2),
+    COAP_PUT                        = COAP_CODE(0, 3),
+    COAP_DELETE                     = COAP_CODE(0, 4),
+    COAP_DELETED                    = COAP_CODE(2, 2),
+    COAP_CHANGED                    = COAP_CODE(2, 4),
+    COAP_CONTENT                    = COAP_CODE(2, 5),
+    COAP_BAD_REQUEST                = COAP_CODE(4, 0),
+    COAP_BAD_OPTION                 = COAP_CODE(4, 2),
+    COAP_NOT_FOUND                  = COAP_CODE(4, 4),
+    COAP_METHOD_NOT_ALLOWED         = COAP_CODE(4, 5),
+    COAP_NOT_ACCEPTABLE             = COAP_CODE(4, 6),
+    COAP_REQUEST_ENTITY_TOO_LARGE   = COAP_CODE(4, 13),
+    COAP_SERVICE_UNAVAILABLE        = COAP_CODE(5, 3)
+} COAP_MESSAGE_CODE;
+
+typedef enum {
+    COAP_OPTION_URI_HOST        = 3,
+    COAP_OPTION_URI_PORT        = 7,
+    COAP_OPTION_URI_PATH        = 11,
+    COAP_OPTION_CONTENT_FORMAT  = 12,
+    COAP_OPTION_URI_QUERY       = 15,
+    COAP_OPTION_ACCEPT          = 17
+} COAP_OPTION;
+
+/**
+ * @brief The bRESTCoapExchange struct remembers one received request, and its response if it is small enough.
+ * @tparam ADDRESS address of peer, i.e. IPAddress
+ */
+template <typename ADDRESS>
+struct bRESTCoapExchange {
+    ADDRESS address;
+    uint16_t port;
+    uint16_t message_id;
+    uint32_t time;
+    bool is_used;
+    // 0 if response is not kept
+    uint16_t response_length;
+    uint8_t response[MAX_COAP_CACHED_RESPONSE_SIZE];
+
+    bRESTCoapExchange() {
+        is_used = false;
+        response_length = 0;
+    }
+};
+
+/**
+ * @brief The bRESTCoap class serves CoAP requests from one UDP socket with one bREST.
+ * @tparam UDP UDP with begin(), parsePacket(), read(), remoteIP(), remotePort(), beginPacket(), write() and
+ *         endPacket()
+ */
+template <typename UDP>
+class bRESTCoap {
+protected:
+    // declared only to name type of remoteIP()
+    static UDP& declare_udp();
+    typedef decltype(declare_udp().remoteIP()) ADDRESS;
+
+    bREST& rest;
+    UDP& udp;
+    uint8_t packet[MAX_COAP_MESSAGE_SIZE];
+    bRESTCoapExchange<ADDRESS> exchanges[MAX_COAP_EXCHANGES];
+    uint8_t next_exchange;
+    // message ID of non-confirmable responses
+    uint16_t message_id;
+
+public:
+    bRESTCoap(bREST& rest, UDP& udp): rest(rest), udp(udp) {
+        next_exchange = 0;
+        message_id = (uint16_t)millis();
+    }
+
+    /**
+     * @brief begin listen on port of CoAP
+     * @param port UDP port
+     * @return true if successful. Otherwise, false.
+     */
+    bool begin(uint16_t port = COAP_DEFAULT_PORT) {
+        return udp.begin(port);
+    }
+
+    /**
+     * @brief poll serve every received datagram. Call it in loop().
+     */
+    void poll() {
+        int size;
+        while ((size = udp.parsePacket()) > 0) {
+            int length = udp.read(packet, (size < MAX_COAP_MESSAGE_SIZE)? size: MAX_COAP_MESSAGE_SIZE);
+            if (length > 0)
+                serve(length, size > MAX_COAP_MESSAGE_SIZE);
+        }
+    }
+
+protected:
+    /**
+     * @brief serve answer one datagram in packet
+     * @param length length of datagram in packet
+     * @param is_too_large datagram did not fit in packet
+     */
+    void serve(uint16_t length, bool is_too_large) {
+        if (length < COAP_HEADER_SIZE || (packet[0] >> 6) != COAP_VERSION)
+            return;
+
+        uint8_t type = (packet[0] >> 4) & 0x03;
+        uint8_t token_length = packet[0] & 0x0F;
+        uint8_t code = packet[1];
+        uint16_t id = (uint16_t)packet[2] << 8 | packet[3];
+        // bREST sends no confirmable message, so acknowledgements and resets are not expected
+        if (type >= COAP_TYPE_ACK)
+            return;
+        // empty message is a ping, and responses are not expected either
+        if (token_length > COAP_MAX_TOKEN_LENGTH || COAP_HEADER_SIZE + token_length > length
+                || COAP_EMPTY == code || (code >> 5) != 0) {
+            if (COAP_TYPE_CON == type)
+                reject(id);
+            return;
+        }
+
+        ADDRESS address = udp.remoteIP();
+        uint16_t port = udp.remotePort();
+        bRESTCoapExchange<ADDRESS>* exchange = find_exchange(address, port, id);
+        if (exchange != NULL) {
+            if (COAP_TYPE_NON == type)
+                return;
+            if (exchange->response_length != 0) {
+                send(address, port, exchange->response, exchange->response_length, NULL, 0);
+                return;
+            }
+            // response is not kept, so the request runs again. GET, PUT and DELETE are idempotent, POST may not be.
+        } else {
+            exchange = add_exchange(address, port, id);
+        }
+
+        const uint8_t* token = packet + COAP_HEADER_SIZE;
+        if (is_too_large) {
+            respond(type, id, token, token_length, COAP_REQUEST_ENTITY_TOO_LARGE, NULL, 0, exchange);
+            return;
+        }
+
+        char* resource;
+        uint16_t parms_length;
+        uint8_t error = COAP_EMPTY;
+        RESPONSE_FORMAT format = RESPONSE_FORMAT_JSON;
+        if (!decode_options(COAP_HEADER_SIZE + token_length, length, resource, parms_length, format, error)) {
+            if (COAP_TYPE_CON == type)
+                reject(id);
+            return;
+        }
+
+        HTTP_METHOD method = get_method(code);
+        if (COAP_EMPTY == error && HTTP_METHOD_UNSET == method) {
+            rest.record_error(CODE_ERROR_INVALID_HTTP_METHOD);
+            error = COAP_METHOD_NOT_ALLOWED;
+        }
+        if (error != COAP_EMPTY) {
+            respond(type, id, token, token_length, error, NULL, 0, exchange);
+            return;
+        }
+
+        rest.handle_message(method, resource, (const uint8_t*)resource + strlen(resource) + 1, parms_length, format);
+        respond(type, id, token, token_length, get_response_code(rest.get_last_status(), method),
+                (const uint8_t*)rest.getBuffer(), rest.get_buffer_length(), exchange, rest.get_response_format());
+        rest.resetBuffer();
+    }
+
+    /**
+     * @brief decode_options gather options in place after token: NUL terminated resource ID from Uri-Path, then
+     *        parameters "key=value&key=value" from Uri-Query and payload
+     * @param position start of options
+     * @param length length of datagram
+     * @param resource resource ID
+     * @param parms_length length of parameters, which follow resource ID without NUL terminator
+     * @param format format of response asked by Accept
+     * @param error response code if request is well-formed but cannot be served. Otherwise, COAP_EMPTY.
+     * @return true if options are well-formed. Otherwise, false.
+     */
+    bool decode_options(uint16_t position, uint16_t length, char*& resource, uint16_t& parms_length,
+                        RESPONSE_FORMAT& format, uint8_t& error) {
+        // every option is gathered with at most one separator, and its header takes one byte at least, so output
+        // never overtakes input
+        uint16_t output = position;
+        uint16_t parms_start = 0;
+        uint16_t number = 0;
+        resource = (char*)packet + output;
+
+        while (position < length && packet[position] != COAP_PAYLOAD_MARKER) {
+            uint16_t delta = packet[position] >> 4;
+            uint16_t option_length = packet[position] & 0x0F;
+            position++;
+            if (!read_extended(delta, position, length) || !read_extended(option_length, position, length)
+                    || position + option_length > length)
+                return false;
+            number += delta;
+
+            if (number > COAP_OPTION_URI_PATH && 0 == parms_start) {
+                packet[output++] = '\0';
+                parms_start = output;
+            }
+
+            if (COAP_OPTION_URI_PATH == number) {
+                // resources have one level, and a trailing slash is an empty segment
+                if ((char*)packet + output != resource && option_length != 0)
+                    error = COAP_NOT_FOUND;
+                else
+                    output = gather(output, position, option_length);
+            } else if (COAP_OPTION_URI_QUERY == number) {
+                if (output != parms_start)
+                    packet[output++] = '&';
+                output = gather(output, position, option_length);
+            } else if (COAP_OPTION_ACCEPT == number) {
+                uint32_t content_format = read_uint(position, option_length);
+                if (BREST_BINARY_FORMATS && COAP_CONTENT_FORMAT_CBOR == content_format)
+                    format = RESPONSE_FORMAT_CBOR;
+                else if (content_format != COAP_CONTENT_FORMAT_JSON)
+                    error = COAP_NOT_ACCEPTABLE;
+            } else if ((number & 1) && number != COAP_OPTION_URI_HOST && number != COAP_OPTION_URI_PORT) {
+                // unrecognized critical option
+                error = COAP_BAD_OPTION;
+            }
+            position += option_length;
+        }
+
+        if (0 == parms_start) {
+            packet[output++] = '\0';
+            parms_start = output;
+        }
+
+        if (position < length) {
+            // payload marker needs payload
+            position++;
+            if (position == length)
+                return false;
+            if (output != parms_start)
+                packet[output++] = '&';
+            output = gather(output, position, length - position);
+        }
+        parms_length = output - parms_start;
+        return true;
+    }
+
+    /**
+     * @brief read_extended read extended option delta or length
+     * @param value 4-bit value, extended in place
+     * @param position position of extended bytes, advanced past them
+     * @param length length of datagram
+     * @return true if well-formed. Otherwise, false.
+     */
+    bool read_extended(uint16_t& value, uint16_t& position, uint16_t length) {
+        if (13 == value) {
+            if (position + 1 > length)
+                return false;
+            value = 13 + packet[position++];
+        } else if (14 == value) {
+            if (position + 2 > length)
+                return false;
+            value = 269 + ((uint16_t)packet[position] << 8 | packet[position + 1]);
+            position += 2;
+        } else if (15 == value) {
+            return false;
+        }
+        return true;
+    }
+
+    uint32_t read_uint(uint16_t position, uint16_t length) {
+        uint32_t value = 0;
+        for (uint16_t i = 0; i < length; i++)
+            value = value << 8 | packet[position + i];
+        return value;
+    }
+
+    uint16_t gather(uint16_t output, uint16_t position, uint16_t length) {
+        memmove(packet + output, packet + position, length);
+        return output + length;
+    }
+
+    static HTTP_METHOD get_method(uint8_t code) {
+        switch (code) {
+        case COAP_GET:
+            return HTTP_METHOD_GET;
+        case COAP_PUT:
+            return HTTP_METHOD_PUT;
+        case COAP_POST:
+            return HTTP_METHOD_POST;
+        case COAP_DELETE:
+            return HTTP_METHOD_DELETE;
+        default:
+            return HTTP_METHOD_UNSET;
+        }
+    }
+
+    static uint8_t get_response_code(MESSAGE_STATUS_CODE status, HTTP_METHOD method) {
+        switch (status) {
+        case CODE_OK:
+            if (HTTP_METHOD_GET == method)
+                return COAP_CONTENT;
+            return (HTTP_METHOD_DELETE == method)? COAP_DELETED: COAP_CHANGED;
+        case CODE_ERROR_URL_PARSING_OVERFLOW:
+            return COAP_REQUEST_ENTITY_TOO_LARGE;
+        case CODE_ERROR_NO_OBSERVERS_ACTIVATED:
+            return COAP_NOT_FOUND;
+        case CODE_ERROR_INVALID_HTTP_METHOD:
+            return COAP_METHOD_NOT_ALLOWED;
+        case CODE_ERROR_TOO_MANY_SUBSCRIBERS:
+            return COAP_SERVICE_UNAVAILABLE;
+        default:
+            return COAP_BAD_REQUEST;
+        }
+    }
+
+    /**
+     * @brief respond send piggybacked acknowledgement of confirmable request, or non-confirmable response, and keep
+     *        it with exchange if it fits
+     * @param format format of payload, for its Content-Format
+     */
+    void respond(uint8_t type, uint16_t id, const uint8_t* token, uint8_t token_length, uint8_t code,
+                 const uint8_t* payload, uint16_t payload_length, bRESTCoapExchange<ADDRESS>* exchange,
+                 RESPONSE_FORMAT format = RESPONSE_FORMAT_JSON) {
+        uint8_t header[COAP_HEADER_SIZE + COAP_MAX_TOKEN_LENGTH + 3];
+        uint8_t size = 0;
+        if (COAP_TYPE_CON == type) {
+            header[size++] = COAP_VERSION << 6 | COAP_TYPE_ACK << 4 | token_length;
+        } else {
+            header[size++] = COAP_VERSION << 6 | COAP_TYPE_NON << 4 | token_length;
+            id = message_id++;
+        }
+        header[size++] = code;
+        header[size++] = id >> 8;
+        header[size++] = id;
+        memcpy(header + size, token, token_length);
+        size += token_length;
+        if (payload_length != 0) {
+            // Content-Format: application/json or application/cbor
+            header[size++] = COAP_OPTION_CONTENT_FORMAT << 4 | 1;
+            header[size++] = (RESPONSE_FORMAT_CBOR == format)? COAP_CONTENT_FORMAT_CBOR: COAP_CONTENT_FORMAT_JSON;
+            header[size++] = COAP_PAYLOAD_MARKER;
+        }
+
+        send(exchange->address, exchange->port, header, size, payload, payload_length);
+
+        if (size + payload_length <= MAX_COAP_CACHED_RESPONSE_SIZE) {
+            memcpy(exchange->response, header, size);
+            if (payload_length != 0)
+                memcpy(exchange->response + size, payload, payload_length);
+            exchange->response_length = size + payload_length;
+        }
+    }
+
+    /**
+     * @brief reject send reset for a confirmable message that cannot be processed
+     * @param id message ID
+     */
+    void reject(uint16_t id) {
+        uint8_t reset[COAP_HEADER_SIZE] = {COAP_VERSION << 6 | COAP_TYPE_RST << 4, COAP_EMPTY, (uint8_t)(id >> 8),
+                                           (uint8_t)id};
+        send(udp.remoteIP(), udp.remotePort(), reset, sizeof(reset), NULL, 0);
+    }
+
+    void send(const ADDRESS& address, uint16_t port, const uint8_t* header, uint16_t header_length,
+              const uint8_t* payload, uint16_t payload_length) {
+        udp.beginPacket(address, port);
+        udp.write(header, header_length);
+        if (payload_length != 0)
+            udp.write(payload, payload_length);
+        udp.endPacket();
+    }
+
+    bRESTCoapExchange<ADDRESS>* find_exchange(const ADDRESS& address, uint16_t port, uint16_t id) {
+        uint32_t now = millis();
+        for (uint8_t i = 0; i < MAX_COAP_EXCHANGES; i++) {
+            bRESTCoapExchange<ADDRESS>& exchange = exchanges[i];
+            if (exchange.is_used && exchange.message_id == id && exchange.port == port && exchange.address == address
+                    && now - exchange.time < COAP_EXCHANGE_LIFETIME)
+                return &exchange;
+        }
+        return NULL;
+    }
+
+    /**
+     * @brief add_exchange remember request in place of the oldest exchange
+     */
+    bRESTCoapExchange<ADDRESS>* add_exchange(const ADDRESS& address, uint16_t port, uint16_t id) {
+        bRESTCoapExchange<ADDRESS>& exchange = exchanges[next_exchange];
+        next_exchange = (next_exchange + 1) % MAX_COAP_EXCHANGES;
+        exchange.address = address;
+        exchange.port = port;
+        exchange.message_id = id;
+        exchange.time = millis();
+        exchange.is_used = true;
+        exchange.response_length = 0;
+        return &exchange;
+    }
+};
+
+#endif // bREST_COAP_H
@@ -0,0 +1,90 @@
+/*
+  Board defaults and debug log shared by bREST and the aREST adapter.
+*/
+#ifndef bREST_CONFIG_H
+#define bREST_CONFIG_H
+
+#include <stdarg.h>
+
+#include "Arduino.h"
+
+// Using ESP8266 ?
+#if defined(ESP8266) || defined(ESP32)
+#include "stdlib_noniso.h"
+#endif
+
+// Cast a PROGMEM string to flash string, as ESP8266 core does
+#ifndef FPSTR
+#define FPSTR(pstr_pointer) (reinterpret_cast<const __FlashStringHelper*>(pstr_pointer))
+#endif
+
+// Size of output buffer. Default depends on board.
+#ifndef OUTPUT_BUFFER_SIZE
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__) || defined(CORE_WILDFIRE) || defined(ESP8266) || defined(ESP32)
+#define OUTPUT_BUFFER_SIZE 2000
+#elif defined(__AVR_ATmega328P__) && !defined(ADAFRUIT_CC3000_H)
+#define OUTPUT_BUFFER_SIZE 350
+#elif defined(ADAFRUIT_CC3000_H)
+#define OUTPUT_BUFFER_SIZE 275
+#else
+#define OUTPUT_BUFFER_SIZE 350
+#endif
+#endif
+
+// Set largest MQTT message the broker accepts. Larger responses are dropped. Default is 268435455, the MQTT limit.
+#ifndef MAX_MQTT_MESSAGE_SIZE
+#define MAX_MQTT_MESSAGE_SIZE   268435455UL
+#endif
+
+// Enable it if print out bREST debug message. Default is disable.
+#ifndef DEBUG
+#define DEBUG                   0
+#endif
+
+// Enable it if print out Observer sub class debug message. Default is disable.
+#ifndef APP_DEBUG
+#define APP_DEBUG               0
+#endif
+
+static void log(String formatString,...) {
+#if APP_DEBUG
+
+    int i, j, count = 0;
+    va_list argv;
+    const char* fmt = formatString.c_str();
+    va_start(argv, formatString);
+    for(i = 0, j = 0; fmt[i] != '\0'; i++) {
+        if (fmt[i] == '%') {
+            count++;
+
+            Serial.write(reinterpret_cast<const uint8_t*>(fmt+j), i-j);
+
+            switch (fmt[++i]) {
+                case 'd': Serial.print(va_arg(argv, int));
+                    break;
+                case 'l': Serial.print(va_arg(argv, long));
+                    break;
+                case 'f': Serial.print(va_arg(argv, double));
+                    break;
+                case 'c': Serial.print((char) va_arg(argv, int));
+                    break;
+                case 's': Serial.print(va_arg(argv, char *));
+                    break;
+                case '%': Serial.print("%");
+                    break;
+                default:;
+            };
+
+            j = i+1;
+        }
+    };
+    va_end(argv);
+
+    if(i > j) {
+        Serial.write(reinterpret_cast<const uint8_t*>(fmt+j), i-j);
+    }
+
+#endif
+}
+
+#endif // bREST_CONFIG_H
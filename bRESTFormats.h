@@ -0,0 +1,275 @@
+/*
+  Response formats of bREST: JSON, CBOR (RFC 8949) and MessagePack.
+
+  Resources that render with start_json_msg(), put() or append_key_value_pair_to_json(), and end_json_msg() write
+  one map in the format the client negotiated, with the same handler code:
+      HTTP    Accept: application/cbor               or application/msgpack
+      MQTT    <device>/<resource>/get/cbor           response on <device>/<resource>/cbor
+      CoAP    Accept: 60                             application/cbor
+  Integers take their shortest encoding, floats are single precision, and strings are not escaped. Text appended
+  with addToBuffer() or append_raw_to_json(), templates, error messages and reserved endpoints stay JSON.
+*/
+#ifndef bREST_FORMATS_H
+#define bREST_FORMATS_H
+
+#include "bRESTConfig.h"
+#include "bRESTRequest.h"
+
+// Enable it to render responses in CBOR or MessagePack on request. Default is disable.
+#ifndef BREST_BINARY_FORMATS
+#define BREST_BINARY_FORMATS    0
+#endif
+
+/**
+ * @brief get_format_name get name of format, as in topic suffix and media type
+ * @param format format
+ * @return name in flash, i.e. "cbor"
+ */
+static inline PGM_P get_format_name(RESPONSE_FORMAT format) {
+    switch (format) {
+    case RESPONSE_FORMAT_CBOR:
+        return PSTR("cbor");
+    case RESPONSE_FORMAT_MSGPACK:
+        return PSTR("msgpack");
+    default:
+        return PSTR("json");
+    }
+}
+
+/**
+ * @brief parse_format_name find format by name, i.e. suffix of MQTT topic
+ * @param name NUL terminated name
+ * @param format set to format if found
+ * @return true if name is a format, and it is enabled. Otherwise, false.
+ */
+static inline bool parse_format_name(const char* name, RESPONSE_FORMAT& format) {
+#if BREST_BINARY_FORMATS
+    const uint8_t last = RESPONSE_FORMAT_MSGPACK;
+#else
+    const uint8_t last = RESPONSE_FORMAT_JSON;
+#endif
+    for (uint8_t i = 0; i <= last; i++) {
+        if (0 == strcmp_P(name, get_format_name((RESPONSE_FORMAT)i))) {
+            format = (RESPONSE_FORMAT)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief get_content_type get media type of format for Content-Type header
+ * @param format format
+ * @return media type in flash
+ */
+static inline const __FlashStringHelper* get_content_type(RESPONSE_FORMAT format) {
+    switch (format) {
+    case RESPONSE_FORMAT_CBOR:
+        return F("application/cbor");
+    case RESPONSE_FORMAT_MSGPACK:
+        return F("application/msgpack");
+    default:
+        return F("application/json");
+    }
+}
+
+#if BREST_BINARY_FORMATS
+
+// Largest head of a value: type byte and an argument as wide as unsigned long, which is 64-bit on some hosts
+#define BINARY_FORMAT_HEAD_SIZE (1 + sizeof(unsigned long))
+
+/**
+ * @brief The bRESTBinaryFormat struct encodes heads of CBOR and MessagePack values. Each function writes at most
+ *        BINARY_FORMAT_HEAD_SIZE bytes and returns how many it wrote. Bytes of strings follow their head as they are.
+ */
+struct bRESTBinaryFormat {
+    static uint8_t encode_int(RESPONSE_FORMAT format, long value, uint8_t* out) {
+        if (RESPONSE_FORMAT_CBOR == format)
+            return (value >= 0)? encode_cbor_head(0, value, out): encode_cbor_head(1, -1 - value, out);
+
+        if (value >= 0) {
+            // positive fixint
+            if (value < 0x80) {
+                out[0] = value;
+                return 1;
+            }
+            return encode_msgpack_uint(0xCC, value, out);
+        }
+        // negative fixint
+        if (value >= -32) {
+            out[0] = (uint8_t)value;
+            return 1;
+        }
+        if (value >= -128)
+            return encode_big_endian(0xD0, (uint8_t)value, 1, out);
+        if (value >= -32768L)
+            return encode_big_endian(0xD1, (uint16_t)value, 2, out);
+        if (value >= -2147483647L - 1)
+            return encode_big_endian(0xD2, (uint32_t)value, 4, out);
+        return encode_big_endian(0xD3, (unsigned long)value, 8, out);
+    }
+
+    static uint8_t encode_uint(RESPONSE_FORMAT format, unsigned long value, uint8_t* out) {
+        if (RESPONSE_FORMAT_CBOR == format)
+            return encode_cbor_head(0, value, out);
+        // positive fixint
+        if (value < 0x80) {
+            out[0] = value;
+            return 1;
+        }
+        return encode_msgpack_uint(0xCC, value, out);
+    }
+
+    static uint8_t encode_float(RESPONSE_FORMAT format, float value, uint8_t* out) {
+        static_assert(sizeof(float) == 4, "float must be single precision");
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return encode_big_endian((RESPONSE_FORMAT_CBOR == format)? 0xFA: 0xCA, bits, 4, out);
+    }
+
+    static uint8_t encode_bool(RESPONSE_FORMAT format, bool value, uint8_t* out) {
+        if (RESPONSE_FORMAT_CBOR == format)
+            out[0] = value? 0xF5: 0xF4;
+        else
+            out[0] = value? 0xC3: 0xC2;
+        return 1;
+    }
+
+    static uint8_t encode_string_head(RESPONSE_FORMAT format, uint16_t length, uint8_t* out) {
+        if (RESPONSE_FORMAT_CBOR == format)
+            return encode_cbor_head(3, length, out);
+        // fixstr, str 8 and str 16
+        if (length < 32) {
+            out[0] = 0xA0 | length;
+            return 1;
+        }
+        return (length < 0x100)? encode_big_endian(0xD9, length, 1, out): encode_big_endian(0xDA, length, 2, out);
+    }
+
+    static uint8_t encode_map_head(RESPONSE_FORMAT format, uint16_t count, uint8_t* out) {
+        if (RESPONSE_FORMAT_CBOR == format)
+            return encode_cbor_head(5, count, out);
+        // fixmap and map 16
+        if (count < 16) {
+            out[0] = 0x80 | count;
+            return 1;
+        }
+        return encode_big_endian(0xDE, count, 2, out);
+    }
+
+protected:
+    static uint8_t encode_cbor_head(uint8_t major, unsigned long argument, uint8_t* out) {
+        if (argument < 24) {
+            out[0] = major << 5 | argument;
+            return 1;
+        }
+        if (argument < 0x100)
+            return encode_big_endian(major << 5 | 24, argument, 1, out);
+        if (argument < 0x10000UL)
+            return encode_big_endian(major << 5 | 25, argument, 2, out);
+        if (!is_wide(argument))
+            return encode_big_endian(major << 5 | 26, argument, 4, out);
+        return encode_big_endian(major << 5 | 27, argument, 8, out);
+    }
+
+    static uint8_t encode_msgpack_uint(uint8_t type, unsigned long value, uint8_t* out) {
+        // uint 8, uint 16, uint 32 and uint 64 are consecutive types
+        if (value < 0x100)
+            return encode_big_endian(type, value, 1, out);
+        if (value < 0x10000UL)
+            return encode_big_endian(type + 1, value, 2, out);
+        if (!is_wide(value))
+            return encode_big_endian(type + 2, value, 4, out);
+        return encode_big_endian(type + 3, value, 8, out);
+    }
+
+    /**
+     * @brief is_wide check whether value needs more than 32 bits. Never on boards with 32-bit long.
+     */
+    static bool is_wide(unsigned long value) {
+        return (value >> 16 >> 16) != 0;
+    }
+
+    static uint8_t encode_big_endian(uint8_t type, unsigned long value, uint8_t size, uint8_t* out) {
+        out[0] = type;
+        for (uint8_t i = size; i > 0; i--) {
+            out[i] = value;
+            value >>= 8;
+        }
+        return size + 1;
+    }
+};
+
+/**
+ * @brief The bRESTAcceptScanner class picks format from Accept header lines of HTTP request, one character at a time.
+ * @details The first of "json", "cbor" and "msgpack" found in Accept headers wins, so application/x-msgpack is taken
+ *          as well. Quality values are not weighed. Without any of them, response is JSON.
+ */
+class bRESTAcceptScanner {
+protected:
+    // how much of "accept:" the current header line matches
+    uint8_t header_match;
+    // how much of each format name the header value matches
+    uint8_t name_match[RESPONSE_FORMAT_MSGPACK + 1];
+    bool is_found;
+
+public:
+    bRESTAcceptScanner() {
+        reset();
+    }
+
+    void reset() {
+        header_match = ACCEPT_NO_MATCH;
+        is_found = false;
+    }
+
+    /**
+     * @brief scan match one character of header lines
+     * @param c character
+     * @param is_line_start c starts a header line
+     * @param format set to format once one is found
+     */
+    void scan(char c, bool is_line_start, RESPONSE_FORMAT& format) {
+        if (is_found)
+            return;
+        if (is_line_start)
+            header_match = 0;
+
+        if (header_match < ACCEPT_HEADER_LENGTH) {
+            if (tolower(c) == (char)pgm_read_byte(PSTR("accept:") + header_match)) {
+                if (++header_match == ACCEPT_HEADER_LENGTH)
+                    memset(name_match, 0, sizeof(name_match));
+            } else {
+                header_match = ACCEPT_NO_MATCH;
+            }
+        } else if (ACCEPT_HEADER_LENGTH == header_match) {
+            if (c == '\r') {
+                header_match = ACCEPT_NO_MATCH;
+                return;
+            }
+            c = tolower(c);
+            for (uint8_t i = 0; i <= RESPONSE_FORMAT_MSGPACK; i++) {
+                PGM_P name = get_format_name((RESPONSE_FORMAT)i);
+                // names do not repeat their first letter, so a mismatch restarts at most one letter back
+                if (c == (char)pgm_read_byte(name + name_match[i]))
+                    name_match[i]++;
+                else
+                    name_match[i] = (c == (char)pgm_read_byte(name))? 1: 0;
+
+                if ('\0' == pgm_read_byte(name + name_match[i])) {
+                    format = (RESPONSE_FORMAT)i;
+                    is_found = true;
+                    return;
+                }
+            }
+        }
+    }
+
+protected:
+    static const uint8_t ACCEPT_HEADER_LENGTH = 7;
+    static const uint8_t ACCEPT_NO_MATCH = 0xFF;
+};
+
+#endif // BREST_BINARY_FORMATS
+
+#endif // bREST_FORMATS_H
@@ -0,0 +1,175 @@
+/*
+  Network client held by bREST beyond one request, i.e. by stream subscribers and WebSocket connections.
+*/
+#ifndef bREST_HELD_CLIENT_H
+#define bREST_HELD_CLIENT_H
+
+#include <new>
+
+#include "bRESTConfig.h"
+
+// Set size to hold a copy of network client, i.e. WiFiClient. Larger clients are closed after response. Default is 64.
+#ifndef MAX_HELD_CLIENT_SIZE
+#define MAX_HELD_CLIENT_SIZE    64
+#endif
+
+/**
+ * @brief The bRESTHeldClient class holds a copy of network client. The copy keeps connection open as long as it lives.
+ * @details Client type is erased by function pointers, so that holders need neither templates nor heap.
+ */
+class bRESTHeldClient {
+protected:
+    // tag of whether client fits in storage
+    template <bool FITS>
+    struct Fits {};
+
+    union {
+        uint8_t bytes[MAX_HELD_CLIENT_SIZE];
+        void* align_pointer;
+        long long align_integer;
+        double align_double;
+    } storage;
+
+    int (*available_client)(void* client);
+    int (*read_client)(void* client);
+    size_t (*write_client)(void* client, const uint8_t* buffer, size_t size);
+    size_t (*write_all_client)(void* client, const uint8_t* buffer, size_t size);
+    bool (*is_client_connected)(void* client);
+    void (*stop_client)(void* client);
+    bool held;
+
+public:
+    bRESTHeldClient() {
+        held = false;
+    }
+
+    /**
+     * @brief fits check whether a copy of client type fits in MAX_HELD_CLIENT_SIZE
+     */
+    template <typename T>
+    static constexpr bool fits() {
+        return sizeof(T) <= MAX_HELD_CLIENT_SIZE;
+    }
+
+    /**
+     * @brief hold keep a copy of client
+     * @param client network client
+     * @return true if client is held. Otherwise, false if it does not fit, and caller closes it.
+     */
+    template <typename T>
+    bool hold(T& client) {
+        return hold(client, Fits<fits<T>()>());
+    }
+
+    /**
+     * @brief release close connection and destroy the copy
+     */
+    void release() {
+        if (!held)
+            return;
+        stop_client(storage.bytes);
+        held = false;
+    }
+
+    bool is_held() {
+        return held;
+    }
+
+    int available() {
+        return available_client(storage.bytes);
+    }
+
+    int read() {
+        return read_client(storage.bytes);
+    }
+
+    /**
+     * @brief write write no more than client accepts without blocking, if client tells it by availableForWrite()
+     * @param buffer bytes
+     * @param size number of bytes
+     * @return number of bytes written
+     */
+    size_t write(const uint8_t* buffer, size_t size) {
+        return write_client(storage.bytes, buffer, size);
+    }
+
+    /**
+     * @brief write_all write all bytes. It may block until client accepts them.
+     * @param buffer bytes
+     * @param size number of bytes
+     * @return number of bytes written
+     */
+    size_t write_all(const uint8_t* buffer, size_t size) {
+        return write_all_client(storage.bytes, buffer, size);
+    }
+
+    bool connected() {
+        return is_client_connected(storage.bytes);
+    }
+
+protected:
+    template <typename T>
+    bool hold(T& client, Fits<true>) {
+        new (storage.bytes) T(client);
+        available_client = &available_of<T>;
+        read_client = &read_from<T>;
+        write_client = &write_to<T>;
+        write_all_client = &write_all_to<T>;
+        is_client_connected = &is_connected_of<T>;
+        stop_client = &stop_of<T>;
+        held = true;
+        return true;
+    }
+
+    template <typename T>
+    bool hold(T& client, Fits<false>) {
+        return false;
+    }
+
+    template <typename T>
+    static int available_of(void* client) {
+        return static_cast<T*>(client)->available();
+    }
+
+    template <typename T>
+    static int read_from(void* client) {
+        return static_cast<T*>(client)->read();
+    }
+
+    template <typename T>
+    static size_t write_to(void* client, const uint8_t* buffer, size_t size) {
+        T* p_client = static_cast<T*>(client);
+        size_t writable = available_for_write(p_client, 0);
+        return (0 == writable)? 0: p_client->write(buffer, (size < writable)? size: writable);
+    }
+
+    template <typename T>
+    static size_t write_all_to(void* client, const uint8_t* buffer, size_t size) {
+        return static_cast<T*>(client)->write(buffer, size);
+    }
+
+    template <typename T>
+    static auto available_for_write(T* client, int) -> decltype(client->availableForWrite(), size_t()) {
+        int writable = client->availableForWrite();
+        return (writable > 0)? writable: 0;
+    }
+
+    template <typename T>
+    static size_t available_for_write(T* client, long) {
+        return (size_t)-1;
+    }
+
+    template <typename T>
+    static bool is_connected_of(void* client) {
+        return static_cast<T*>(client)->connected();
+    }
+
+    template <typename T>
+    static void stop_of(void* client) {
+        T* p_client = static_cast<T*>(client);
+        p_client->stop();
+        p_client->~T();
+    }
+};
+
+#endif // bREST_HELD_CLIENT_H
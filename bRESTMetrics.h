@@ -0,0 +1,114 @@
+/*
+  Fixed-size request counters and log-scale latency histograms for bREST.
+
+  Latency is measured with micros(). Histogram bucket i counts samples up to 2^i microseconds, and the last bucket
+  counts the rest. Nothing is allocated: counters live in bREST and in each Observer.
+*/
+#ifndef bREST_METRICS_H
+#define bREST_METRICS_H
+
+#include "bRESTConfig.h"
+
+// Enable it to keep request metrics and serve them on /_metrics. Default is disable.
+#ifndef BREST_METRICS
+#define BREST_METRICS           0
+#endif
+
+// Set room for one line of Prometheus exposition, besides its resource ID. Default is 112.
+#ifndef METRICS_LINE_RESERVE
+#define METRICS_LINE_RESERVE    112
+#endif
+
+// Set number of buckets of latency histogram. Default is 16, which covers up to 16384 microseconds.
+#ifndef MAX_METRICS_BUCKETS
+#define MAX_METRICS_BUCKETS     16
+#endif
+
+// Reserved resource ID of metrics endpoint
+#define METRICS_RESOURCE_ID     "_metrics"
+
+typedef enum {
+    // reading request, process(), request line cache, urldecode() and parse_url()
+    STAGE_PARSE,
+    // reserved endpoints and resource lookup, up to call back
+    STAGE_DISPATCH,
+    // resource call back
+    STAGE_UPDATE,
+    // writing output buffer to client
+    STAGE_SEND,
+    STAGE_COUNT
+} METRICS_STAGE;
+
+/**
+ * @brief The bRESTHistogram class counts latency samples in log2 buckets.
+ */
+class bRESTHistogram {
+public:
+    uint32_t buckets[MAX_METRICS_BUCKETS];
+    uint32_t count;
+    // sum of samples in microseconds
+    uint32_t sum;
+
+    bRESTHistogram() {
+        reset();
+    }
+
+    void reset() {
+        memset(buckets, 0, sizeof(buckets));
+        count = 0;
+        sum = 0;
+    }
+
+    /**
+     * @brief record add one latency sample
+     * @param elapsed latency in microseconds
+     */
+    void record(uint32_t elapsed) {
+        buckets[bucket_of(elapsed)]++;
+        count++;
+        sum += elapsed;
+    }
+
+    /**
+     * @brief bucket_of get bucket of latency sample
+     * @param elapsed latency in microseconds
+     * @return the smallest i that elapsed <= 2^i, or the last bucket
+     */
+    static uint8_t bucket_of(uint32_t elapsed) {
+        uint8_t i = 0;
+        while (i < MAX_METRICS_BUCKETS - 1 && ((uint32_t)1 << i) < elapsed)
+            i++;
+        return i;
+    }
+
+    /**
+     * @brief upper_bound get inclusive upper bound of bucket. The last bucket has no bound.
+     * @param i bucket index
+     * @return upper bound in microseconds
+     */
+    static uint32_t upper_bound(uint8_t i) {
+        return (uint32_t)1 << i;
+    }
+};
+
+/**
+ * @brief get_stage_name get name of request stage
+ * @param stage request stage
+ * @return name in flash
+ */
+static const __FlashStringHelper* get_stage_name(METRICS_STAGE stage) {
+    switch(stage) {
+    case STAGE_PARSE:
+        return F("parse");
+    case STAGE_DISPATCH:
+        return F("dispatch");
+    case STAGE_UPDATE:
+        return F("update");
+    case STAGE_SEND:
+        return F("send");
+    default:
+        return F("unknown");
+    }
+}
+
+#endif // bREST_METRICS_H
@@ -0,0 +1,172 @@
+/*
+  MQTT transport of bREST.
+
+  Topics map onto resources directly, and the response is published on the topic of the resource:
+      <device>/<resource>/set   payload "open=true&delay=5"   PUT, response on <device>/<resource>
+      <device>/<resource>/get   empty payload                  GET, response on <device>/<resource>
+  A format suffix asks for a binary response, published on a topic of its own, so JSON subscribers never see it:
+      <device>/<resource>/get/cbor                              response on <device>/<resource>/cbor
+      <device>/<resource>/set/msgpack                           response on <device>/<resource>/msgpack
+  The resource ID is parsed in place from the topic, and payload parameters go to Observer::on_request() without
+  String or a request line in between. The response is published as one message. Clients with beginPublish(), such
+  as PubSubClient 2.7+, stream it from the output buffer to the network, so it is not bounded by their packet buffer.
+
+  It works with any client in the shape of PubSubClient:
+      WiFiClient wifi;
+      PubSubClient mqtt(wifi);
+      bRESTMqtt<PubSubClient> bridge(rest, mqtt, "plug1");
+
+      void callback(char* topic, byte* payload, unsigned int length) {
+          bridge.handle_message(topic, payload, length);
+      }
+      ...
+      mqtt.setCallback(callback);
+      if (mqtt.connect("plug1"))
+          bridge.subscribe();
+*/
+#ifndef bREST_MQTT_H
+#define bREST_MQTT_H
+
+#include "bREST.h"
+
+// Set maximum length of topics of bridge. Default is 64.
+#ifndef MAX_MQTT_TOPIC_LENGTH
+#define MAX_MQTT_TOPIC_LENGTH   64
+#endif
+
+/**
+ * @brief The bRESTMqtt class bridges set and get topics of one device to resources of bREST.
+ * @tparam CLIENT MQTT client with subscribe(const char*), and beginPublish(), write() and endPublish() or
+ *         publish(const char*, const uint8_t*, unsigned int)
+ */
+template <typename CLIENT>
+class bRESTMqtt {
+protected:
+    bREST& rest;
+    CLIENT& client;
+    const char* device;
+    uint8_t device_length;
+    uint32_t max_message_size;
+
+public:
+    /**
+     * @brief bRESTMqtt constructor
+     * @param rest bREST serving resources
+     * @param client MQTT client
+     * @param device first level of topics. It is not copied.
+     */
+    bRESTMqtt(bREST& rest, CLIENT& client, const char* device): rest(rest), client(client) {
+        this->device = device;
+        this->device_length = strlen(device);
+        this->max_message_size = MAX_MQTT_MESSAGE_SIZE;
+    }
+
+    /**
+     * @brief set_max_message_size set largest message the broker accepts, i.e. message_size_limit of mosquitto.
+     *        Larger responses are dropped.
+     * @param size size in bytes
+     */
+    void set_max_message_size(uint32_t size) {
+        max_message_size = size;
+    }
+
+    /**
+     * @brief subscribe subscribe to set and get topics of all resources, with format suffix as well if binary
+     *        formats are enabled. Call it after every connect.
+     * @return true if all subscriptions are sent. Otherwise, false.
+     */
+    bool subscribe() {
+        return subscribe_filter(PSTR("/+/set")) && subscribe_filter(PSTR("/+/get"))
+#if BREST_BINARY_FORMATS
+               && subscribe_filter(PSTR("/+/set/+")) && subscribe_filter(PSTR("/+/get/+"))
+#endif
+               ;
+    }
+
+    /**
+     * @brief handle_message serve message of set or get topic. Call it from call back of MQTT client.
+     * @param topic NUL terminated topic. It is modified in place.
+     * @param payload parameters "key=value&key=value"
+     * @param length length of payload
+     * @return true if topic belongs to bridge and response is published. Otherwise, false, i.e. response is larger
+     *         than max message size.
+     */
+    bool handle_message(char* topic, uint8_t* payload, unsigned int length) {
+        if (strncmp(topic, device, device_length) != 0 || topic[device_length] != '/')
+            return false;
+
+        char* resource = topic + device_length + 1;
+        char* suffix = strchr(resource, '/');
+        if (NULL == suffix || suffix == resource)
+            return false;
+
+        RESPONSE_FORMAT format = RESPONSE_FORMAT_JSON;
+        char* format_name = strchr(suffix + 1, '/');
+        if (format_name != NULL) {
+            *format_name++ = '\0';
+            if (!parse_format_name(format_name, format))
+                return false;
+        }
+
+        HTTP_METHOD method;
+        if (0 == strcmp_P(suffix + 1, PSTR("set")))
+            method = HTTP_METHOD_PUT;
+        else if (0 == strcmp_P(suffix + 1, PSTR("get")))
+            method = HTTP_METHOD_GET;
+        else
+            return false;
+
+        // topic becomes <device>/<resource>, the topic of response, followed by format suffix
+        *suffix = '\0';
+        uint16_t topic_length = suffix - topic;
+        if (topic_length + ((format != RESPONSE_FORMAT_JSON)? 1 + strlen(format_name): 0) > MAX_MQTT_TOPIC_LENGTH)
+            return false;
+
+        rest.handle_message(method, resource, payload, length, format);
+
+        // publishing overwrites buffer of client, where topic lives
+        char response_topic[MAX_MQTT_TOPIC_LENGTH + 1];
+        memcpy(response_topic, topic, topic_length + 1);
+        if (format != RESPONSE_FORMAT_JSON) {
+            response_topic[topic_length] = '/';
+            strcpy_P(response_topic + topic_length + 1, get_format_name(format));
+        }
+        uint16_t response_length = rest.get_buffer_length();
+        bool is_published = response_length <= max_message_size
+                            && publish(client, response_topic, (const uint8_t*)rest.getBuffer(), response_length, 0);
+        rest.resetBuffer();
+        return is_published;
+    }
+
+protected:
+    /**
+     * @brief publish stream message through beginPublish(), write() and endPublish() if client has them
+     */
+    template <typename T>
+    static auto publish(T& client, const char* topic, const uint8_t* payload, uint16_t length, int)
+            -> decltype(client.beginPublish(topic, length, false), bool()) {
+        if (!client.beginPublish(topic, length, false))
+            return false;
+        bool is_written = (client.write(payload, length) == length);
+        return client.endPublish() && is_written;
+    }
+
+    /**
+     * @brief publish copy message into packet buffer of client
+     */
+    template <typename T>
+    static bool publish(T& client, const char* topic, const uint8_t* payload, uint16_t length, long) {
+        return client.publish(topic, payload, length);
+    }
+
+    bool subscribe_filter(const char* suffix) {
+        char filter[MAX_MQTT_TOPIC_LENGTH + 1];
+        if (device_length + strlen_P(suffix) > MAX_MQTT_TOPIC_LENGTH)
+            return false;
+        memcpy(filter, device, device_length);
+        strcpy_P(filter + device_length, suffix);
+        return client.subscribe(filter);
+    }
+};
+
+#endif // bREST_MQTT_H
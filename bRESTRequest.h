@@ -0,0 +1,145 @@
+/*
+  Request representation shared by all transports of bREST.
+
+  HTTP, compact requests of WebSocket and serial frames, MQTT messages and CoAP datagrams are parsed into one
+  bRESTRequest, and bREST dispatches it the same way whichever transport it came from. Strings and parameter arrays
+  are referenced in place, not copied.
+*/
+#ifndef bREST_REQUEST_H
+#define bREST_REQUEST_H
+
+#include "Arduino.h"
+
+typedef enum {
+    HTTP_METHOD_GET,
+    HTTP_METHOD_PUT,
+    HTTP_METHOD_POST,
+    HTTP_METHOD_DELETE,
+    HTTP_METHOD_UNSET
+} HTTP_METHOD;
+
+typedef enum {
+    RESPONSE_FORMAT_JSON,
+    RESPONSE_FORMAT_CBOR,
+    RESPONSE_FORMAT_MSGPACK
+} RESPONSE_FORMAT;
+
+/**
+ * @brief The bRESTRequest struct is one parsed request: method, resource, parameters, body and response format.
+ */
+struct bRESTRequest {
+    HTTP_METHOD method;
+    // NUL terminated resource ID
+    char* resource_id;
+    // parameter names and values, split in place
+    char** parms;
+    char** value;
+    unsigned int parm_count;
+    // HTTP body
+    const unsigned char* body;
+    unsigned int body_length;
+    // format of response the client asked for
+    RESPONSE_FORMAT format;
+
+    /**
+     * @brief find find parameter. Names are matched case-insensitively.
+     * @param key name, i.e. F("angle")
+     * @return index of the first parameter with the name, or -1
+     */
+    int find(const __FlashStringHelper* key) const {
+        for (unsigned int i = 0; i < parm_count; i++) {
+            if (0 == strcasecmp_P(parms[i], reinterpret_cast<PGM_P>(key)))
+                return i;
+        }
+        return -1;
+    }
+
+    int find(const char* key) const {
+        for (unsigned int i = 0; i < parm_count; i++) {
+            if (0 == strcasecmp(parms[i], key))
+                return i;
+        }
+        return -1;
+    }
+
+    /**
+     * @brief get get value of parameter
+     * @param key name
+     * @return NUL terminated value, or NULL if not found
+     */
+    template <typename KEY>
+    const char* get(KEY key) const {
+        int i = find(key);
+        return (-1 == i)? NULL: value[i];
+    }
+
+    /**
+     * @brief get_int get value of parameter as integer
+     * @param key name
+     * @param fallback returned if parameter is not found or is not a number
+     * @return value
+     */
+    template <typename KEY>
+    long get_int(KEY key, long fallback) const {
+        const char* text = get(key);
+        if (NULL == text)
+            return fallback;
+        char* end;
+        long number = strtol(text, &end, 10);
+        return (end == text || *end != '\0')? fallback: number;
+    }
+
+    template <typename KEY>
+    float get_float(KEY key, float fallback) const {
+        const char* text = get(key);
+        if (NULL == text)
+            return fallback;
+        char* end;
+        float number = strtod(text, &end);
+        return (end == text || *end != '\0')? fallback: number;
+    }
+
+    /**
+     * @brief get_bool get value of parameter as boolean. "1" and "true" are true, "0" and "false" are false.
+     * @param key name
+     * @param fallback returned if parameter is not found or is none of them
+     * @return value
+     */
+    template <typename KEY>
+    bool get_bool(KEY key, bool fallback) const {
+        const char* text = get(key);
+        if (NULL == text)
+            return fallback;
+        if (0 == strcmp_P(text, PSTR("1")) || 0 == strcasecmp_P(text, PSTR("true")))
+            return true;
+        if (0 == strcmp_P(text, PSTR("0")) || 0 == strcasecmp_P(text, PSTR("false")))
+            return false;
+        return fallback;
+    }
+};
+
+/**
+ * @brief The bRESTStringSource class reads a NUL terminated string in the shape of network client, so that strings
+ *        take the same request path as clients and serial ports.
+ */
+class bRESTStringSource {
+protected:
+    const char* position;
+    const char* end;
+
+public:
+    bRESTStringSource(const char* string) {
+        position = string;
+        end = string + strlen(string);
+    }
+
+    int available() {
+        return end - position;
+    }
+
+    int read() {
+        return (position < end)? (unsigned char)*position++: -1;
+    }
+};
+
+#endif // bREST_REQUEST_H
@@ -0,0 +1,217 @@
+/*
+  Compile-time route table for bREST.
+
+  Routes are declared once as a constexpr PROGMEM array. The compiler searches a seed for a perfect hash over
+  resource IDs and emits a flash-resident slot table, so dispatch costs one hash over the requested ID and one
+  string comparison, with no runtime registration and no RAM spent on IDs.
+*/
+#ifndef bREST_ROUTE_TABLE_H
+#define bREST_ROUTE_TABLE_H
+
+#include "Arduino.h"
+
+// Set maximum length of resource ID in a compile-time route, including the terminating NUL. Default is 16.
+#ifndef MAX_ROUTE_ID_LENGTH
+#define MAX_ROUTE_ID_LENGTH     16
+#endif
+
+// Set the number of seeds tried at compile time to find a perfect hash. Default is 256.
+#ifndef MAX_ROUTE_HASH_SEEDS
+#define MAX_ROUTE_HASH_SEEDS    256
+#endif
+
+class Observer;
+
+/**
+ * @brief The Route struct binds a resource ID to its observer at compile time.
+ * @details Declare routes as a constexpr PROGMEM array so that both IDs and observer pointers stay in flash:
+ *      constexpr Route ROUTES[] PROGMEM = {{"switch", &powerPlug}, {"calc", &calculator}};
+ */
+struct Route {
+    char id[MAX_ROUTE_ID_LENGTH];
+    Observer* observer;
+};
+
+/**
+ * @brief The RouteHash struct holds hash functions shared by compile-time table generation and runtime lookup.
+ * @details Hash is 32 bits FNV-1a over lower case characters, so that lookup stays case insensitive.
+ */
+struct RouteHash {
+    static constexpr uint32_t NO_SEED = 0xFFFFFFFFUL;
+
+    static constexpr char lower(char c) {
+        return (c >= 'A' && c <= 'Z')? (char)(c + ('a' - 'A')): c;
+    }
+
+    static constexpr uint32_t basis(uint32_t seed) {
+        return (uint32_t)(2166136261UL ^ (uint32_t)(seed * 2654435761UL));
+    }
+
+    static constexpr uint32_t hash(const char* s, uint32_t h) {
+        return (*s == '\0')? h: hash(s + 1, (uint32_t)((h ^ (uint8_t)lower(*s)) * 16777619UL));
+    }
+
+    static constexpr uint32_t mix(uint32_t h) {
+        return h ^ (h >> 16);
+    }
+
+    /**
+     * @brief runtime_hash iterative equivalent of hash() for runtime lookup.
+     */
+    static uint32_t runtime_hash(const char* s, uint32_t seed) {
+        uint32_t h = basis(seed);
+        for (; *s != '\0'; s++)
+            h = (uint32_t)((h ^ (uint8_t)lower(*s)) * 16777619UL);
+        return mix(h);
+    }
+
+    static constexpr uint16_t slot_count(uint16_t route_count, uint16_t slots) {
+        // keep load factor at most 1/4, so that a perfect seed is found in a few tries
+        return (slots >= 4 * route_count)? slots: slot_count(route_count, slots * 2);
+    }
+
+    static constexpr uint8_t slot_of(const Route* routes, uint8_t i, uint32_t seed, uint8_t mask) {
+        return (uint8_t)(mix(hash(routes[i].id, basis(seed))) & mask);
+    }
+
+    static constexpr bool ids_equal(const char* a, const char* b) {
+        return lower(*a) == lower(*b) && (*a == '\0' || ids_equal(a + 1, b + 1));
+    }
+
+    static constexpr bool id_collides(const Route* routes, uint8_t n, uint8_t i, uint8_t j) {
+        return (j >= n)? false: ids_equal(routes[i].id, routes[j].id) || id_collides(routes, n, i, j + 1);
+    }
+
+    static constexpr bool ids_unique(const Route* routes, uint8_t n, uint8_t i) {
+        return (i >= n)? true: !id_collides(routes, n, i, i + 1) && ids_unique(routes, n, i + 1);
+    }
+
+    static constexpr bool slot_collides(const Route* routes, uint8_t n, uint8_t i, uint8_t j, uint32_t seed, uint8_t mask) {
+        return (j >= n)? false:
+               slot_of(routes, i, seed, mask) == slot_of(routes, j, seed, mask) || slot_collides(routes, n, i, j + 1, seed, mask);
+    }
+
+    static constexpr bool is_perfect(const Route* routes, uint8_t n, uint8_t i, uint32_t seed, uint8_t mask) {
+        return (i >= n)? true: !slot_collides(routes, n, i, i + 1, seed, mask) && is_perfect(routes, n, i + 1, seed, mask);
+    }
+
+    static constexpr uint32_t find_seed(const Route* routes, uint8_t n, uint32_t seed, uint8_t mask) {
+        return (seed >= MAX_ROUTE_HASH_SEEDS)? NO_SEED:
+               is_perfect(routes, n, 0, seed, mask)? seed: find_seed(routes, n, seed + 1, mask);
+    }
+
+    /**
+     * @brief slot_owner find the route hashed into slot.
+     * @return route index + 1 if any route owns the slot. Otherwise, 0.
+     */
+    static constexpr uint8_t slot_owner(const Route* routes, uint8_t n, uint8_t i, uint8_t slot, uint32_t seed, uint8_t mask) {
+        return (i >= n)? 0:
+               (slot_of(routes, i, seed, mask) == slot)? i + 1: slot_owner(routes, n, i + 1, slot, seed, mask);
+    }
+};
+
+/**
+ * @brief The RouteTable struct describes a perfect-hashed dispatch table generated by BREST_ROUTE_TABLE().
+ * @details Both routes and slots live in flash. Only this descriptor is copied into bREST.
+ */
+struct RouteTable {
+    const Route* routes;
+    // slot to route index + 1. 0 means empty slot.
+    const uint8_t* slots;
+    uint32_t seed;
+    uint8_t route_count;
+    uint8_t slot_mask;
+
+    /**
+     * @brief lookup find the observer of resource ID.
+     * @param id resource ID of request
+     * @return observer if ID is routed. Otherwise, NULL.
+     */
+    Observer* lookup(const char* id) const {
+        if (0 == route_count)
+            return NULL;
+
+        uint8_t slot = (uint8_t)(RouteHash::runtime_hash(id, seed) & slot_mask);
+        uint8_t route_index = pgm_read_byte(slots + slot);
+        if (0 == route_index)
+            return NULL;
+
+        const Route* route = routes + route_index - 1;
+        // a hash hit of unknown resource must not be dispatched
+        if (0 != strcasecmp_P(id, route->id))
+            return NULL;
+
+        return (Observer*)pgm_read_ptr(&route->observer);
+    }
+
+    /**
+     * @brief get_id get resource ID of route
+     * @param i route index
+     * @return resource ID in flash
+     */
+    const __FlashStringHelper* get_id(uint8_t i) const {
+        return reinterpret_cast<const __FlashStringHelper*>(routes[i].id);
+    }
+
+    /**
+     * @brief get_observer get observer of route
+     * @param i route index
+     * @return observer
+     */
+    Observer* get_observer(uint8_t i) const {
+        return (Observer*)pgm_read_ptr(&routes[i].observer);
+    }
+};
+
+template<size_t... Is>
+struct RouteIndexSequence {};
+
+template<size_t N, size_t... Is>
+struct MakeRouteIndexSequence: MakeRouteIndexSequence<N - 1, N - 1, Is...> {};
+
+template<size_t... Is>
+struct MakeRouteIndexSequence<0, Is...> {
+    typedef RouteIndexSequence<Is...> type;
+};
+
+template<size_t N, const Route (&ROUTES)[N], uint32_t SEED, typename SEQ>
+struct RouteSlots;
+
+template<size_t N, const Route (&ROUTES)[N], uint32_t SEED, size_t... Is>
+struct RouteSlots<N, ROUTES, SEED, RouteIndexSequence<Is...> > {
+    static const uint8_t slots[sizeof...(Is)];
+};
+
+template<size_t N, const Route (&ROUTES)[N], uint32_t SEED, size_t... Is>
+const uint8_t RouteSlots<N, ROUTES, SEED, RouteIndexSequence<Is...> >::slots[sizeof...(Is)] PROGMEM = {
+    RouteHash::slot_owner(ROUTES, N, 0, Is, SEED, sizeof...(Is) - 1)...
+};
+
+/**
+ * @brief The RouteTableBuilder struct runs the perfect hash search at compile time. Use BREST_ROUTE_TABLE() instead.
+ */
+template<size_t N, const Route (&ROUTES)[N]>
+struct RouteTableBuilder {
+    static_assert(N > 0 && N <= 64, "Route table supports 1 to 64 routes");
+    static_assert(RouteHash::ids_unique(ROUTES, N, 0), "Duplicated resource ID in route table");
+
+    static constexpr uint16_t SLOT_COUNT = RouteHash::slot_count(N, 1);
+    static constexpr uint32_t SEED = RouteHash::find_seed(ROUTES, N, 0, SLOT_COUNT - 1);
+
+    static_assert(SEED != RouteHash::NO_SEED, "No perfect hash found for route table. Increase MAX_ROUTE_HASH_SEEDS");
+
+    typedef RouteSlots<N, ROUTES, SEED, typename MakeRouteIndexSequence<SLOT_COUNT>::type> Slots;
+
+    static RouteTable table() {
+        RouteTable t = {ROUTES, Slots::slots, SEED, (uint8_t)N, (uint8_t)(SLOT_COUNT - 1)};
+        return t;
+    }
+};
+
+/**
+ * Build the dispatch table of a constexpr Route array, i.e. rest.set_route_table(BREST_ROUTE_TABLE(ROUTES));
+ */
+#define BREST_ROUTE_TABLE(ROUTES) \
+    (RouteTableBuilder<sizeof(ROUTES) / sizeof(ROUTES[0]), ROUTES>::table())
+
+#endif // bREST_ROUTE_TABLE_H
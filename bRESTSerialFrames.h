@@ -0,0 +1,283 @@
+/*
+  Framed serial transport of bREST.
+
+  Requests and responses travel as COBS encoded frames delimited by 0x00, so a receiver resynchronizes at the next
+  delimiter after noise or a lost byte. Before encoding, a frame is:
+      id(1) payload crc16(2)
+  Payload of request is a compact request, the same as WebSocket messages, i.e. "PUT servo1 angle=120". Payload of
+  response is the response of bREST without HTTP headers. id of response echoes id of its request, so that a bridge,
+  i.e. an ESP8266 serving many HTTP clients, may keep several requests outstanding and match responses by id. crc16 is
+  CRC-16/CCITT-FALSE of id and payload, big endian. Frames with bad CRC are dropped; the bridge retries on timeout.
+
+  Bytes are decoded as they arrive and responses are encoded straight from the output buffer, so neither direction
+  waits with delay():
+      bRESTSerialFrames frames(rest);
+      void loop() {
+          frames.poll(Serial);
+      }
+*/
+#ifndef bREST_SERIAL_FRAMES_H
+#define bREST_SERIAL_FRAMES_H
+
+#include "bREST.h"
+
+// Set maximum size of one decoded frame, id and CRC included. Larger frames are dropped. Default is 128.
+#ifndef MAX_SERIAL_FRAME_SIZE
+#define MAX_SERIAL_FRAME_SIZE   128
+#endif
+
+// Size of id and CRC around payload
+#define SERIAL_FRAME_ID_SIZE    1
+#define SERIAL_FRAME_CRC_SIZE   2
+
+/**
+ * @brief The bRESTFrameSegments struct lists up to three byte ranges that are encoded as one frame without copying.
+ */
+struct bRESTFrameSegments {
+    const uint8_t* data[3];
+    uint16_t length[3];
+    uint8_t count;
+
+    bRESTFrameSegments() {
+        count = 0;
+    }
+
+    void add(const uint8_t* data, uint16_t length) {
+        this->data[count] = data;
+        this->length[count] = length;
+        count++;
+    }
+
+    uint16_t total() const {
+        uint16_t sum = 0;
+        for (uint8_t i = 0; i < count; i++)
+            sum += length[i];
+        return sum;
+    }
+
+    uint8_t at(uint16_t position) const {
+        uint8_t i = 0;
+        while (position >= length[i])
+            position -= length[i++];
+        return data[i][position];
+    }
+};
+
+/**
+ * @brief The bRESTFrames class encodes and checks frames. Both device and bridge use it.
+ */
+class bRESTFrames {
+public:
+    /**
+     * @brief crc16 update CRC-16/CCITT-FALSE
+     * @param crc CRC so far, 0xFFFF to start
+     * @param data bytes
+     * @param length number of bytes
+     * @return updated CRC
+     */
+    static uint16_t crc16(uint16_t crc, const uint8_t* data, uint16_t length) {
+        for (uint16_t i = 0; i < length; i++) {
+            crc ^= (uint16_t)data[i] << 8;
+            for (uint8_t bit = 0; bit < 8; bit++)
+                crc = (crc & 0x8000)? (crc << 1) ^ 0x1021: crc << 1;
+        }
+        return crc;
+    }
+
+    /**
+     * @brief is_valid check length and CRC of decoded frame
+     * @param frame decoded frame
+     * @param length length of frame
+     * @return true if frame is intact. Otherwise, false.
+     */
+    static bool is_valid(const uint8_t* frame, uint16_t length) {
+        if (length < SERIAL_FRAME_ID_SIZE + SERIAL_FRAME_CRC_SIZE)
+            return false;
+        uint16_t crc = crc16(0xFFFF, frame, length - SERIAL_FRAME_CRC_SIZE);
+        return frame[length - 2] == (uint8_t)(crc >> 8) && frame[length - 1] == (uint8_t)crc;
+    }
+
+    /**
+     * @brief write_frame append CRC to segments, and write them COBS encoded with delimiter
+     * @param serial serial port or any Print
+     * @param segments id and payload
+     */
+    template <typename T>
+    static void write_frame(T& serial, bRESTFrameSegments& segments) {
+        uint16_t crc = 0xFFFF;
+        for (uint8_t i = 0; i < segments.count; i++)
+            crc = crc16(crc, segments.data[i], segments.length[i]);
+        uint8_t trailer[SERIAL_FRAME_CRC_SIZE] = {(uint8_t)(crc >> 8), (uint8_t)crc};
+        segments.add(trailer, sizeof(trailer));
+
+        uint16_t total = segments.total();
+        uint16_t start = 0;
+        while (true) {
+            // a block runs up to the next zero, at most 254 bytes
+            uint16_t end = start;
+            while (end < total && end - start < 254 && segments.at(end) != 0)
+                end++;
+            serial.write((uint8_t)(end - start + 1));
+            for (uint16_t i = start; i < end; i++)
+                serial.write(segments.at(i));
+            if (end == total)
+                break;
+            // a zero ended the block and is implied by its code. A full block implies none, so the next block starts
+            // at end even if it is a zero. A trailing zero leaves an empty block.
+            start = (end - start < 254)? end + 1: end;
+        }
+        serial.write((uint8_t)0);
+    }
+
+    /**
+     * @brief write_request write compact request as frame. Bridge uses it.
+     * @param serial serial port
+     * @param id request id
+     * @param request compact request
+     * @param length length of request
+     */
+    template <typename T>
+    static void write_request(T& serial, uint8_t id, const char* request, uint16_t length) {
+        bRESTFrameSegments segments;
+        segments.add(&id, SERIAL_FRAME_ID_SIZE);
+        segments.add((const uint8_t*)request, length);
+        write_frame(serial, segments);
+    }
+};
+
+/**
+ * @brief The bRESTCobsDecoder class decodes COBS frames byte by byte into a fixed buffer.
+ */
+class bRESTCobsDecoder {
+protected:
+    uint8_t frame[MAX_SERIAL_FRAME_SIZE];
+    uint16_t length;
+    // code of current block and its bytes left
+    uint8_t code;
+    uint8_t remaining;
+    bool overflow;
+    // frames dropped for size, or cut by a delimiter
+    uint32_t dropped;
+
+public:
+    bRESTCobsDecoder() {
+        reset();
+        dropped = 0;
+    }
+
+    /**
+     * @brief feed decode one received byte
+     * @param c byte
+     * @return length of frame completed by this byte, or 0. Frame stays in get_frame() until next feed().
+     */
+    uint16_t feed(uint8_t c) {
+        if (0 == c) {
+            // delimiter: a frame is complete only if its last block is. Delimiters between frames drop nothing.
+            uint16_t complete = (!overflow && 0 == remaining)? length: 0;
+            if (0 == complete && code != 0)
+                dropped++;
+            reset();
+            return complete;
+        }
+
+        if (0 == remaining) {
+            // zero implied by previous block, unless it is full
+            if (code != 0 && code != 0xFF)
+                append(0);
+            code = c;
+            remaining = c - 1;
+        } else {
+            append(c);
+            remaining--;
+        }
+        return 0;
+    }
+
+    const uint8_t* get_frame() {
+        return frame;
+    }
+
+    /**
+     * @brief get_dropped get number of frames larger than MAX_SERIAL_FRAME_SIZE, incomplete or empty
+     * @return number of frames
+     */
+    uint32_t get_dropped() {
+        return dropped;
+    }
+
+protected:
+    void append(uint8_t c) {
+        if (length < MAX_SERIAL_FRAME_SIZE)
+            frame[length++] = c;
+        else
+            overflow = true;
+    }
+
+    void reset() {
+        length = 0;
+        code = 0;
+        remaining = 0;
+        overflow = false;
+    }
+};
+
+/**
+ * @brief The bRESTSerialFrames class serves framed requests from a serial port with one bREST.
+ */
+class bRESTSerialFrames {
+protected:
+    bREST& rest;
+    bRESTCobsDecoder decoder;
+    uint32_t dropped;
+
+public:
+    bRESTSerialFrames(bREST& rest): rest(rest) {
+        dropped = 0;
+    }
+
+    /**
+     * @brief poll decode available bytes, and serve every complete frame. Call it in loop().
+     * @param serial serial port
+     */
+    template <typename T>
+    void poll(T& serial) {
+        while (serial.available() > 0) {
+            int c = serial.read();
+            if (c < 0)
+                break;
+            uint16_t length = decoder.feed((uint8_t)c);
+            if (length != 0)
+                serve(serial, decoder.get_frame(), length);
+        }
+    }
+
+    /**
+     * @brief get_dropped get number of frames dropped for bad CRC, size or a missing block
+     * @return number of frames
+     */
+    uint32_t get_dropped() {
+        return dropped + decoder.get_dropped();
+    }
+
+protected:
+    template <typename T>
+    void serve(T& serial, const uint8_t* frame, uint16_t length) {
+        if (!bRESTFrames::is_valid(frame, length)) {
+            dropped++;
+            return;
+        }
+
+        // response follows id in output buffer
+        rest.handle_compact((const char*)frame + SERIAL_FRAME_ID_SIZE,
+                            length - SERIAL_FRAME_ID_SIZE - SERIAL_FRAME_CRC_SIZE, SERIAL_FRAME_ID_SIZE);
+        uint8_t* response = (uint8_t*)rest.getBuffer();
+        response[0] = frame[0];
+
+        bRESTFrameSegments segments;
+        segments.add(response, rest.get_buffer_length());
+        bRESTFrames::write_frame(serial, segments);
+        rest.resetBuffer();
+    }
+};
+
+#endif // bREST_SERIAL_FRAMES_H
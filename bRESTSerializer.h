@@ -0,0 +1,101 @@
+/*
+  Compile-time serializer of resource state for bREST.
+
+  A resource declares the fields of its state struct once, at file scope:
+      struct PlugState {
+          bool is_switch_open;
+          int watts;
+          float voltage;
+      };
+      BREST_SERIALIZER(PlugState, is_switch_open, watts, voltage)
+  and renders the whole struct in one call from Observer::on_request():
+      serialize_state(rest, state);
+  Each field becomes one key fragment in flash, i.e. ",\"watts\":", and one direct write of its value, so keys are
+  never built at runtime and separators cannot go wrong. The struct renders in the format client asked for.
+  Fields may be bool, integers, float, double, char arrays, C strings, String or strings in flash. Up to 16 fields
+  are supported.
+*/
+#ifndef bREST_SERIALIZER_H
+#define bREST_SERIALIZER_H
+
+#include "bREST.h"
+
+/**
+ * @brief The bRESTSerializer struct renders TYPE. BREST_SERIALIZER() specializes it for each state struct.
+ */
+template <typename TYPE>
+struct bRESTSerializer;
+
+/**
+ * @brief The bRESTFieldValue struct maps field types onto the value types of bREST::put_fragment(), so that
+ *        integers of any width and floats of any precision render without ambiguity. Unsigned int and unsigned long
+ *        stay unsigned, so values above LONG_MAX do not turn negative.
+ */
+struct bRESTFieldValue {
+    static bool of(bool value) { return value; }
+    static long of(char value) { return value; }
+    static long of(signed char value) { return value; }
+    static long of(unsigned char value) { return value; }
+    static long of(short value) { return value; }
+    static long of(unsigned short value) { return value; }
+    static long of(int value) { return value; }
+    static unsigned long of(unsigned int value) { return value; }
+    static long of(long value) { return value; }
+    static unsigned long of(unsigned long value) { return value; }
+    static float of(float value) { return value; }
+    static float of(double value) { return value; }
+    static const char* of(const char* value) { return value; }
+    static const String& of(const String& value) { return value; }
+    static const __FlashStringHelper* of(const __FlashStringHelper* value) { return value; }
+};
+
+/**
+ * @brief serialize_state render state as one message, in the format client asked for
+ * @param rest bREST serving request
+ * @param state struct declared with BREST_SERIALIZER()
+ */
+template <typename TYPE>
+static inline void serialize_state(bREST* rest, const TYPE& state) {
+    rest->start_json_msg();
+    bRESTSerializer<TYPE>::write_fields(rest, state);
+    rest->end_json_msg();
+}
+
+// Expand MACRO(field) for each of up to 16 fields
+#define BREST_FOR_EACH_1(MACRO, field) MACRO(field)
+#define BREST_FOR_EACH_2(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_1(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_3(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_2(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_4(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_3(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_5(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_4(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_6(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_5(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_7(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_6(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_8(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_7(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_9(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_8(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_10(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_9(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_11(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_10(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_12(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_11(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_13(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_12(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_14(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_13(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_15(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_14(MACRO, __VA_ARGS__)
+#define BREST_FOR_EACH_16(MACRO, field, ...) MACRO(field) BREST_FOR_EACH_15(MACRO, __VA_ARGS__)
+#define BREST_COUNT_FIELDS(...) \
+    BREST_SELECT_17TH(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define BREST_SELECT_17TH(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+#define BREST_CONCAT(a, b) BREST_CONCAT_EXPANDED(a, b)
+#define BREST_CONCAT_EXPANDED(a, b) a##b
+#define BREST_FOR_EACH(MACRO, ...) BREST_CONCAT(BREST_FOR_EACH_, BREST_COUNT_FIELDS(__VA_ARGS__))(MACRO, __VA_ARGS__)
+
+#define BREST_SERIALIZE_FIELD(field) rest->put_fragment(PSTR(",\"" #field "\":"), bRESTFieldValue::of(state.field));
+
+/**
+ * Declare fields of state struct to serialize, at file scope, i.e. BREST_SERIALIZER(PlugState, is_switch_open, watts)
+ */
+#define BREST_SERIALIZER(TYPE, ...) \
+    template <> \
+    struct bRESTSerializer<TYPE> { \
+        static void write_fields(bREST* rest, const TYPE& state) { \
+            BREST_FOR_EACH(BREST_SERIALIZE_FIELD, __VA_ARGS__) \
+        } \
+    };
+
+#endif // bREST_SERIALIZER_H
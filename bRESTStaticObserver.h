@@ -0,0 +1,97 @@
+/*
+  Resources with one handler per HTTP method, dispatched without virtual calls.
+
+  A resource derives from StaticObserver<itself> and defines handlers of the methods it serves only:
+      class PowerPlug: public StaticObserver<PowerPlug> {
+      public:
+          PowerPlug(): StaticObserver<PowerPlug>(F("switch")) {}
+          void on_get(const bRESTRequest& request, bREST* rest) { ... }
+          void on_put(const bRESTRequest& request, bREST* rest) { ... }
+      };
+  The handlers it defines make a jump table by method at compile time, which the resource hands to bREST when it is
+  constructed. bREST calls the handler of request method through the table, so there is no virtual call and no
+  switch on method, and simple handlers are inlined into their entries. Methods without handler are answered
+  405 Method Not Allowed without entering resource code.
+*/
+#ifndef bREST_STATIC_OBSERVER_H
+#define bREST_STATIC_OBSERVER_H
+
+#include "bREST.h"
+
+static_assert(HTTP_METHOD_UNSET == 4, "StaticObserver has a handler for each HTTP method");
+
+/**
+ * @brief The StaticObserver class is a resource whose handlers are resolved by CRTP. DERIVED is the resource class.
+ */
+template <typename DERIVED>
+class StaticObserver: public Observer {
+public:
+    /**
+     * @brief StaticObserver constructor with resource ID in flash
+     * @param id resource ID in flash
+     */
+    StaticObserver(const __FlashStringHelper* id): Observer(id) {
+        method_handlers = HANDLERS;
+    }
+
+    StaticObserver(String id): Observer(id) {
+        method_handlers = HANDLERS;
+    }
+
+    /**
+     * @brief StaticObserver constructor for resource dispatched by a compile-time RouteTable
+     */
+    StaticObserver(): Observer() {
+        method_handlers = HANDLERS;
+    }
+
+    // Handlers DERIVED does not define. They are never called, because their methods are not allowed.
+    void on_get(const bRESTRequest& request, bREST* rest) {}
+    void on_put(const bRESTRequest& request, bREST* rest) {}
+    void on_post(const bRESTRequest& request, bREST* rest) {}
+    void on_delete(const bRESTRequest& request, bREST* rest) {}
+
+protected:
+    typedef void (DERIVED::*DerivedHandler)(const bRESTRequest& request, bREST* rest);
+    typedef void (StaticObserver::*DefaultHandler)(const bRESTRequest& request, bREST* rest);
+
+    // handlers indexed by HTTP_METHOD
+    static const ObserverMethodHandler HANDLERS[HTTP_METHOD_UNSET];
+
+    /**
+     * @brief is_defined check whether handler is defined by DERIVED, rather than inherited from StaticObserver
+     */
+    static constexpr bool is_defined(DerivedHandler) {
+        return true;
+    }
+
+    static constexpr bool is_defined(DefaultHandler) {
+        return false;
+    }
+
+    static void call_get(Observer* observer, const bRESTRequest& request, bREST* rest) {
+        static_cast<DERIVED*>(observer)->on_get(request, rest);
+    }
+
+    static void call_put(Observer* observer, const bRESTRequest& request, bREST* rest) {
+        static_cast<DERIVED*>(observer)->on_put(request, rest);
+    }
+
+    static void call_post(Observer* observer, const bRESTRequest& request, bREST* rest) {
+        static_cast<DERIVED*>(observer)->on_post(request, rest);
+    }
+
+    static void call_delete(Observer* observer, const bRESTRequest& request, bREST* rest) {
+        static_cast<DERIVED*>(observer)->on_delete(request, rest);
+    }
+};
+
+template <typename DERIVED>
+const ObserverMethodHandler StaticObserver<DERIVED>::HANDLERS[HTTP_METHOD_UNSET] = {
+    is_defined(&DERIVED::on_get)? &StaticObserver<DERIVED>::call_get: NULL,
+    is_defined(&DERIVED::on_put)? &StaticObserver<DERIVED>::call_put: NULL,
+    is_defined(&DERIVED::on_post)? &StaticObserver<DERIVED>::call_post: NULL,
+    is_defined(&DERIVED::on_delete)? &StaticObserver<DERIVED>::call_delete: NULL
+};
+
+#endif // bREST_STATIC_OBSERVER_H
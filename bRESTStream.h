@@ -0,0 +1,111 @@
+/*
+  Server-Sent Events subscribers of bREST.
+
+  GET /<resource>/?stream=1 keeps the connection open as text/event-stream. Resources call rest->notify_change(this)
+  when their state changes, and rest.flush_streams() pushes the GET representation of the resource to every
+  subscriber as one event:
+      data: {"code":200,"is_switch_open":true}
+
+  Each subscriber holds at most one event being sent and one pending change. Changes notified while an event is still
+  being sent are coalesced, so that a slow subscriber only receives the latest state.
+*/
+#ifndef bREST_STREAM_H
+#define bREST_STREAM_H
+
+#include "bRESTConfig.h"
+
+// Enable it to serve ?stream=1 as Server-Sent Events. Default is disable.
+#ifndef BREST_STREAMS
+#define BREST_STREAMS           0
+#endif
+
+// Set maximum number of stream subscribers of one bREST instance. Default is 4.
+#ifndef MAX_STREAM_SUBSCRIBERS
+#define MAX_STREAM_SUBSCRIBERS  4
+#endif
+
+// Set size of event buffer of one subscriber. Longer events are dropped. Default is 128.
+#ifndef MAX_STREAM_EVENT_SIZE
+#define MAX_STREAM_EVENT_SIZE   128
+#endif
+
+#if BREST_STREAMS
+
+#include "bRESTHeldClient.h"
+
+class Observer;
+
+/**
+ * @brief The bRESTStreamSlot class holds one subscriber: a copy of its network client, the resource it watches, and
+ *        its event buffer.
+ */
+class bRESTStreamSlot {
+public:
+    // watched resource. NULL if slot is free.
+    Observer* observer;
+    char event[MAX_STREAM_EVENT_SIZE];
+    // length of event and number of bytes sent
+    uint16_t length;
+    uint16_t sent;
+    // resource changed after event was rendered
+    bool pending;
+
+    bRESTStreamSlot() {
+        observer = NULL;
+        length = 0;
+        sent = 0;
+        pending = false;
+    }
+
+    /**
+     * @brief attach hold a copy of client for resource
+     * @param client network client
+     * @param p_resource watched resource
+     * @return true if client is held. Otherwise, false if client is too large to hold.
+     */
+    template <typename T>
+    bool attach(T& client, Observer* p_resource) {
+        if (!this->client.hold(client))
+            return false;
+        observer = p_resource;
+        length = 0;
+        sent = 0;
+        pending = false;
+        return true;
+    }
+
+    /**
+     * @brief release close connection and free slot
+     */
+    void release() {
+        client.release();
+        observer = NULL;
+    }
+
+    bool is_connected() {
+        return client.connected();
+    }
+
+    /**
+     * @brief is_idle check whether event is sent completely
+     * @return true if a new event may be rendered. Otherwise, false.
+     */
+    bool is_idle() {
+        return sent == length;
+    }
+
+    /**
+     * @brief flush send as much of event as client accepts
+     */
+    void flush() {
+        if (sent < length)
+            sent += client.write((const uint8_t*)event + sent, length - sent);
+    }
+
+protected:
+    bRESTHeldClient client;
+};
+
+#endif // BREST_STREAMS
+
+#endif // bREST_STREAM_H
@@ -0,0 +1,149 @@
+/*
+  Compile-time response templates for bREST.
+
+  Responses of a fixed shape are declared once as a constexpr PROGMEM string with typed slots:
+      constexpr char PLUG_STATE[] PROGMEM = "{\"code\":200,\"is_switch_open\":" BREST_BOOL_SLOT "}\r\n";
+  and filled in one pass:
+      BREST_TEMPLATE(PLUG_STATE)::fill(rest, isPowerPlugOpen);
+  Offsets of slots are found at compile time, so filling costs one flash copy per fixed segment and one write per
+  value, with no per-key calls. The number of values and the type of each are checked against the slots at compile
+  time. Templates are JSON text whatever format client asked for.
+*/
+#ifndef bREST_TEMPLATE_H
+#define bREST_TEMPLATE_H
+
+#include "bRESTConfig.h"
+
+// Slots of templates. They are control characters, which never appear raw in JSON text.
+#define BREST_BOOL_SLOT         "\x01"
+#define BREST_INT_SLOT          "\x02"
+#define BREST_FLOAT_SLOT        "\x03"
+#define BREST_STRING_SLOT       "\x04"
+
+typedef enum {
+    TEMPLATE_SLOT_BOOL = 1,
+    TEMPLATE_SLOT_INT,
+    TEMPLATE_SLOT_FLOAT,
+    TEMPLATE_SLOT_STRING
+} TEMPLATE_SLOT;
+
+/**
+ * @brief The bRESTTemplateSlot struct gives slot type of values, and the type they are written as. Values of other
+ *        types do not compile.
+ */
+template <typename T>
+struct bRESTTemplateSlot;
+
+template <>
+struct bRESTTemplateSlot<bool> {
+    static constexpr char type = TEMPLATE_SLOT_BOOL;
+    typedef bool value_type;
+};
+
+#define BREST_TEMPLATE_SLOT_OF(T, TYPE, VALUE_TYPE) \
+    template <> \
+    struct bRESTTemplateSlot<T> { \
+        static constexpr char type = TYPE; \
+        typedef VALUE_TYPE value_type; \
+    };
+
+BREST_TEMPLATE_SLOT_OF(signed char, TEMPLATE_SLOT_INT, long)
+BREST_TEMPLATE_SLOT_OF(unsigned char, TEMPLATE_SLOT_INT, long)
+BREST_TEMPLATE_SLOT_OF(short, TEMPLATE_SLOT_INT, long)
+BREST_TEMPLATE_SLOT_OF(unsigned short, TEMPLATE_SLOT_INT, long)
+BREST_TEMPLATE_SLOT_OF(int, TEMPLATE_SLOT_INT, long)
+BREST_TEMPLATE_SLOT_OF(unsigned int, TEMPLATE_SLOT_INT, long)
+BREST_TEMPLATE_SLOT_OF(long, TEMPLATE_SLOT_INT, long)
+BREST_TEMPLATE_SLOT_OF(unsigned long, TEMPLATE_SLOT_INT, long)
+BREST_TEMPLATE_SLOT_OF(float, TEMPLATE_SLOT_FLOAT, float)
+BREST_TEMPLATE_SLOT_OF(double, TEMPLATE_SLOT_FLOAT, float)
+BREST_TEMPLATE_SLOT_OF(char*, TEMPLATE_SLOT_STRING, const char*)
+BREST_TEMPLATE_SLOT_OF(const char*, TEMPLATE_SLOT_STRING, const char*)
+BREST_TEMPLATE_SLOT_OF(String, TEMPLATE_SLOT_STRING, const String&)
+BREST_TEMPLATE_SLOT_OF(const __FlashStringHelper*, TEMPLATE_SLOT_STRING, const __FlashStringHelper*)
+
+template <size_t N>
+struct bRESTTemplateSlot<char[N]> {
+    static constexpr char type = TEMPLATE_SLOT_STRING;
+    typedef const char* value_type;
+};
+
+/**
+ * @brief The bRESTTemplateText struct finds slots of template text at compile time.
+ * @details Text is halved on each call, so recursion depth stays logarithmic in its length.
+ */
+struct bRESTTemplateText {
+    static constexpr bool is_slot(char c) {
+        return c >= TEMPLATE_SLOT_BOOL && c <= TEMPLATE_SLOT_STRING;
+    }
+
+    /**
+     * @brief count_slots count slots in text[begin, end)
+     */
+    static constexpr size_t count_slots(const char* text, size_t begin, size_t end) {
+        return (end - begin <= 1)? ((end > begin && is_slot(text[begin]))? 1: 0):
+               count_slots(text, begin, (begin + end) / 2) + count_slots(text, (begin + end) / 2, end);
+    }
+
+    /**
+     * @brief slot_offset find offset of slot in text[begin, end). The slot must exist.
+     * @param slot index of slot, counted from begin
+     */
+    static constexpr size_t slot_offset(const char* text, size_t slot, size_t begin, size_t end) {
+        return (end - begin <= 1)? begin:
+               (slot < count_slots(text, begin, (begin + end) / 2))?
+                   slot_offset(text, slot, begin, (begin + end) / 2):
+                   slot_offset(text, slot - count_slots(text, begin, (begin + end) / 2), (begin + end) / 2, end);
+    }
+};
+
+/**
+ * @brief The bRESTTemplate struct fills a template text. Use BREST_TEMPLATE() to name it.
+ */
+template <size_t N, const char (&TEXT)[N]>
+struct bRESTTemplate {
+    // length of text without NUL terminator
+    static constexpr size_t LENGTH = N - 1;
+    static constexpr size_t SLOT_COUNT = bRESTTemplateText::count_slots(TEXT, 0, LENGTH);
+
+    /**
+     * @brief fill append template to response of rest, with values in its slots
+     * @param rest bREST serving request
+     * @param values one value for each slot, in order
+     */
+    template <typename WRITER, typename... VALUES>
+    static void fill(WRITER* rest, const VALUES&... values) {
+        static_assert(sizeof...(VALUES) == SLOT_COUNT, "Number of values must match slots of template");
+        fill_from<0>(rest, values...);
+    }
+
+protected:
+    static constexpr size_t segment_start(size_t slot) {
+        return (0 == slot)? 0: bRESTTemplateText::slot_offset(TEXT, slot - 1, 0, LENGTH) + 1;
+    }
+
+    template <size_t SLOT, typename WRITER, typename VALUE, typename... VALUES>
+    static void fill_from(WRITER* rest, const VALUE& value, const VALUES&... values) {
+        typedef bRESTTemplateSlot<VALUE> Slot;
+        static_assert(TEXT[bRESTTemplateText::slot_offset(TEXT, SLOT, 0, LENGTH)] == Slot::type,
+                      "Value does not match type of slot");
+
+        rest->append_template_text(TEXT + segment_start(SLOT),
+                                   bRESTTemplateText::slot_offset(TEXT, SLOT, 0, LENGTH) - segment_start(SLOT));
+        rest->addToBuffer((typename Slot::value_type)value, TEMPLATE_SLOT_STRING == Slot::type);
+        fill_from<SLOT + 1>(rest, values...);
+    }
+
+    template <size_t SLOT, typename WRITER>
+    static void fill_from(WRITER* rest) {
+        rest->append_template_text(TEXT + segment_start(SLOT), LENGTH - segment_start(SLOT));
+    }
+};
+
+/**
+ * Name the template of a constexpr PROGMEM string, i.e. BREST_TEMPLATE(PLUG_STATE)::fill(rest, isPowerPlugOpen);
+ */
+#define BREST_TEMPLATE(TEXT) \
+    bRESTTemplate<sizeof(TEXT), TEXT>
+
+#endif // bREST_TEMPLATE_H
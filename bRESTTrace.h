@@ -0,0 +1,164 @@
+/*
+  Structured hot-path tracing for bREST.
+
+  Trace points write fixed-size binary records into a RAM ring buffer. Nothing is formatted or sent while a request
+  is served, so tracing barely changes request timing. Dump the buffer with bRESTTrace::instance().dump(Serial) or
+  GET /_trace, and decode it on host with client/python/brest/trace.py.
+
+  When BREST_TRACE is disabled, BREST_TRACE_EVENT() compiles to nothing.
+*/
+#ifndef bREST_TRACE_H
+#define bREST_TRACE_H
+
+#include "bRESTConfig.h"
+
+// Enable it to record trace points into ring buffer. Default is disable.
+#ifndef BREST_TRACE
+#define BREST_TRACE             0
+#endif
+
+// Set number of records in trace ring buffer. Default is 64.
+#ifndef MAX_TRACE_RECORDS
+#define MAX_TRACE_RECORDS       64
+#endif
+
+// Reserved resource ID of trace dump endpoint
+#define TRACE_RESOURCE_ID       "_trace"
+
+// Size of one encoded record: timestamp (4), event (1), arg0 (2) and arg1 (2), all little endian
+#define TRACE_RECORD_SIZE       9
+
+typedef enum {
+    // parser state changed. arg0: character, arg1: new PARSER_STATE
+    TRACE_PARSER_STATE      = 1,
+    // URL parsed. arg0: URL length, arg1: number of parameters, or 0xFFFF if URL is invalid
+    TRACE_PARSE_URL         = 2,
+    // observer fired. arg0: index in observer list, or 0xFFFF for routed resource, arg1: HTTP_METHOD
+    TRACE_NOTIFY_OBSERVER   = 3,
+    // no observer matches resource ID. arg0: number of routed resources, arg1: number of observers
+    TRACE_NOTIFY_NONE       = 4,
+    // output buffer sent. arg0: number of bytes, arg1: chunk size
+    TRACE_SEND_BUFFER       = 5,
+    // first event ID free for sketch trace points
+    TRACE_USER              = 128
+} TRACE_EVENT;
+
+/**
+ * @brief The bRESTTraceRecord struct is one trace record in RAM.
+ */
+struct bRESTTraceRecord {
+    uint32_t timestamp;
+    uint16_t arg0;
+    uint16_t arg1;
+    uint8_t event;
+};
+
+/**
+ * @brief The bRESTTrace class is a ring buffer of trace records. The oldest record is overwritten when it is full.
+ */
+class bRESTTrace {
+protected:
+    bRESTTraceRecord records[MAX_TRACE_RECORDS];
+    // index of next record to write
+    uint16_t head;
+    uint16_t count;
+    // number of records overwritten before dump
+    uint32_t dropped;
+
+public:
+    bRESTTrace() {
+        clear();
+    }
+
+    /**
+     * @brief instance get the trace ring buffer shared by all bREST instances and sketch
+     * @return trace ring buffer
+     */
+    static bRESTTrace& instance() {
+        static bRESTTrace trace;
+        return trace;
+    }
+
+    /**
+     * @brief record append one record
+     * @param event event ID
+     * @param arg0 first argument
+     * @param arg1 second argument
+     */
+    void record(uint8_t event, uint16_t arg0, uint16_t arg1) {
+        bRESTTraceRecord& r = records[head];
+        r.timestamp = micros();
+        r.event = event;
+        r.arg0 = arg0;
+        r.arg1 = arg1;
+
+        head = (head + 1 == MAX_TRACE_RECORDS)? 0: head + 1;
+        if (count < MAX_TRACE_RECORDS)
+            count++;
+        else
+            dropped++;
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+        dropped = 0;
+    }
+
+    uint16_t get_count() {
+        return count;
+    }
+
+    uint32_t get_dropped() {
+        return dropped;
+    }
+
+    /**
+     * @brief encode encode record as hex of TRACE_RECORD_SIZE little endian bytes
+     * @param i record index. 0 is the oldest one.
+     * @param hex output of 2 * TRACE_RECORD_SIZE characters and NUL terminator
+     * @return hex
+     */
+    char* encode(uint16_t i, char* hex) {
+        const bRESTTraceRecord& r = records[(head + MAX_TRACE_RECORDS - count + i) % MAX_TRACE_RECORDS];
+        uint8_t bytes[TRACE_RECORD_SIZE] = {
+            (uint8_t)r.timestamp, (uint8_t)(r.timestamp >> 8), (uint8_t)(r.timestamp >> 16), (uint8_t)(r.timestamp >> 24),
+            r.event,
+            (uint8_t)r.arg0, (uint8_t)(r.arg0 >> 8),
+            (uint8_t)r.arg1, (uint8_t)(r.arg1 >> 8)
+        };
+
+        static const char HEX_DIGITS[] = "0123456789abcdef";
+        for (uint8_t b = 0; b < TRACE_RECORD_SIZE; b++) {
+            hex[2 * b] = HEX_DIGITS[bytes[b] >> 4];
+            hex[2 * b + 1] = HEX_DIGITS[bytes[b] & 0x0F];
+        }
+        hex[2 * TRACE_RECORD_SIZE] = '\0';
+        return hex;
+    }
+
+    /**
+     * @brief dump print records as one JSON line, i.e. {"count":2,"dropped":0,"trace":"<hex records>"}
+     * @details /_trace serves the same JSON. Records are kept.
+     * @param out serial port or any Print
+     */
+    void dump(Print& out) {
+        char hex[2 * TRACE_RECORD_SIZE + 1];
+        out.print(F("{\"count\":"));
+        out.print(count);
+        out.print(F(",\"dropped\":"));
+        out.print(dropped);
+        out.print(F(",\"trace\":\""));
+        for (uint16_t i = 0; i < count; i++)
+            out.print(encode(i, hex));
+        out.print(F("\"}\r\n"));
+    }
+};
+
+#if BREST_TRACE
+#define BREST_TRACE_EVENT(event, arg0, arg1)    bRESTTrace::instance().record((event), (arg0), (arg1))
+#else
+#define BREST_TRACE_EVENT(event, arg0, arg1)    ((void)0)
+#endif
+
+#endif // bREST_TRACE_H
@@ -0,0 +1,204 @@
+/*
+  Request line cache of bREST.
+
+  Automation servers send the same few request lines over and over, i.e. "PUT /switch/?open=true HTTP/1.1".
+  process() hashes the request URI while it arrives, and send_command() looks the line up before parsing. An entry
+  keeps the raw line, its decoded and split form and the resource it resolved to, by route table or observer list, so a
+  hit restores the parsed request with one copy and skips urldecode(), parse_url() and resource lookup. Every hit is verified against the whole raw line.
+  Entries are evicted least recently used first. Hits, misses and evictions are served on /_metrics.
+*/
+#ifndef bREST_URL_CACHE_H
+#define bREST_URL_CACHE_H
+
+#include "bRESTConfig.h"
+#include "bRESTRequest.h"
+
+// Enable it to cache parsed request lines. Default is disable.
+#ifndef BREST_URL_CACHE
+#define BREST_URL_CACHE         0
+#endif
+
+// Set number of cached request lines. Default is 8.
+#ifndef URL_CACHE_SIZE
+#define URL_CACHE_SIZE          8
+#endif
+
+// Set the longest request URI to cache. Longer ones are parsed each time. Default is 48.
+#ifndef URL_CACHE_LINE_LENGTH
+#define URL_CACHE_LINE_LENGTH   48
+#endif
+
+// Set the largest number of parameters of a cached request line. Default is 4.
+#ifndef URL_CACHE_MAX_PARMS
+#define URL_CACHE_MAX_PARMS     4
+#endif
+
+#if BREST_URL_CACHE
+
+static_assert(URL_CACHE_LINE_LENGTH < 0xFF, "URL_CACHE_LINE_LENGTH must be below 255");
+
+class Observer;
+
+/**
+ * @brief The bRESTUrlCacheEntry struct is one request line, raw and parsed.
+ */
+struct bRESTUrlCacheEntry {
+    uint32_t hash;
+    // use stamp of LRU. Zero if entry is empty.
+    uint32_t last_used;
+    // resource found by route table, or the only one of observer list with resource ID. Otherwise, NULL.
+    Observer* observer;
+    // index of observer in observer list, 0xFFFF if routed
+    uint16_t observer_index;
+    HTTP_METHOD method;
+    // line was percent-decoded
+    bool decoded;
+    uint8_t line_length;
+    // bytes of parsed form, including its NUL terminator
+    uint8_t parsed_length;
+    uint8_t resource_offset;
+    uint8_t parm_count;
+    uint8_t parm_offsets[URL_CACHE_MAX_PARMS];
+    uint8_t value_offsets[URL_CACHE_MAX_PARMS];
+    char line[URL_CACHE_LINE_LENGTH];
+    // URL after urldecode() and parse_url(): resource ID, parms and value are NUL terminated in place
+    char parsed[URL_CACHE_LINE_LENGTH + 1];
+};
+
+/**
+ * @brief The bRESTUrlCache class maps request lines to their parsed requests. Nothing is allocated.
+ */
+class bRESTUrlCache {
+protected:
+    bRESTUrlCacheEntry entries[URL_CACHE_SIZE];
+    uint32_t clock;
+
+public:
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+
+    bRESTUrlCache() {
+        clear();
+        hits = 0;
+        misses = 0;
+        evictions = 0;
+    }
+
+    /**
+     * @brief clear drop all entries, i.e. when routes or observers change. Counters are kept.
+     */
+    void clear() {
+        for (uint8_t i = 0; i < URL_CACHE_SIZE; i++)
+            entries[i].last_used = 0;
+        clock = 0;
+    }
+
+    static const uint32_t HASH_BASIS = 2166136261UL;
+
+    /**
+     * @brief hash_char add one character of request URI to its hash (FNV-1a)
+     * @param hash hash of preceding characters, or HASH_BASIS
+     * @param c character
+     * @return hash
+     */
+    static uint32_t hash_char(uint32_t hash, char c) {
+        return (hash ^ (uint8_t)c) * 16777619UL;
+    }
+
+    /**
+     * @brief find look up raw request line, and count a hit or a miss
+     * @param hash hash of line by hash_char()
+     * @param method method of request
+     * @param decoded line is to be percent-decoded
+     * @param line raw request URI
+     * @param length length of line
+     * @return entry if the whole line matches. Otherwise, NULL.
+     */
+    const bRESTUrlCacheEntry* find(uint32_t hash, HTTP_METHOD method, bool decoded, const char* line,
+                                   uint16_t length) {
+        for (uint8_t i = 0; i < URL_CACHE_SIZE; i++) {
+            bRESTUrlCacheEntry& entry = entries[i];
+            if (entry.last_used != 0 && entry.hash == hash && entry.method == method && entry.decoded == decoded &&
+                entry.line_length == length && 0 == memcmp(entry.line, line, length)) {
+                entry.last_used = ++clock;
+                hits++;
+                return &entry;
+            }
+        }
+        misses++;
+        return NULL;
+    }
+
+    /**
+     * @brief store cache request line parsed into request. Lines too long or with too many parameters are skipped.
+     * @param hash hash of line by hash_char()
+     * @param decoded line was percent-decoded
+     * @param line raw request URI
+     * @param length length of line
+     * @param url URL parsed in place
+     * @param parsed_length bytes of parsed URL, including its NUL terminator
+     * @param request parsed request whose strings point into url
+     * @param observer resource found by route table or observer list, or NULL
+     * @param observer_index index of observer in observer list, 0xFFFF if routed
+     */
+    void store(uint32_t hash, bool decoded, const char* line, uint16_t length, const char* url,
+               uint16_t parsed_length, const bRESTRequest& request, Observer* observer, uint16_t observer_index) {
+        if (length > URL_CACHE_LINE_LENGTH || parsed_length > URL_CACHE_LINE_LENGTH + 1 ||
+            request.parm_count > URL_CACHE_MAX_PARMS)
+            return;
+
+        bRESTUrlCacheEntry& entry = least_recently_used();
+        if (entry.last_used != 0)
+            evictions++;
+
+        entry.hash = hash;
+        entry.last_used = ++clock;
+        entry.observer = observer;
+        entry.observer_index = observer_index;
+        entry.method = request.method;
+        entry.decoded = decoded;
+        entry.line_length = length;
+        memcpy(entry.line, line, length);
+        entry.parsed_length = parsed_length;
+        memcpy(entry.parsed, url, parsed_length);
+        entry.resource_offset = request.resource_id - url;
+        entry.parm_count = request.parm_count;
+        for (uint8_t i = 0; i < entry.parm_count; i++) {
+            entry.parm_offsets[i] = request.parms[i] - url;
+            entry.value_offsets[i] = request.value[i] - url;
+        }
+    }
+
+    /**
+     * @brief restore copy parsed form of entry into URL buffer, and point request into it
+     * @param entry entry found by find()
+     * @param url URL buffer of request
+     * @param request request to fill
+     */
+    static void restore(const bRESTUrlCacheEntry& entry, char* url, bRESTRequest& request) {
+        memcpy(url, entry.parsed, entry.parsed_length);
+        request.resource_id = url + entry.resource_offset;
+        request.parm_count = entry.parm_count;
+        for (uint8_t i = 0; i < entry.parm_count; i++) {
+            request.parms[i] = url + entry.parm_offsets[i];
+            request.value[i] = url + entry.value_offsets[i];
+        }
+    }
+
+protected:
+    bRESTUrlCacheEntry& least_recently_used() {
+        uint8_t oldest = 0;
+        for (uint8_t i = 0; i < URL_CACHE_SIZE; i++) {
+            if (0 == entries[i].last_used)
+                return entries[i];
+            if (entries[i].last_used < entries[oldest].last_used)
+                oldest = i;
+        }
+        return entries[oldest];
+    }
+};
+
+#endif // BREST_URL_CACHE
+
+#endif // bREST_URL_CACHE_H
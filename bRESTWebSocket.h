@@ -0,0 +1,480 @@
+/*
+  WebSocket (RFC 6455) connections of bREST.
+
+  A GET request with Sec-WebSocket-Key header is upgraded and its connection is kept open. Every text or binary
+  message is one compact request, dispatched to resources like an HTTP request, and its response is sent back as a
+  text message:
+      PUT servo1 angle=120
+      PUT servo1 angle=120&speed=2
+      GET /servo1
+  Frames are parsed incrementally into a fixed buffer. SHA-1 and base64 of the handshake are self-contained.
+*/
+#ifndef bREST_WEBSOCKET_H
+#define bREST_WEBSOCKET_H
+
+#include "bRESTConfig.h"
+
+// Enable it to upgrade requests to WebSocket. Default is disable.
+#ifndef BREST_WEBSOCKET
+#define BREST_WEBSOCKET         0
+#endif
+
+// Set maximum number of WebSocket connections of one bREST instance. Default is 2.
+#ifndef MAX_WEBSOCKETS
+#define MAX_WEBSOCKETS          2
+#endif
+
+// Set maximum size of one message. Larger messages close connection with status 1009. Default is 128.
+#ifndef MAX_WEBSOCKET_MESSAGE_SIZE
+#define MAX_WEBSOCKET_MESSAGE_SIZE  128
+#endif
+
+#if BREST_WEBSOCKET
+
+#include "bRESTHeldClient.h"
+
+// Length of Sec-WebSocket-Key, base64 of 16 bytes
+#define WEBSOCKET_KEY_LENGTH    24
+// Length of Sec-WebSocket-Accept, base64 of SHA-1 digest
+#define WEBSOCKET_ACCEPT_LENGTH 28
+// Length of "Sec-WebSocket-Key:", and match state of header lines that are not it
+#define WEBSOCKET_KEY_HEADER_LENGTH 18
+#define WEBSOCKET_KEY_NO_MATCH  0xFF
+// Room in front of response for header of frame up to 64 KB
+#define WEBSOCKET_FRAME_HEADER_RESERVE 4
+
+#define WEBSOCKET_CLOSE_PROTOCOL_ERROR  1002
+#define WEBSOCKET_CLOSE_TOO_BIG         1009
+
+typedef enum {
+    WS_OPCODE_CONTINUATION  = 0x0,
+    WS_OPCODE_TEXT          = 0x1,
+    WS_OPCODE_BINARY        = 0x2,
+    WS_OPCODE_CLOSE         = 0x8,
+    WS_OPCODE_PING          = 0x9,
+    WS_OPCODE_PONG          = 0xA
+} WS_OPCODE;
+
+typedef enum {
+    // no complete message yet
+    WS_RECEIVE_NONE,
+    // text or binary message in get_message()
+    WS_RECEIVE_MESSAGE,
+    // control frame in get_control()
+    WS_RECEIVE_CONTROL,
+    // message exceeds MAX_WEBSOCKET_MESSAGE_SIZE
+    WS_RECEIVE_TOO_BIG,
+    // unmasked or malformed frame
+    WS_RECEIVE_PROTOCOL_ERROR
+} WS_RECEIVE;
+
+typedef enum {
+    WS_STATE_HEADER,
+    WS_STATE_LENGTH,
+    WS_STATE_EXTENDED_LENGTH,
+    WS_STATE_MASK,
+    WS_STATE_PAYLOAD
+} WS_FRAME_STATE;
+
+/**
+ * @brief The bRESTSha1 class computes SHA-1 digest incrementally with a 64-byte block buffer.
+ */
+class bRESTSha1 {
+protected:
+    uint32_t state[5];
+    uint8_t block[64];
+    uint8_t block_length;
+    uint32_t total_length;
+
+public:
+    bRESTSha1() {
+        state[0] = 0x67452301UL;
+        state[1] = 0xEFCDAB89UL;
+        state[2] = 0x98BADCFEUL;
+        state[3] = 0x10325476UL;
+        state[4] = 0xC3D2E1F0UL;
+        block_length = 0;
+        total_length = 0;
+    }
+
+    void update(uint8_t b) {
+        block[block_length++] = b;
+        total_length++;
+        if (64 == block_length) {
+            transform();
+            block_length = 0;
+        }
+    }
+
+    void update(const uint8_t* data, uint16_t length) {
+        for (uint16_t i = 0; i < length; i++)
+            update(data[i]);
+    }
+
+    /**
+     * @brief final pad message and output digest
+     * @param digest 20 bytes of digest
+     */
+    void final(uint8_t* digest) {
+        uint32_t total_bits = total_length * 8;
+        update(0x80);
+        while (block_length != 56)
+            update(0);
+        for (uint8_t i = 0; i < 4; i++)
+            update(0);
+        for (int8_t i = 3; i >= 0; i--)
+            update((uint8_t)(total_bits >> (8 * i)));
+
+        for (uint8_t i = 0; i < 20; i++)
+            digest[i] = (uint8_t)(state[i / 4] >> (24 - 8 * (i % 4)));
+    }
+
+protected:
+    static uint32_t rotate_left(uint32_t x, uint8_t n) {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    void transform() {
+        // message schedule is a ring of 16 words
+        uint32_t w[16];
+        for (uint8_t i = 0; i < 16; i++)
+            w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16)
+                   | ((uint32_t)block[4 * i + 2] << 8) | block[4 * i + 3];
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        for (uint8_t i = 0; i < 80; i++) {
+            if (i >= 16)
+                w[i & 15] = rotate_left(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999UL;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1UL;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDCUL;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6UL;
+            }
+
+            uint32_t t = rotate_left(a, 5) + f + e + k + w[i & 15];
+            e = d;
+            d = c;
+            c = rotate_left(b, 30);
+            b = a;
+            a = t;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+};
+
+/**
+ * @brief brest_base64_encode encode bytes as base64 with padding
+ * @param data bytes
+ * @param length number of bytes
+ * @param out output of 4 * ((length + 2) / 3) characters and NUL terminator
+ */
+static void brest_base64_encode(const uint8_t* data, uint8_t length, char* out) {
+    static const char DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (uint8_t i = 0; i < length; i += 3) {
+        uint32_t group = (uint32_t)data[i] << 16;
+        if (i + 1 < length)
+            group |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < length)
+            group |= data[i + 2];
+
+        *out++ = DIGITS[(group >> 18) & 0x3F];
+        *out++ = DIGITS[(group >> 12) & 0x3F];
+        *out++ = (i + 1 < length)? DIGITS[(group >> 6) & 0x3F]: '=';
+        *out++ = (i + 2 < length)? DIGITS[group & 0x3F]: '=';
+    }
+    *out = '\0';
+}
+
+/**
+ * @brief brest_websocket_accept compute Sec-WebSocket-Accept of Sec-WebSocket-Key
+ * @param key Sec-WebSocket-Key
+ * @param accept output of WEBSOCKET_ACCEPT_LENGTH characters and NUL terminator
+ */
+static void brest_websocket_accept(const char* key, char* accept) {
+    const char* guid = PSTR("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+    uint8_t digest[20];
+    bRESTSha1 sha1;
+    sha1.update((const uint8_t*)key, strlen(key));
+    for (uint8_t i = 0; i < 36; i++)
+        sha1.update(pgm_read_byte(guid + i));
+    sha1.final(digest);
+    brest_base64_encode(digest, sizeof(digest), accept);
+}
+
+/**
+ * @brief The bRESTWebSocket class is one WebSocket connection: held network client and incremental frame parser.
+ */
+class bRESTWebSocket {
+protected:
+    bRESTHeldClient client;
+
+    uint8_t frame_state;
+    uint8_t opcode;
+    bool fin;
+    uint8_t mask[4];
+    // bytes of extended length or mask read so far
+    uint8_t header_count;
+    uint8_t extended_length_size;
+    uint32_t frame_length;
+    uint32_t frame_received;
+    // frame is larger than buffer, discard payload
+    bool discard;
+
+    // message payload, and payload of control frame right after it
+    uint8_t payload[MAX_WEBSOCKET_MESSAGE_SIZE];
+    uint16_t message_length;
+    uint16_t control_length;
+    bool is_message_complete;
+
+public:
+    bRESTWebSocket() {
+        reset_parser();
+    }
+
+    /**
+     * @brief attach hold a copy of client
+     * @param client network client
+     * @return true if client is held. Otherwise, false if client is too large to hold.
+     */
+    template <typename T>
+    bool attach(T& client) {
+        if (!this->client.hold(client))
+            return false;
+        reset_parser();
+        return true;
+    }
+
+    void release() {
+        client.release();
+    }
+
+    bool is_open() {
+        return client.is_held();
+    }
+
+    bool is_connected() {
+        return client.connected();
+    }
+
+    /**
+     * @brief receive parse available bytes until a message or control frame is complete
+     * @return WS_RECEIVE
+     */
+    WS_RECEIVE receive() {
+        while (client.available() > 0) {
+            int c = client.read();
+            if (c < 0)
+                break;
+            WS_RECEIVE result = parse((uint8_t)c);
+            if (result != WS_RECEIVE_NONE)
+                return result;
+        }
+        return WS_RECEIVE_NONE;
+    }
+
+    /**
+     * @brief parse feed one byte into frame parser
+     * @param c byte
+     * @return WS_RECEIVE
+     */
+    WS_RECEIVE parse(uint8_t c) {
+        switch (frame_state) {
+        case WS_STATE_HEADER:
+            fin = (c & 0x80) != 0;
+            opcode = c & 0x0F;
+            if (is_message_complete) {
+                message_length = 0;
+                is_message_complete = false;
+            }
+            frame_state = WS_STATE_LENGTH;
+            break;
+
+        case WS_STATE_LENGTH:
+            // client frames must be masked
+            if (0 == (c & 0x80))
+                return protocol_error();
+            frame_length = c & 0x7F;
+            header_count = 0;
+            if (126 == frame_length || 127 == frame_length) {
+                extended_length_size = (126 == frame_length)? 2: 8;
+                frame_length = 0;
+                frame_state = WS_STATE_EXTENDED_LENGTH;
+            } else {
+                frame_state = WS_STATE_MASK;
+            }
+            if (opcode >= WS_OPCODE_CLOSE && frame_state != WS_STATE_MASK)
+                return protocol_error();
+            break;
+
+        case WS_STATE_EXTENDED_LENGTH:
+            // lengths beyond 32 bits are certainly too big
+            if (8 == extended_length_size && header_count < 4 && c != 0)
+                discard = true;
+            frame_length = (frame_length << 8) | c;
+            if (++header_count == extended_length_size) {
+                header_count = 0;
+                frame_state = WS_STATE_MASK;
+            }
+            break;
+
+        case WS_STATE_MASK:
+            mask[header_count++] = c;
+            if (4 == header_count) {
+                frame_received = 0;
+                // data frames are appended to message, control frames are stored after it
+                if (!discard)
+                    discard = (frame_length > (uint32_t)(MAX_WEBSOCKET_MESSAGE_SIZE - message_length));
+                if (0 == frame_length)
+                    return complete_frame();
+                frame_state = WS_STATE_PAYLOAD;
+            }
+            break;
+
+        case WS_STATE_PAYLOAD:
+            if (!discard)
+                payload[message_length + frame_received] = c ^ mask[frame_received & 3];
+            if (++frame_received == frame_length)
+                return complete_frame();
+            break;
+
+        default:
+            break;
+        }
+        return WS_RECEIVE_NONE;
+    }
+
+    uint8_t* get_message() {
+        return payload;
+    }
+
+    uint16_t get_message_length() {
+        return message_length;
+    }
+
+    // control payload is stored right after message payload, so that ping does not clobber a fragmented message
+    uint8_t* get_control() {
+        return payload + message_length;
+    }
+
+    uint16_t get_control_length() {
+        return control_length;
+    }
+
+    uint8_t get_control_opcode() {
+        return opcode;
+    }
+
+    /**
+     * @brief send_frame send one unfragmented frame
+     * @param opcode WS_OPCODE
+     * @param data payload
+     * @param length payload length. It is no more than 125 bytes.
+     */
+    void send_frame(uint8_t opcode, const uint8_t* data, uint8_t length) {
+        uint8_t frame[2 + 125];
+        frame[0] = 0x80 | opcode;
+        frame[1] = length;
+        memcpy(frame + 2, data, length);
+        client.write_all(frame, 2 + length);
+    }
+
+    /**
+     * @brief send_close send close frame with status code
+     * @param status close status, i.e. 1000 normal, 1002 protocol error, 1009 message too big
+     */
+    void send_close(uint16_t status) {
+        uint8_t code[2] = {(uint8_t)(status >> 8), (uint8_t)status};
+        send_frame(WS_OPCODE_CLOSE, code, sizeof(code));
+    }
+
+    /**
+     * @brief write_frame write frame whose header is already in front of payload
+     * @param frame frame header and payload
+     * @param length number of bytes
+     */
+    void write_frame(const uint8_t* frame, uint16_t length) {
+        client.write_all(frame, length);
+    }
+
+    /**
+     * @brief frame_header_size get size of server frame header for payload length
+     * @param length payload length
+     * @return 2 or 4 bytes
+     */
+    static uint8_t frame_header_size(uint16_t length) {
+        return (length < 126)? 2: 4;
+    }
+
+    /**
+     * @brief encode_frame_header write server frame header
+     * @param header output of frame_header_size(length) bytes
+     * @param opcode WS_OPCODE
+     * @param length payload length
+     */
+    static void encode_frame_header(uint8_t* header, uint8_t opcode, uint16_t length) {
+        header[0] = 0x80 | opcode;
+        if (length < 126) {
+            header[1] = length;
+        } else {
+            header[1] = 126;
+            header[2] = (uint8_t)(length >> 8);
+            header[3] = (uint8_t)length;
+        }
+    }
+
+protected:
+    void reset_parser() {
+        frame_state = WS_STATE_HEADER;
+        header_count = 0;
+        discard = false;
+        message_length = 0;
+        control_length = 0;
+        is_message_complete = false;
+    }
+
+    WS_RECEIVE protocol_error() {
+        reset_parser();
+        return WS_RECEIVE_PROTOCOL_ERROR;
+    }
+
+    WS_RECEIVE complete_frame() {
+        frame_state = WS_STATE_HEADER;
+        header_count = 0;
+
+        if (discard) {
+            discard = false;
+            message_length = 0;
+            return WS_RECEIVE_TOO_BIG;
+        }
+
+        if (opcode >= WS_OPCODE_CLOSE) {
+            control_length = frame_length;
+            return WS_RECEIVE_CONTROL;
+        }
+
+        message_length += frame_length;
+        if (!fin)
+            return WS_RECEIVE_NONE;
+        is_message_complete = true;
+        return WS_RECEIVE_MESSAGE;
+    }
+};
+
+#endif // BREST_WEBSOCKET
+
+#endif // bREST_WEBSOCKET_H
@@ -0,0 +1,66 @@
+/*
+  Optional adapter exposing aREST pin, variable and function commands as a bREST resource.
+
+  Only sketches that include this header pay for aREST. For example, with the adapter registered as "arest":
+      GET /arest/?cmd=digital/13       read digital pin 13
+      PUT /arest/?cmd=digital/13/1     write HIGH to digital pin 13
+      PUT /arest/?cmd=mode/13/o        set pin 13 to output
+      GET /arest/?cmd=temperature      read aREST variable "temperature"
+*/
+#ifndef bREST_AREST_ADAPTER_H
+#define bREST_AREST_ADAPTER_H
+
+#include "bREST.h"
+#include "aREST.h"
+
+// Set maximum length of aREST command passed in "cmd" parameter. Default is 48.
+#ifndef MAX_AREST_COMMAND_LENGTH
+#define MAX_AREST_COMMAND_LENGTH    48
+#endif
+
+/**
+ * @brief The aRESTObserver class runs aREST command of "cmd" parameter and returns its JSON answer.
+ * @details It is an aREST as well, so variable(), function(), set_id() and set_name() work as in aREST.
+ * @tparam OUTPUT_SIZE size of aREST output buffer
+ */
+template<uint16_t OUTPUT_SIZE = OUTPUT_BUFFER_SIZE>
+class aRESTObserver: public Observer, public aREST {
+protected:
+    char output_buffer_storage[OUTPUT_SIZE];
+
+public:
+    aRESTObserver(String resource_id): Observer(resource_id), aREST(output_buffer_storage, OUTPUT_SIZE) {
+        resetBuffer();
+    }
+
+    aRESTObserver(const __FlashStringHelper* resource_id): Observer(resource_id), aREST(output_buffer_storage, OUTPUT_SIZE) {
+        resetBuffer();
+    }
+
+    virtual ~aRESTObserver() {}
+
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
+        int cmd_index = find_parm(parms, parm_count, "cmd");
+        if (-1 == cmd_index || strlen(value[cmd_index]) + 3 > MAX_AREST_COMMAND_LENGTH) {
+            rest->record_error(CODE_ERROR_INVALID_COMMAND);
+            rest->start_json_msg();
+            rest->append_key_value_pair_to_json(F("message"), F("Invalid aREST command!"));
+            rest->append_comma_to_json();
+            rest->append_key_value_pair_to_json(F("code"), CODE_ERROR_INVALID_COMMAND);
+            rest->end_json_msg();
+            return;
+        }
+
+        // aREST processes a command token by token at each '/', so terminate it like aREST MQTT message does.
+        char command[MAX_AREST_COMMAND_LENGTH + 1];
+        command[0] = '/';
+        strcpy(command + 1, value[cmd_index]);
+        strcat(command, " /");
+
+        aREST::handle(command);
+        rest->append_raw_to_json(aREST::getBuffer());
+        aREST::resetBuffer();
+    }
+};
+
+#endif // bREST_AREST_ADAPTER_H
@@ -0,0 +1,102 @@
+from __future__ import absolute_import, division, print_function, unicode_literals
+
+import json
+import struct
+import sys
+
+from brest.request import Request
+
+if 2 == sys.version_info[0]:
+    text = unicode
+else:
+    text = str
+
+
+class Trace(object):
+    """
+    Decoder of bREST trace ring buffer dumped by bRESTTrace::dump() or GET /_trace
+    """
+    # timestamp (4), event (1), arg0 (2) and arg1 (2), all little endian. Keep it in sync with bRESTTrace.h
+    RECORD_FORMAT = '<IBHH'
+    RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+
+    TRACE_RESOURCE_ID = '_trace'
+
+    EVENT_NAMES = {
+        1: 'PARSER_STATE',
+        2: 'PARSE_URL',
+        3: 'NOTIFY_OBSERVER',
+        4: 'NOTIFY_NONE',
+        5: 'SEND_BUFFER',
+    }
+
+    # PARSER_STATE enum in bREST.h
+    PARSER_STATE_NAMES = (
+        'STATE_START', 'STATE_IGNORE', 'STATE_IGNORE_URI', 'STATE_ACCEPT_URI', 'STATE_OVERFLOW_URI',
+        'STATE_ACCEPT_BODY', 'STATE_OVERFLOW_BODY', 'STATE_IN_GET_METHOD_G', 'STATE_IN_GET_METHOD_E',
+        'STATE_IN_GET_METHOD_T', 'STATE_IN_PUT_METHOD_P', 'STATE_IN_PUT_METHOD_U', 'STATE_IN_PUT_METHOD_T',
+        'STATE_IN_FIRST_SPACE', 'STATE_IN_URI', 'STATE_IN_FIRST_CR', 'STATE_IN_SECOND_CR', 'STATE_IN_FIRST_LF',
+        'STATE_IN_SECOND_LF', 'STATE_IN_BODY')
+
+    @staticmethod
+    def decode(dump):
+        """
+        Decode trace dump
+        Args:
+            dump: JSON line of trace dump
+
+        Returns: a list of (timestamp, event, arg0, arg1) tuple from the oldest record
+
+        """
+        hex_records = json.loads(dump).get('trace', '')
+        raw = bytearray.fromhex(hex_records)
+        return [struct.unpack_from(Trace.RECORD_FORMAT, bytes(raw), offset)
+                for offset in range(0, len(raw) - Trace.RECORD_SIZE + 1, Trace.RECORD_SIZE)]
+
+    @staticmethod
+    def format_record(record, start_timestamp):
+        """
+        Format one trace record
+        Args:
+            record: (timestamp, event, arg0, arg1) tuple
+            start_timestamp: timestamp of the first record
+
+        Returns: a line of text
+
+        """
+        timestamp, event, arg0, arg1 = record
+        # micros() wraps around at 2^32
+        elapsed = (timestamp - start_timestamp) & 0xFFFFFFFF
+        name = Trace.EVENT_NAMES.get(event, 'USER_' + text(event))
+        if 1 == event:
+            state = Trace.PARSER_STATE_NAMES[arg1] if arg1 < len(Trace.PARSER_STATE_NAMES) else text(arg1)
+            args = '%r -> %s' % (chr(arg0), state)
+        else:
+            args = 'arg0=%d arg1=%d' % (arg0, arg1)
+        return '%10d us  %-16s %s' % (elapsed, name, args)
+
+    @staticmethod
+    def fetch(conf, clear=False):
+        """
+        Fetch trace dump from bREST server
+        Args:
+            conf: Config object
+            clear: clear trace ring buffer after dump
+
+        Returns: JSON line of trace dump
+
+        """
+        parms = {'clear': '1'} if clear else dict()
+        response_text, response_code = Request(conf).send(text(Trace.TRACE_RESOURCE_ID), parms)
+        return response_text
+
+
+if __name__ == '__main__':
+    # decode trace dump from serial capture or /_trace response, i.e. python -m brest.trace < dump.json
+    for line in sys.stdin:
+        line = line.strip()
+        if not line.startswith('{'):
+            continue
+        records = Trace.decode(line)
+        for r in records:
+            print(Trace.format_record(r, records[0][0]))
@@ -21,7 +21,7 @@
 #include <bREST.h>
 
 // Create bREST instance
-bREST rest = bREST();
+bRESTInstance<> rest;
 
 // WiFi parameters
 const char* ssid = "your_ssid";
@@ -38,13 +38,13 @@ IPAddress dns(192, 168, 2, 1);
 WiFiServer server(LISTEN_PORT);
 
 // Step1: Define customized resource by inheriting Observer
-//        Override call back method update()
+//        Override call back method on_request()
 class CalculatorResource: public Observer {
 public:
-    CalculatorResource(String resource_id): Observer(resource_id) {}
+    CalculatorResource(const __FlashStringHelper* resource_id): Observer(resource_id) {}
     virtual ~CalculatorResource(){}
     // override call back function
-    void update(HTTP_METHOD method, String parms[], String value[], int parm_count, bREST* rest) override {
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
         log("*************************************\n");
         log("Fire update() by a HTTP Request!\n");
         log("HTTP Method: %s\n", bREST::get_method(method).c_str());
@@ -52,23 +52,24 @@ public:
         float sum = 0;
          // Iterate parameter array and value array
         for (int i = 0; i < parm_count; i++) {
-            log("%s = %s\n", parms[i].c_str(), value[i].c_str());
-            sum += value[i].toFloat();
+            log("%s = %s\n", parms[i], value[i]);
+            sum += atof(value[i]);
         }
         log("*************************************\n");
         // Send back JSON message to client.
         rest->start_json_msg();
-        rest->append_key_value_pair_to_json(String("message"), String("CalculatorResource get fire up!"));
+        rest->append_key_value_pair_to_json(F("message"), F("CalculatorResource get fire up!"));
         rest->append_comma_to_json();
-        rest->append_key_value_pair_to_json(String("code"), CODE_OK);
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
         rest->append_comma_to_json();
-        rest->append_key_value_pair_to_json(String("sum"), sum);
+        rest->append_key_value_pair_to_json(F("sum"), sum);
         rest->end_json_msg();
     }
 };
 
 // Step 2: Allocate resource with unique ID
-CalculatorResource myESP8266Calculator("calc");
+const char CALC_ID[] PROGMEM = "calc";
+CalculatorResource myESP8266Calculator(FPSTR(CALC_ID));
 
 void setup(void)
 {
@@ -53,12 +53,33 @@ def get_swtich_status():
     return msg
 
 
+def watch_swtich_status():
+    url = "http://%s:%d/%s/?stream=1" % (SERVER_IP, SERVER_PORT, RESOURCE)
+    print("Start to watch URL: " + url + ". Press Ctrl-C to stop.")
+    conn = CT.HTTPConnection(SERVER_IP + ':' + text(SERVER_PORT))
+    conn.request("GET", url)
+    response = conn.getresponse()
+    print("Response code: " + str(response.status))
+    try:
+        while True:
+            line = response.fp.readline().decode('utf-8')
+            if not line:
+                break
+            if line.startswith('data:'):
+                print("Event: " + line[len('data:'):].strip())
+    except KeyboardInterrupt:
+        pass
+    conn.close()
+
+
 while True:
     get_swtich_status()
-    command = input('Turn on (Y/N/Q)?\n')
+    command = input('Turn on (Y/N), watch (W) or quit (Q)?\n')
     if command.upper() == 'Y':
         change_swtich(False)
     elif command.upper() == 'N':
         change_swtich(True)
+    elif command.upper() == 'W':
+        watch_swtich_status()
     else:
         break
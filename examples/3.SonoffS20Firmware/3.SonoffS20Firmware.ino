@@ -27,8 +27,11 @@ extern "C"
 
 #define DEBUG 1
 #define APP_DEBUG 1
+// push switch state to subscribers of GET /switch/?stream=1
+#define BREST_STREAMS 1
 
 #include <bREST.h>
+#include <bRESTStaticObserver.h>
 
 /** NOTE: this is where you should place your wifi ssid and password. Create wifi_settings.h header file with the sample below:
 
@@ -59,7 +62,7 @@ const uint32_t TIMER_CYCLE_IN_MS = 10;
 const long BUTTON_DEBOUNCE = 200;
 
 // Create bREST instance
-bREST rest = bREST();
+bRESTInstance<> rest;
 
 // WiFi parameters
 IPAddress ip(192, 168, 2, 44);
@@ -73,11 +76,11 @@ const int LISTEN_PORT = 80;
 // Create an instance of the server
 WiFiServer server(LISTEN_PORT);
 
-// Step1: Define customized resource by inheriting Observer
-//        Override call back method update()
-class PowerPlug: public Observer {
+// Step1: Define customized resource by inheriting StaticObserver
+//        Define handlers of the HTTP methods it serves. Other methods are answered 405.
+class PowerPlug: public StaticObserver<PowerPlug> {
 public:
-    PowerPlug(String resource_id): Observer(resource_id) {
+    PowerPlug(const __FlashStringHelper* resource_id): StaticObserver<PowerPlug>(resource_id) {
         this->isPowerPlugOpen = true;
         this->enablePin = ENABLE_PIN;
         this->greenLEDPin = GREEN_LED_PIN;
@@ -90,52 +93,47 @@ public:
 
     virtual ~PowerPlug(){}
 
-    // override call back function
-    void update(HTTP_METHOD method, String parms[], String value[], int parm_count, bREST* rest) override {
-        switch(method) {
-        case HTTP_METHOD_GET:
-            // Send back JSON message to client.
-            rest->start_json_msg();
-            rest->append_key_value_pair_to_json(String("message"), String("PowerPlug get fire up!"));
-            rest->append_comma_to_json();
-            rest->append_key_value_pair_to_json(String("code"), CODE_OK);
-            rest->append_comma_to_json();
-            rest->append_key_value_pair_to_json(String("is_switch_open"), isSwitchOpen());
-            rest->end_json_msg();
-            break;
-        case HTTP_METHOD_PUT:
-            if(1 == parm_count && parms[0] == "open") {
-                if(value[0] == "true") {
-                    openSwitch();
-                    sendBackAffirmativeMessage(rest);
-                }else if(value[0] == "false") {
-                    closeSwitch();
-                    sendBackAffirmativeMessage(rest);
-                }else{
-                    sendBackInvalidCommandMessage(rest);
-                }
-            }else{
-                sendBackInvalidCommandMessage(rest);
-            }
-            break;
+    // handler of GET
+    void on_get(const bRESTRequest& request, bREST* rest) {
+        // Send back JSON message to client.
+        rest->start_json_msg();
+        rest->append_key_value_pair_to_json(F("message"), F("PowerPlug get fire up!"));
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("is_switch_open"), isSwitchOpen());
+        rest->end_json_msg();
+    }
+
+    // handler of PUT. Parameters point into the request, so no String is allocated.
+    void on_put(const bRESTRequest& request, bREST* rest) {
+        const char* open = (1 == request.parm_count)? request.get(F("open")): NULL;
+        if(open != NULL && 0 == strcmp(open, "true")) {
+            openSwitch();
+            sendBackAffirmativeMessage(rest);
+        }else if(open != NULL && 0 == strcmp(open, "false")) {
+            closeSwitch();
+            sendBackAffirmativeMessage(rest);
+        }else{
+            sendBackInvalidCommandMessage(rest);
         }
     }
 
     void sendBackInvalidCommandMessage(bREST* rest) {
         // Send back JSON message to client.
         rest->start_json_msg();
-        rest->append_key_value_pair_to_json(String("message"), String("Invalid command!"));
+        rest->append_key_value_pair_to_json(F("message"), F("Invalid command!"));
         rest->append_comma_to_json();
-        rest->append_key_value_pair_to_json(String("code"), CODE_ERROR_INVALID_COMMAND);
+        rest->append_key_value_pair_to_json(F("code"), CODE_ERROR_INVALID_COMMAND);
         rest->end_json_msg();
     }
 
     void sendBackAffirmativeMessage(bREST* rest) {
         // Send back JSON message to client.
         rest->start_json_msg();
-        rest->append_key_value_pair_to_json(String("message"), String("Affirmative!"));
+        rest->append_key_value_pair_to_json(F("message"), F("Affirmative!"));
         rest->append_comma_to_json();
-        rest->append_key_value_pair_to_json(String("code"), CODE_OK);
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
         rest->end_json_msg();
     }
 
@@ -150,12 +148,15 @@ public:
         digitalWrite(enablePin, 0);
         digitalWrite(greenLEDPin, 0);
         isPowerPlugOpen = true;
+        // push new state to subscribers of GET /switch/?stream=1
+        rest.notify_change(this);
     }
 
     void closeSwitch() {
         digitalWrite(enablePin, 1);
         digitalWrite(greenLEDPin, 1);
         isPowerPlugOpen = false;
+        rest.notify_change(this);
     }
 
     bool checkButton() {
@@ -199,7 +200,8 @@ protected:
 };
 
 // Step 2: Allocate resource with unique ID
-PowerPlug powerPlug("switch");
+const char SWITCH_ID[] PROGMEM = "switch";
+PowerPlug powerPlug(FPSTR(SWITCH_ID));
 
 // Timer-controlled read in of digital input
 void timerCallback(void *pArg) {
@@ -240,6 +242,9 @@ void setup(void)
 
 void loop() {
 
+  // Push state changes to stream subscribers and serve WebSocket messages
+  rest.loop();
+
   // Handle REST calls
   WiFiClient client = server.available();
   if (!client) {
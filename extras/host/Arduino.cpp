@@ -0,0 +1,193 @@
+/*
+  Arduino compatibility layer for building bREST on a Linux host.
+*/
+#include "Arduino.h"
+
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+HardwareSerial Serial;
+
+static uint8_t pin_modes[NUM_HOST_PINS];
+static int pin_values[NUM_HOST_PINS];
+
+static uint64_t monotonic_micros() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+// program start as Arduino boot time
+static const uint64_t boot_micros = monotonic_micros();
+
+unsigned long millis() {
+    return (unsigned long)((monotonic_micros() - boot_micros) / 1000ULL);
+}
+
+unsigned long micros() {
+    // wrap around at 2^32 as on boards
+    return (unsigned long)(uint32_t)(monotonic_micros() - boot_micros);
+}
+
+void delay(unsigned long ms) {
+    struct timespec duration;
+    duration.tv_sec = ms / 1000;
+    duration.tv_nsec = (ms % 1000) * 1000000L;
+    while (-1 == nanosleep(&duration, &duration) && EINTR == errno)
+        ;
+}
+
+void delayMicroseconds(unsigned int us) {
+    struct timespec duration;
+    duration.tv_sec = us / 1000000;
+    duration.tv_nsec = (us % 1000000) * 1000L;
+    while (-1 == nanosleep(&duration, &duration) && EINTR == errno)
+        ;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin < NUM_HOST_PINS)
+        pin_modes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin < NUM_HOST_PINS)
+        pin_values[pin] = (value != LOW)? HIGH: LOW;
+}
+
+int digitalRead(uint8_t pin) {
+    return (pin < NUM_HOST_PINS)? pin_values[pin]: LOW;
+}
+
+int analogRead(uint8_t pin) {
+    return (pin < NUM_HOST_PINS)? pin_values[pin]: 0;
+}
+
+void analogWrite(uint8_t pin, int value) {
+    if (pin < NUM_HOST_PINS)
+        pin_values[pin] = value;
+}
+
+long random(long max) {
+    return (max <= 0)? 0: ::random() % max;
+}
+
+long random(long min, long max) {
+    return (max <= min)? min: min + random(max - min);
+}
+
+void randomSeed(unsigned long seed) {
+    srandom(seed);
+}
+
+char* ltoa(long value, char* buffer, int radix) {
+    if (10 == radix) {
+        sprintf(buffer, "%ld", value);
+        return buffer;
+    }
+    if (value < 0) {
+        buffer[0] = '-';
+        ultoa(-(unsigned long)value, buffer + 1, radix);
+        return buffer;
+    }
+    return ultoa((unsigned long)value, buffer, radix);
+}
+
+char* ultoa(unsigned long value, char* buffer, int radix) {
+    static const char DIGITS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    char reversed[8 * sizeof(unsigned long) + 1];
+    int length = 0;
+    if (radix < 2 || radix > 36)
+        radix = 10;
+
+    do {
+        reversed[length++] = DIGITS[value % radix];
+        value /= radix;
+    } while (value != 0);
+
+    for (int i = 0; i < length; i++)
+        buffer[i] = reversed[length - 1 - i];
+    buffer[length] = '\0';
+    return buffer;
+}
+
+char* dtostrf(double value, signed char width, unsigned char precision, char* buffer) {
+    sprintf(buffer, "%*.*f", width, precision, value);
+    return buffer;
+}
+
+String::String(int value, unsigned char base) {
+    char buffer[8 * sizeof(long) + 2];
+    s = ltoa(value, buffer, base);
+}
+
+String::String(unsigned int value, unsigned char base) {
+    char buffer[8 * sizeof(long) + 2];
+    s = ultoa(value, buffer, base);
+}
+
+String::String(long value, unsigned char base) {
+    char buffer[8 * sizeof(long) + 2];
+    s = ltoa(value, buffer, base);
+}
+
+String::String(unsigned long value, unsigned char base) {
+    char buffer[8 * sizeof(long) + 2];
+    s = ultoa(value, buffer, base);
+}
+
+String::String(float value, unsigned char decimal_places) {
+    char buffer[64];
+    s = dtostrf(value, 1, decimal_places, buffer);
+}
+
+String::String(double value, unsigned char decimal_places) {
+    char buffer[64];
+    s = dtostrf(value, 1, decimal_places, buffer);
+}
+
+void String::trim() {
+    size_t first = s.find_first_not_of(" \t\r\n");
+    if (std::string::npos == first) {
+        s.clear();
+        return;
+    }
+    size_t last = s.find_last_not_of(" \t\r\n");
+    s = s.substr(first, last - first + 1);
+}
+
+void String::toLowerCase() {
+    for (size_t i = 0; i < s.size(); i++)
+        s[i] = tolower(s[i]);
+}
+
+void String::toUpperCase() {
+    for (size_t i = 0; i < s.size(); i++)
+        s[i] = toupper(s[i]);
+}
+
+size_t Print::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    return fwrite(buffer, 1, size, stdout);
+}
+
+int HardwareSerial::available() {
+    int count = 0;
+    if (-1 == ioctl(STDIN_FILENO, FIONREAD, &count))
+        return 0;
+    return count;
+}
+
+int HardwareSerial::read() {
+    unsigned char c;
+    return (1 == ::read(STDIN_FILENO, &c, 1))? c: -1;
+}
+
+void HardwareSerial::flush() {
+    fflush(stdout);
+}
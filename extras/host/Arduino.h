@@ -0,0 +1,340 @@
+/*
+  Arduino compatibility layer for building bREST on a Linux host.
+
+  It provides the subset of Arduino core used by bREST and sketch-level Observers: String, Print, Stream,
+  HardwareSerial, Serial, time functions, pin stubs and PROGMEM helpers. Flash strings are plain RAM strings.
+*/
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <ctype.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH                    1
+#define LOW                     0
+
+#define INPUT                   0
+#define OUTPUT                  1
+#define INPUT_PULLUP            2
+
+// Number of emulated digital and analog pins
+#define NUM_HOST_PINS           64
+
+// Flash strings live in RAM on host
+class __FlashStringHelper;
+#define F(string_literal)       (reinterpret_cast<const __FlashStringHelper*>(string_literal))
+#define PSTR(string_literal)    (string_literal)
+#define PROGMEM
+#define PGM_P                   const char*
+
+#define pgm_read_byte(addr)     (*(const uint8_t*)(addr))
+#define pgm_read_word(addr)     (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr)    (*(const uint32_t*)(addr))
+#define pgm_read_ptr(addr)      (*(void* const*)(addr))
+
+#define strlen_P                strlen
+#define strcmp_P                strcmp
+#define strncmp_P               strncmp
+#define strcasecmp_P            strcasecmp
+#define strncasecmp_P           strncasecmp
+#define strcpy_P                strcpy
+#define memcpy_P                memcpy
+
+// Time since program starts
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Pins keep the last written value. Nothing is connected.
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+// Non standard conversions of avr-libc
+char* ltoa(long value, char* buffer, int radix);
+char* ultoa(unsigned long value, char* buffer, int radix);
+char* dtostrf(double value, signed char width, unsigned char precision, char* buffer);
+
+/**
+ * @brief The String class is Arduino String backed by std::string.
+ */
+class String {
+protected:
+    std::string s;
+
+public:
+    String() {}
+    String(const char* c): s(c != NULL? c: "") {}
+    String(const std::string& other): s(other) {}
+    String(const __FlashStringHelper* f): s(reinterpret_cast<const char*>(f)) {}
+    explicit String(char c): s(1, c) {}
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned char decimal_places = 2);
+    explicit String(double value, unsigned char decimal_places = 2);
+
+    unsigned int length() const {
+        return s.size();
+    }
+
+    const char* c_str() const {
+        return s.c_str();
+    }
+
+    bool reserve(unsigned int size) {
+        s.reserve(size);
+        return true;
+    }
+
+    String& operator+=(const String& other) {
+        s += other.s;
+        return *this;
+    }
+
+    String& operator+=(const char* other) {
+        s += other;
+        return *this;
+    }
+
+    String& operator+=(char c) {
+        s += c;
+        return *this;
+    }
+
+    bool concat(const String& other) {
+        s += other.s;
+        return true;
+    }
+
+    friend String operator+(const String& a, const String& b) {
+        return String(a.s + b.s);
+    }
+
+    friend String operator+(const String& a, const char* b) {
+        return String(a.s + b);
+    }
+
+    friend String operator+(const char* a, const String& b) {
+        return String(a + b.s);
+    }
+
+    bool operator==(const String& other) const {
+        return s == other.s;
+    }
+
+    bool operator==(const char* other) const {
+        return s == other;
+    }
+
+    bool operator!=(const String& other) const {
+        return s != other.s;
+    }
+
+    bool operator!=(const char* other) const {
+        return s != other;
+    }
+
+    char operator[](unsigned int i) const {
+        return (i < s.size())? s[i]: 0;
+    }
+
+    char& operator[](unsigned int i) {
+        return s[i];
+    }
+
+    char charAt(unsigned int i) const {
+        return (*this)[i];
+    }
+
+    bool equals(const String& other) const {
+        return s == other.s;
+    }
+
+    bool equalsIgnoreCase(const String& other) const {
+        return 0 == strcasecmp(s.c_str(), other.s.c_str());
+    }
+
+    bool startsWith(const String& prefix) const {
+        return 0 == s.compare(0, prefix.s.size(), prefix.s);
+    }
+
+    bool endsWith(const String& suffix) const {
+        return s.size() >= suffix.s.size() && 0 == s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s);
+    }
+
+    int indexOf(char c, unsigned int from = 0) const {
+        size_t i = s.find(c, from);
+        return (std::string::npos == i)? -1: (int)i;
+    }
+
+    int indexOf(const String& other, unsigned int from = 0) const {
+        size_t i = s.find(other.s, from);
+        return (std::string::npos == i)? -1: (int)i;
+    }
+
+    int lastIndexOf(char c) const {
+        size_t i = s.rfind(c);
+        return (std::string::npos == i)? -1: (int)i;
+    }
+
+    String substring(unsigned int from) const {
+        return (from > s.size())? String(): String(s.substr(from));
+    }
+
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) {
+            unsigned int t = from;
+            from = to;
+            to = t;
+        }
+        return (from > s.size())? String(): String(s.substr(from, to - from));
+    }
+
+    void remove(unsigned int index) {
+        if (index < s.size())
+            s.erase(index);
+    }
+
+    void remove(unsigned int index, unsigned int count) {
+        if (index < s.size())
+            s.erase(index, count);
+    }
+
+    void trim();
+    void toLowerCase();
+    void toUpperCase();
+
+    long toInt() const {
+        return atol(s.c_str());
+    }
+
+    float toFloat() const {
+        return atof(s.c_str());
+    }
+
+    void toCharArray(char* buffer, unsigned int size) const {
+        if (0 == size)
+            return;
+        strncpy(buffer, s.c_str(), size - 1);
+        buffer[size - 1] = '\0';
+    }
+};
+
+/**
+ * @brief The Print class writes bytes and formatted values. Default sink is stdout.
+ */
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t* buffer, size_t size);
+
+    size_t write(const char* s) {
+        return write(reinterpret_cast<const uint8_t*>(s), strlen(s));
+    }
+
+    size_t print(const char* s) {
+        return write(s);
+    }
+
+    size_t print(const String& s) {
+        return write(s.c_str());
+    }
+
+    size_t print(const __FlashStringHelper* s) {
+        return write(reinterpret_cast<const char*>(s));
+    }
+
+    size_t print(char c) {
+        return write((uint8_t)c);
+    }
+
+    size_t print(int value, int base = 10) {
+        return print(String(value, base));
+    }
+
+    size_t print(unsigned int value, int base = 10) {
+        return print(String(value, base));
+    }
+
+    size_t print(long value, int base = 10) {
+        return print(String(value, base));
+    }
+
+    size_t print(unsigned long value, int base = 10) {
+        return print(String(value, base));
+    }
+
+    size_t print(double value, int decimal_places = 2) {
+        return print(String(value, decimal_places));
+    }
+
+    size_t println() {
+        return write("\r\n");
+    }
+
+    template<typename T>
+    size_t println(T value) {
+        size_t n = print(value);
+        return n + println();
+    }
+
+    template<typename T>
+    size_t println(T value, int format) {
+        size_t n = print(value, format);
+        return n + println();
+    }
+
+    virtual void flush() {}
+};
+
+class Stream: public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() {
+        return -1;
+    }
+};
+
+/**
+ * @brief The HardwareSerial class maps Serial to stdin and stdout.
+ */
+class HardwareSerial: public Stream {
+public:
+    void begin(unsigned long baud) {}
+    void end() {}
+
+    int available() override;
+    int read() override;
+    void flush() override;
+
+    operator bool() {
+        return true;
+    }
+};
+
+extern HardwareSerial Serial;
+
+#endif // Arduino_h
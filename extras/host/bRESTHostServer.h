@@ -0,0 +1,368 @@
+/*
+  epoll-driven TCP server adapter that serves bREST on a Linux host.
+
+  Each connection reads into its own fixed buffer until the end of HTTP headers, then the request is handed to
+  bREST::handle() through bRESTHostClient. bREST replies with "Connection: close", so the connection is closed after
+  the response is written, unless bREST holds it for Server-Sent Events or WebSocket. Held connections stay watched by
+  epoll, so that loop() wakes up to serve their messages.
+*/
+#ifndef bREST_HOST_SERVER_H
+#define bREST_HOST_SERVER_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <linux/sockios.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bREST.h"
+
+// Set maximum number of concurrent connections. Default is 64.
+#ifndef MAX_HOST_CONNECTIONS
+#define MAX_HOST_CONNECTIONS    64
+#endif
+
+// Set size of receive buffer of one connection. Default is 1024.
+#ifndef MAX_HOST_REQUEST_SIZE
+#define MAX_HOST_REQUEST_SIZE   1024
+#endif
+
+// Set listen backlog. Default is 128.
+#ifndef HOST_LISTEN_BACKLOG
+#define HOST_LISTEN_BACKLOG     128
+#endif
+
+/**
+ * @brief The bRESTHostClient class is a received request and its socket, in the shape of Arduino network client.
+ */
+class bRESTHostClient {
+protected:
+    int fd;
+    const char* request;
+    size_t length;
+    size_t position;
+
+public:
+    bRESTHostClient(int fd, const char* request, size_t length) {
+        this->fd = fd;
+        this->request = request;
+        this->length = length;
+        this->position = 0;
+    }
+
+    /**
+     * @brief available get number of bytes left of received request, then number of bytes readable from socket
+     * @return number of bytes
+     */
+    int available() {
+        if (position < length)
+            return length - position;
+        int readable = 0;
+        if (-1 == fd || ioctl(fd, FIONREAD, &readable) != 0)
+            return 0;
+        return readable;
+    }
+
+    int read() {
+        if (position < length)
+            return (unsigned char)request[position++];
+        unsigned char c;
+        return (-1 != fd && 1 == recv(fd, &c, 1, MSG_DONTWAIT))? c: -1;
+    }
+
+    /**
+     * @brief write send all bytes. It waits for socket buffer if it is full.
+     * @param buffer bytes
+     * @param size number of bytes
+     * @return number of bytes sent
+     */
+    size_t write(const uint8_t* buffer, size_t size) {
+        size_t sent = 0;
+        while (sent < size) {
+            ssize_t n = send(fd, buffer + sent, size - sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += n;
+            } else if (-1 == n && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+                struct pollfd p = {fd, POLLOUT, 0};
+                if (poll(&p, 1, 1000) <= 0)
+                    break;
+            } else if (!(-1 == n && EINTR == errno)) {
+                break;
+            }
+        }
+        return sent;
+    }
+
+    /**
+     * @brief availableForWrite get number of bytes that may be written without waiting for peer
+     * @return number of bytes
+     */
+    int availableForWrite() {
+        int send_buffer_size = 0;
+        socklen_t option_length = sizeof(send_buffer_size);
+        int queued = 0;
+        if (-1 == fd || getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &send_buffer_size, &option_length) != 0
+                || ioctl(fd, SIOCOUTQ, &queued) != 0)
+            return 0;
+        // kernel reports twice the usable size
+        int writable = send_buffer_size / 2 - queued;
+        return (writable > 0)? writable: 0;
+    }
+
+    /**
+     * @brief connected check whether peer has not closed connection
+     * @return 1 if connected. Otherwise, 0.
+     */
+    uint8_t connected() {
+        if (-1 == fd)
+            return 0;
+        char c;
+        ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        return (n > 0 || (-1 == n && (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno)))? 1: 0;
+    }
+
+    /**
+     * @brief is_open check whether socket is not closed by stop()
+     * @return true if open. Otherwise, false.
+     */
+    bool is_open() {
+        return fd != -1;
+    }
+
+    void stop() {
+        if (fd != -1) {
+            close(fd);
+            fd = -1;
+        }
+    }
+};
+
+/**
+ * @brief The bRESTHostServer class accepts TCP connections with epoll and serves them with one bREST.
+ * @details i.e.
+ *      bRESTInstance<> rest;
+ *      bRESTHostServer server(rest, 8080);
+ *      server.begin();
+ *      while (true)
+ *          server.loop();
+ */
+class bRESTHostServer {
+protected:
+    struct Connection {
+        int fd;
+        uint16_t length;
+        char request[MAX_HOST_REQUEST_SIZE];
+    };
+
+    bREST& rest;
+    uint16_t port;
+    int listen_fd;
+    int epoll_fd;
+    Connection connections[MAX_HOST_CONNECTIONS];
+    // epoll data of listening socket and of connections held by bREST. Connection uses its index.
+    static const uint32_t LISTEN_TAG = 0xFFFFFFFF;
+    static const uint32_t HELD_TAG = 0xFFFFFFFE;
+
+public:
+    bRESTHostServer(bREST& rest, uint16_t port): rest(rest) {
+        this->port = port;
+        this->listen_fd = -1;
+        this->epoll_fd = -1;
+        for (int i = 0; i < MAX_HOST_CONNECTIONS; i++)
+            connections[i].fd = -1;
+    }
+
+    virtual ~bRESTHostServer() {
+        end();
+    }
+
+    /**
+     * @brief begin listen on all interfaces
+     * @return true if successful. Otherwise, false.
+     */
+    bool begin() {
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (-1 == listen_fd)
+            return false;
+
+        int on = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        configure_listen_socket(listen_fd);
+
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        if (-1 == bind(listen_fd, (struct sockaddr*)&address, sizeof(address))
+            || -1 == listen(listen_fd, HOST_LISTEN_BACKLOG)) {
+            end();
+            return false;
+        }
+
+        // port 0 picks an ephemeral port
+        socklen_t address_length = sizeof(address);
+        if (0 == getsockname(listen_fd, (struct sockaddr*)&address, &address_length))
+            port = ntohs(address.sin_port);
+
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (-1 == epoll_fd || !watch(listen_fd, LISTEN_TAG)) {
+            end();
+            return false;
+        }
+        return true;
+    }
+
+    void end() {
+        for (int i = 0; i < MAX_HOST_CONNECTIONS; i++)
+            close_connection(i);
+        if (epoll_fd != -1) {
+            close(epoll_fd);
+            epoll_fd = -1;
+        }
+        if (listen_fd != -1) {
+            close(listen_fd);
+            listen_fd = -1;
+        }
+    }
+
+    uint16_t get_port() {
+        return port;
+    }
+
+    /**
+     * @brief loop wait for socket events once, serve every completed request, push pending stream events and serve
+     *        WebSocket messages
+     * @param timeout_ms epoll timeout in milliseconds. -1 waits forever. Pass a timeout to push events of resources
+     *        changed between requests.
+     * @return number of handled events, or -1 on error
+     */
+    int loop(int timeout_ms = -1) {
+        struct epoll_event events[MAX_HOST_CONNECTIONS + 1];
+        int n = epoll_wait(epoll_fd, events, MAX_HOST_CONNECTIONS + 1, timeout_ms);
+        if (-1 == n)
+            return (EINTR == errno)? 0: -1;
+
+        for (int i = 0; i < n; i++) {
+            if (LISTEN_TAG == events[i].data.u32)
+                accept_connections();
+            else if (events[i].data.u32 != HELD_TAG)
+                receive(events[i].data.u32);
+        }
+        rest.loop();
+        return n;
+    }
+
+protected:
+    /**
+     * @brief configure_listen_socket set socket options before bind. Override it i.e. for SO_REUSEPORT.
+     * @param fd listening socket
+     */
+    virtual void configure_listen_socket(int fd) {}
+
+    bool watch(int fd, uint32_t tag) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u32 = tag;
+        return 0 == epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    void accept_connections() {
+        while (true) {
+            int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (-1 == fd)
+                return;
+
+            int slot = find_free_connection();
+            if (-1 == slot || !watch(fd, slot)) {
+                // no room for connection
+                close(fd);
+                continue;
+            }
+
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            connections[slot].fd = fd;
+            connections[slot].length = 0;
+        }
+    }
+
+    int find_free_connection() {
+        for (int i = 0; i < MAX_HOST_CONNECTIONS; i++) {
+            if (-1 == connections[i].fd)
+                return i;
+        }
+        return -1;
+    }
+
+    /**
+     * @brief receive read available bytes of connection. Serve request once headers end, buffer is full or peer
+     *        closes.
+     * @param slot connection index
+     */
+    void receive(uint32_t slot) {
+        Connection& c = connections[slot];
+        bool is_complete = false;
+
+        while (!is_complete) {
+            ssize_t n = recv(c.fd, c.request + c.length, MAX_HOST_REQUEST_SIZE - c.length, 0);
+            if (n > 0) {
+                c.length += n;
+                is_complete = (c.length == MAX_HOST_REQUEST_SIZE) || is_header_complete(c);
+            } else if (0 == n) {
+                is_complete = true;
+            } else if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                return;
+            } else if (errno != EINTR) {
+                close_connection(slot);
+                return;
+            }
+        }
+
+        serve(slot);
+    }
+
+    bool is_header_complete(const Connection& c) {
+        return memmem(c.request, c.length, "\r\n\r\n", 4) != NULL;
+    }
+
+    /**
+     * @brief serve hand request to bREST. bREST writes response and closes connection.
+     * @param slot connection index
+     */
+    virtual void serve(uint32_t slot) {
+        Connection& c = connections[slot];
+        if (0 == c.length) {
+            close_connection(slot);
+            return;
+        }
+
+        // bREST closes the socket, or keeps it if client subscribes with ?stream=1 or upgrades to WebSocket
+        bRESTHostClient client(c.fd, c.request, c.length);
+        rest.handle(client);
+        // closed socket leaves epoll by itself
+        if (client.is_open()) {
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.events = EPOLLIN;
+            event.data.u32 = HELD_TAG;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.fd, &event);
+        }
+        c.fd = -1;
+    }
+
+    void close_connection(int slot) {
+        if (connections[slot].fd != -1) {
+            close(connections[slot].fd);
+            connections[slot].fd = -1;
+        }
+    }
+};
+
+#endif // bREST_HOST_SERVER_H
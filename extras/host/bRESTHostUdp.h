@@ -0,0 +1,165 @@
+/*
+  UDP socket in the shape of Arduino WiFiUDP, for datagram transports of bREST on a Linux host, i.e. bRESTCoap.
+
+  Addresses are IPv4 in network byte order. The socket is non-blocking, so parsePacket() returns 0 when no datagram
+  is waiting. Wait on get_fd() with poll() between loops.
+*/
+#ifndef bREST_HOST_UDP_H
+#define bREST_HOST_UDP_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+
+// Set size of receive and send buffers, the largest datagram. Default is 1500.
+#ifndef MAX_HOST_DATAGRAM_SIZE
+#define MAX_HOST_DATAGRAM_SIZE  1500
+#endif
+
+/**
+ * @brief The bRESTHostUdp class is a UDP socket with the receive and send calls of WiFiUDP.
+ */
+class bRESTHostUdp {
+protected:
+    int fd;
+    uint16_t port;
+    // received datagram
+    uint8_t received[MAX_HOST_DATAGRAM_SIZE];
+    size_t received_length;
+    size_t position;
+    struct sockaddr_in remote;
+    // datagram being written
+    uint8_t sending[MAX_HOST_DATAGRAM_SIZE];
+    size_t sending_length;
+    struct sockaddr_in destination;
+
+public:
+    bRESTHostUdp() {
+        fd = -1;
+        port = 0;
+        received_length = 0;
+        position = 0;
+        sending_length = 0;
+        memset(&remote, 0, sizeof(remote));
+        memset(&destination, 0, sizeof(destination));
+    }
+
+    virtual ~bRESTHostUdp() {
+        stop();
+    }
+
+    /**
+     * @brief begin bind to port on all interfaces
+     * @param port UDP port. 0 picks an ephemeral port.
+     * @return 1 if successful. Otherwise, 0.
+     */
+    uint8_t begin(uint16_t port) {
+        fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (-1 == fd)
+            return 0;
+
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        socklen_t address_length = sizeof(address);
+        if (-1 == bind(fd, (struct sockaddr*)&address, sizeof(address))
+                || -1 == getsockname(fd, (struct sockaddr*)&address, &address_length)) {
+            stop();
+            return 0;
+        }
+        this->port = ntohs(address.sin_port);
+        return 1;
+    }
+
+    void stop() {
+        if (fd != -1) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    int get_fd() {
+        return fd;
+    }
+
+    uint16_t get_port() {
+        return port;
+    }
+
+    /**
+     * @brief parsePacket receive the next datagram, dropping what is left of the current one
+     * @return size of datagram, which may exceed MAX_HOST_DATAGRAM_SIZE, or 0 if none is waiting
+     */
+    int parsePacket() {
+        socklen_t remote_length = sizeof(remote);
+        ssize_t n = recvfrom(fd, received, sizeof(received), MSG_TRUNC, (struct sockaddr*)&remote, &remote_length);
+        if (n < 0) {
+            received_length = 0;
+            position = 0;
+            return 0;
+        }
+        received_length = ((size_t)n < sizeof(received))? n: sizeof(received);
+        position = 0;
+        return n;
+    }
+
+    int available() {
+        return received_length - position;
+    }
+
+    int read() {
+        return (position < received_length)? received[position++]: -1;
+    }
+
+    int read(unsigned char* buffer, size_t length) {
+        size_t n = (length < received_length - position)? length: received_length - position;
+        memcpy(buffer, received + position, n);
+        position += n;
+        return n;
+    }
+
+    uint32_t remoteIP() {
+        return remote.sin_addr.s_addr;
+    }
+
+    uint16_t remotePort() {
+        return ntohs(remote.sin_port);
+    }
+
+    int beginPacket(uint32_t ip, uint16_t port) {
+        memset(&destination, 0, sizeof(destination));
+        destination.sin_family = AF_INET;
+        destination.sin_addr.s_addr = ip;
+        destination.sin_port = htons(port);
+        sending_length = 0;
+        return 1;
+    }
+
+    size_t write(uint8_t c) {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t* buffer, size_t length) {
+        size_t n = (length < sizeof(sending) - sending_length)? length: sizeof(sending) - sending_length;
+        memcpy(sending + sending_length, buffer, n);
+        sending_length += n;
+        return n;
+    }
+
+    /**
+     * @brief endPacket send the datagram written since beginPacket()
+     * @return 1 if sent. Otherwise, 0.
+     */
+    int endPacket() {
+        ssize_t n = sendto(fd, sending, sending_length, 0, (struct sockaddr*)&destination, sizeof(destination));
+        sending_length = 0;
+        return (n >= 0)? 1: 0;
+    }
+};
+
+#endif // bREST_HOST_UDP_H
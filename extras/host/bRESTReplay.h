@@ -0,0 +1,241 @@
+/*
+  Deterministic replay of requests captured by bRESTCapture.h.
+
+  A capture dump is decoded into requests with their chunks. bRESTReplay feeds the chunks into bREST::process() and
+  send_command() at recorded or maximum speed, and compares length and CRC-32 of every response with the captured
+  one. Replay needs the same observers, route table and capacities as the device that captured the requests.
+
+      std::vector<bRESTCapturedRequest> requests;
+      brest_load_capture("capture.json", requests);
+      bRESTReplay<> replay;
+      replay.add_observer(&calculator);
+      bRESTReplaySummary summary = replay.replay_all(requests, false);
+*/
+#ifndef bREST_REPLAY_H
+#define bREST_REPLAY_H
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "bREST.h"
+
+/**
+ * @brief The bRESTCapturedChunk struct is inbound bytes delivered by transport at once.
+ */
+struct bRESTCapturedChunk {
+    // micros() since start of request
+    uint32_t offset;
+    std::string bytes;
+};
+
+/**
+ * @brief The bRESTCapturedRequest struct is one captured request and the summary of its response.
+ */
+struct bRESTCapturedRequest {
+    // CAPTURE_FLAG bits
+    uint8_t flags;
+    // micros() on device when request started
+    uint32_t start;
+    std::vector<bRESTCapturedChunk> chunks;
+    // micros() from start of request to end of dispatch
+    uint32_t duration;
+    uint16_t response_length;
+    uint32_t response_crc;
+
+    /**
+     * @brief get_bytes get all inbound bytes of request
+     * @return inbound bytes
+     */
+    std::string get_bytes() const {
+        std::string bytes;
+        for (size_t i = 0; i < chunks.size(); i++)
+            bytes += chunks[i].bytes;
+        return bytes;
+    }
+};
+
+/**
+ * @brief The bRESTReplayResult struct compares replayed response and timing with the captured ones.
+ */
+struct bRESTReplayResult {
+    bool match;
+    uint16_t response_length;
+    uint32_t response_crc;
+    uint32_t recorded_duration;
+    uint32_t replay_duration;
+};
+
+struct bRESTReplaySummary {
+    unsigned long requests;
+    unsigned long mismatches;
+    uint64_t recorded_duration;
+    uint64_t replay_duration;
+};
+
+static uint32_t brest_capture_uint(const std::string& bytes, size_t position, uint8_t size) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < size; i++)
+        value |= (uint32_t)(uint8_t)bytes[position + i] << (8 * i);
+    return value;
+}
+
+/**
+ * @brief brest_decode_capture decode capture dump of bRESTCapture::dump() or GET /_capture
+ * @param dump JSON line of capture dump, or its hex string
+ * @param requests decoded requests are appended
+ * @return true if dump is well formed. Otherwise, false.
+ */
+static bool brest_decode_capture(const std::string& dump, std::vector<bRESTCapturedRequest>& requests) {
+    static const char KEY[] = "\"capture\":\"";
+    size_t begin = dump.find(KEY);
+    begin = (std::string::npos == begin)? 0: begin + sizeof(KEY) - 1;
+    size_t end = dump.find_first_not_of("0123456789abcdefABCDEF", begin);
+    if (std::string::npos == end)
+        end = dump.size();
+    if ((end - begin) % 2 != 0)
+        return false;
+
+    std::string bytes;
+    for (size_t i = begin; i < end; i += 2)
+        bytes += (char)strtoul(dump.substr(i, 2).c_str(), NULL, 16);
+
+    size_t position = 0;
+    while (position < bytes.size()) {
+        if (bytes[position] != CAPTURE_REQUEST_ENTRY || position + CAPTURE_REQUEST_SIZE > bytes.size())
+            return false;
+        size_t request_end = position + brest_capture_uint(bytes, position + 1, 2);
+        if (request_end > bytes.size())
+            return false;
+
+        bRESTCapturedRequest request;
+        request.flags = bytes[position + 3];
+        request.start = brest_capture_uint(bytes, position + 4, 4);
+        position += CAPTURE_REQUEST_SIZE;
+
+        bool has_response = false;
+        while (position < request_end) {
+            if (CAPTURE_CHUNK_ENTRY == bytes[position] && position + CAPTURE_CHUNK_SIZE <= request_end) {
+                bRESTCapturedChunk chunk;
+                chunk.offset = brest_capture_uint(bytes, position + 1, 4);
+                size_t length = brest_capture_uint(bytes, position + 5, 2);
+                position += CAPTURE_CHUNK_SIZE;
+                if (position + length > request_end)
+                    return false;
+                chunk.bytes = bytes.substr(position, length);
+                request.chunks.push_back(chunk);
+                position += length;
+            } else if (CAPTURE_RESPONSE_ENTRY == bytes[position] && position + CAPTURE_RESPONSE_SIZE <= request_end) {
+                request.duration = brest_capture_uint(bytes, position + 1, 4);
+                request.response_length = brest_capture_uint(bytes, position + 5, 2);
+                request.response_crc = brest_capture_uint(bytes, position + 7, 4);
+                position += CAPTURE_RESPONSE_SIZE;
+                has_response = true;
+            } else {
+                return false;
+            }
+        }
+        if (!has_response)
+            return false;
+        requests.push_back(request);
+    }
+    return true;
+}
+
+/**
+ * @brief brest_load_capture load capture dump file
+ * @param path path of file with one capture dump
+ * @param requests loaded requests are appended
+ * @return true if file is loaded and well formed. Otherwise, false.
+ */
+static bool brest_load_capture(const std::string& path, std::vector<bRESTCapturedRequest>& requests) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (NULL == file)
+        return false;
+
+    std::string dump;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        dump.append(buffer, n);
+    fclose(file);
+    return brest_decode_capture(dump, requests);
+}
+
+/**
+ * @brief The bRESTReplay class replays captured requests into bREST and compares responses.
+ * @details It calls process() and send_command() directly, so replay is not captured again.
+ */
+template<typename CAPACITIES = bRESTCapacities<> >
+class bRESTReplay: public bRESTInstance<CAPACITIES> {
+public:
+    /**
+     * @brief replay replay one request
+     * @param request captured request
+     * @param recorded_speed deliver chunks at their recorded offsets. Otherwise, at maximum speed.
+     * @return result of comparison
+     */
+    bRESTReplayResult replay(const bRESTCapturedRequest& request, bool recorded_speed) {
+        bRESTReplayResult result;
+        uint32_t start = micros();
+        this->stage_start = this->metrics_clock();
+        for (size_t i = 0; i < request.chunks.size(); i++) {
+            const bRESTCapturedChunk& chunk = request.chunks[i];
+            if (recorded_speed)
+                wait_until(start + chunk.offset);
+            for (size_t j = 0; j < chunk.bytes.size(); j++)
+                this->process(chunk.bytes[j]);
+        }
+        this->send_command(request.flags & CAPTURE_HEADERS, request.flags & CAPTURE_DECODE);
+        result.replay_duration = micros() - start;
+
+        result.recorded_duration = request.duration;
+        result.response_length = this->get_buffer_length();
+        result.response_crc = bRESTCapture::crc32((const uint8_t*)this->buffer, result.response_length);
+        result.match = (result.response_length == request.response_length && result.response_crc == request.response_crc);
+
+        this->resetBuffer();
+        this->reset_status();
+        return result;
+    }
+
+    /**
+     * @brief replay_all replay requests in order
+     * @param requests captured requests
+     * @param recorded_speed keep recorded gaps between requests and between chunks. Otherwise, maximum speed.
+     * @param results result of every request is appended if it is not NULL
+     * @return summary of comparison
+     */
+    bRESTReplaySummary replay_all(const std::vector<bRESTCapturedRequest>& requests, bool recorded_speed,
+                                  std::vector<bRESTReplayResult>* results = NULL) {
+        bRESTReplaySummary summary = {0, 0, 0, 0};
+        uint32_t start = micros();
+        for (size_t i = 0; i < requests.size(); i++) {
+            if (recorded_speed)
+                wait_until(start + (requests[i].start - requests[0].start));
+
+            bRESTReplayResult result = replay(requests[i], recorded_speed);
+            summary.requests++;
+            if (!result.match)
+                summary.mismatches++;
+            summary.recorded_duration += result.recorded_duration;
+            summary.replay_duration += result.replay_duration;
+            if (results != NULL)
+                results->push_back(result);
+        }
+        return summary;
+    }
+
+protected:
+    void wait_until(uint32_t deadline) {
+        // sleep overshoots by tens of microseconds, so spin for the last part
+        int32_t remaining = (int32_t)(deadline - micros());
+        if (remaining > 200)
+            delayMicroseconds(remaining - 200);
+        while ((int32_t)(deadline - micros()) > 0)
+            ;
+    }
+};
+
+#endif // bREST_REPLAY_H
@@ -0,0 +1,239 @@
+/*
+  Multi-threaded sharded bREST server for Linux host.
+
+  Each worker thread owns a bRESTInstance with its own parser state and buffers, and its own epoll accept loop on
+  the same port with SO_REUSEPORT, so the kernel spreads connections over workers. Workers share the same observers
+  and route table, which are read-only once the server starts. Call backs of one resource are serialized by a
+  per-resource mutex, unless the resource opts in to concurrency with Observer::is_concurrent().
+
+  Metrics are kept per worker. /_metrics reports the worker that accepts the connection. Allocation tracking and
+  tracing count for all threads together and are meant for single-threaded runs.
+*/
+#ifndef bREST_SHARDED_SERVER_H
+#define bREST_SHARDED_SERVER_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bRESTHostServer.h"
+
+/**
+ * @brief The bRESTResourceLocks class holds one mutex per resource. It is read-only once workers start.
+ */
+class bRESTResourceLocks {
+protected:
+    std::map<Observer*, std::unique_ptr<std::mutex> > locks;
+
+public:
+    void add(Observer* p_resource) {
+        if (0 == locks.count(p_resource))
+            locks[p_resource].reset(new std::mutex());
+    }
+
+    /**
+     * @brief find find mutex of resource
+     * @param p_resource resource
+     * @return mutex if resource is registered. Otherwise, NULL.
+     */
+    std::mutex* find(Observer* p_resource) {
+        std::map<Observer*, std::unique_ptr<std::mutex> >::iterator it = locks.find(p_resource);
+        return (it == locks.end())? NULL: it->second.get();
+    }
+};
+
+/**
+ * @brief The bRESTShard class is bREST of one worker thread. It serializes call backs of each resource across workers.
+ */
+template<typename CAPACITIES = bRESTCapacities<> >
+class bRESTShard: public bRESTInstance<CAPACITIES> {
+protected:
+    bRESTResourceLocks& locks;
+
+public:
+    bRESTShard(bRESTResourceLocks& locks): locks(locks) {}
+
+protected:
+    void invoke(Observer* p_resource) override {
+        std::mutex* lock = locks.find(p_resource);
+        if (NULL == lock) {
+            bREST::invoke(p_resource);
+            return;
+        }
+
+        if (p_resource->is_concurrent()) {
+            // only accounting of resource needs lock
+            bREST::ObserverCall call = this->begin_call();
+            this->call_observer(p_resource);
+            std::lock_guard<std::mutex> guard(*lock);
+            this->end_call(p_resource, call);
+        } else {
+            std::lock_guard<std::mutex> guard(*lock);
+            bREST::invoke(p_resource);
+        }
+    }
+};
+
+/**
+ * @brief The bRESTReusePortServer class is bRESTHostServer that shares its port with other workers.
+ */
+class bRESTReusePortServer: public bRESTHostServer {
+public:
+    bRESTReusePortServer(bREST& rest, uint16_t port): bRESTHostServer(rest, port) {}
+
+protected:
+    void configure_listen_socket(int fd) override {
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    }
+};
+
+/**
+ * @brief The bRESTShardedServer class serves bREST with N worker threads on one port.
+ * @details i.e.
+ *      bRESTShardedServer<> server(8080, 4);
+ *      server.add_observer(&calculator);
+ *      server.begin();
+ *      server.join();
+ */
+template<typename CAPACITIES = bRESTCapacities<> >
+class bRESTShardedServer {
+protected:
+    struct Worker {
+        bRESTShard<CAPACITIES> rest;
+        bRESTReusePortServer server;
+        std::thread thread;
+
+        Worker(bRESTResourceLocks& locks, uint16_t port): rest(locks), server(rest, port) {}
+    };
+
+    uint16_t port;
+    unsigned int num_workers;
+    std::vector<Observer*> observers;
+    RouteTable route_table;
+    bRESTResourceLocks locks;
+    std::vector<std::unique_ptr<Worker> > workers;
+    std::atomic<bool> running;
+
+public:
+    /**
+     * @brief bRESTShardedServer constructor
+     * @param port TCP port. 0 picks an ephemeral port.
+     * @param num_workers number of worker threads. 0 uses one per CPU.
+     */
+    bRESTShardedServer(uint16_t port, unsigned int num_workers = 0): running(false) {
+        this->port = port;
+        this->num_workers = (num_workers != 0)? num_workers: std::thread::hardware_concurrency();
+        if (0 == this->num_workers)
+            this->num_workers = 1;
+        this->route_table.route_count = 0;
+    }
+
+    virtual ~bRESTShardedServer() {
+        end();
+    }
+
+    /**
+     * @brief add_observer add resource to all workers. Call it before begin().
+     * @param new_resource
+     * @return true if successful. Otherwise, false
+     */
+    bool add_observer(Observer* new_resource) {
+        if (running || observers.size() >= CAPACITIES::max_num_resources)
+            return false;
+        observers.push_back(new_resource);
+        locks.add(new_resource);
+        return true;
+    }
+
+    /**
+     * @brief set_route_table dispatch requests of all workers through a route table. Call it before begin().
+     * @param table route table built by BREST_ROUTE_TABLE()
+     */
+    void set_route_table(const RouteTable& table) {
+        if (running)
+            return;
+        route_table = table;
+        for (uint8_t i = 0; i < table.route_count; i++)
+            locks.add(table.get_observer(i));
+    }
+
+    /**
+     * @brief begin listen on port and start worker threads
+     * @return true if all workers listen. Otherwise, false.
+     */
+    bool begin() {
+        if (running)
+            return false;
+
+        for (unsigned int i = 0; i < num_workers; i++) {
+            std::unique_ptr<Worker> worker(new Worker(locks, port));
+            worker->rest.set_route_table(route_table);
+            for (size_t j = 0; j < observers.size(); j++)
+                worker->rest.add_observer(observers[j]);
+
+            if (!worker->server.begin()) {
+                workers.clear();
+                return false;
+            }
+            // the other workers join ephemeral port of the first one
+            port = worker->server.get_port();
+            workers.push_back(std::move(worker));
+        }
+
+        running = true;
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i]->thread = std::thread(&bRESTShardedServer::run, this, workers[i].get());
+        return true;
+    }
+
+    /**
+     * @brief join wait for worker threads to exit
+     */
+    void join() {
+        for (size_t i = 0; i < workers.size(); i++) {
+            if (workers[i]->thread.joinable())
+                workers[i]->thread.join();
+        }
+    }
+
+    /**
+     * @brief end stop worker threads and close their sockets
+     */
+    void end() {
+        running = false;
+        join();
+        workers.clear();
+    }
+
+    uint16_t get_port() {
+        return port;
+    }
+
+    unsigned int get_num_workers() {
+        return num_workers;
+    }
+
+    /**
+     * @brief get_shard get bREST of worker, i.e. to read its metrics
+     * @param i worker index
+     * @return bREST of worker
+     */
+    bREST& get_shard(unsigned int i) {
+        return workers[i]->rest;
+    }
+
+protected:
+    void run(Worker* worker) {
+        // wake up periodically to notice end()
+        while (running) {
+            if (worker->server.loop(100) < 0)
+                break;
+        }
+    }
+};
+
+#endif // bREST_SHARDED_SERVER_H
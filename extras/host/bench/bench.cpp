@@ -0,0 +1,339 @@
+/*
+  In-process benchmark of bREST request path.
+
+  For each request corpus, it reports ns/request and bytes/sec of bREST::handle(), allocations/request counted by
+  malloc hooks, and a per-stage breakdown of process(), send_command(), resource call back and sendBuffer().
+  It also measures the addToBuffer() family by rendering a typical JSON response, call by call and by
+  serialize_state(), the size and time of a numeric response in JSON, CBOR and MessagePack, and the same resource
+  dispatched through Observer::on_request() and through StaticObserver handlers. Output is JSON, so runs can be compared across commits:
+      ./build/bench bench/corpus 20000 > before.json
+*/
+#define BREST_ALLOC_HOOKS 1
+
+#include <bREST.h>
+#include <bRESTSerializer.h>
+
+#include <chrono>
+
+#include "bench_corpus.h"
+#include "bench_resources.h"
+
+typedef std::chrono::steady_clock BenchClock;
+
+static uint64_t elapsed_ns(BenchClock::time_point start, BenchClock::time_point end) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+/**
+ * @brief The BenchREST class exposes request stages of bREST to time them one by one.
+ */
+class BenchREST: public bRESTInstance<> {
+public:
+    uint64_t update_ns;
+
+    BenchREST() {
+        update_ns = 0;
+    }
+
+    void feed(const std::string& request) {
+        stage_start = metrics_clock();
+        for (size_t i = 0; i < request.size(); i++)
+            process(request[i]);
+    }
+
+    void dispatch() {
+        send_command(true, true);
+    }
+
+    void send(BenchClient& client) {
+        sendBuffer(client, 0, 0);
+    }
+
+    void reset() {
+        reset_status();
+    }
+
+protected:
+    void invoke(Observer* p_resource) override {
+        BenchClock::time_point start = BenchClock::now();
+        bREST::invoke(p_resource);
+        update_ns += elapsed_ns(start, BenchClock::now());
+    }
+};
+
+static void bench_corpus(BenchREST& rest, const BenchCorpus& corpus, unsigned long iterations, bool is_first) {
+    BenchClient client;
+    unsigned long requests = iterations * corpus.requests.size();
+
+    // warm up
+    for (size_t i = 0; i < corpus.requests.size(); i++) {
+        client.set_request(corpus.requests[i]);
+        rest.handle(client);
+    }
+
+    // whole request path
+    client.response_bytes = 0;
+#if BREST_URL_CACHE
+    uint32_t cache_hits = rest.get_url_cache().hits;
+    uint32_t cache_misses = rest.get_url_cache().misses;
+#endif
+    bRESTAllocCounters allocations_before = bRESTAllocCounters::instance();
+    BenchClock::time_point start = BenchClock::now();
+    for (unsigned long n = 0; n < iterations; n++) {
+        for (size_t i = 0; i < corpus.requests.size(); i++) {
+            client.set_request(corpus.requests[i]);
+            rest.handle(client);
+        }
+    }
+    uint64_t total_ns = elapsed_ns(start, BenchClock::now());
+    bRESTAllocCounters allocations_after = bRESTAllocCounters::instance();
+    size_t response_bytes = client.response_bytes;
+    double cache_hit_rate = 0;
+#if BREST_URL_CACHE
+    cache_hits = rest.get_url_cache().hits - cache_hits;
+    cache_misses = rest.get_url_cache().misses - cache_misses;
+    if (cache_hits + cache_misses > 0)
+        cache_hit_rate = (double)cache_hits / (cache_hits + cache_misses);
+#endif
+
+    // stage by stage
+    uint64_t parse_ns = 0, dispatch_ns = 0, send_ns = 0;
+    rest.update_ns = 0;
+    for (unsigned long n = 0; n < iterations; n++) {
+        for (size_t i = 0; i < corpus.requests.size(); i++) {
+            BenchClock::time_point t0 = BenchClock::now();
+            rest.feed(corpus.requests[i]);
+            BenchClock::time_point t1 = BenchClock::now();
+            rest.dispatch();
+            BenchClock::time_point t2 = BenchClock::now();
+            rest.send(client);
+            BenchClock::time_point t3 = BenchClock::now();
+            rest.reset();
+            parse_ns += elapsed_ns(t0, t1);
+            dispatch_ns += elapsed_ns(t1, t2);
+            send_ns += elapsed_ns(t2, t3);
+        }
+    }
+    // dispatch excludes resource call back
+    dispatch_ns -= rest.update_ns;
+
+    printf("%s\n    {\"name\":\"%s\",\"requests\":%lu,\"ns_per_request\":%.1f,\"bytes_per_sec\":%.0f,"
+           "\"allocations_per_request\":%.3f,\"allocated_bytes_per_request\":%.1f,\"response_bytes_per_request\":%.1f,"
+           "\"url_cache_hit_rate\":%.3f,\"stages_ns_per_request\":{\"parse\":%.1f,\"dispatch\":%.1f,\"update\":%.1f,\"send\":%.1f}}",
+           is_first? "": ",",
+           corpus.name.c_str(), requests,
+           (double)total_ns / requests,
+           (double)corpus.bytes * iterations * 1e9 / total_ns,
+           (double)(allocations_after.allocations - allocations_before.allocations) / requests,
+           (double)(allocations_after.allocated_bytes - allocations_before.allocated_bytes) / requests,
+           (double)response_bytes / requests, cache_hit_rate,
+           (double)parse_ns / requests, (double)dispatch_ns / requests,
+           (double)rest.update_ns / requests, (double)send_ns / requests);
+}
+
+static void bench_writer(BenchREST& rest, unsigned long iterations) {
+    size_t bytes = 0;
+    bRESTAllocCounters allocations_before = bRESTAllocCounters::instance();
+    BenchClock::time_point start = BenchClock::now();
+    for (unsigned long n = 0; n < iterations; n++) {
+        rest.resetBuffer();
+        rest.start_json_msg();
+        rest.append_key_value_pair_to_json(F("message"), F("PowerPlug get fire up!"));
+        rest.append_comma_to_json();
+        rest.append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest.append_comma_to_json();
+        rest.append_key_value_pair_to_json(F("is_switch_open"), true);
+        rest.append_comma_to_json();
+        rest.append_key_value_pair_to_json(F("sum"), 22.2f);
+        rest.append_comma_to_json();
+        rest.append_key_value_pair_to_json("name", "living \"room\" lamp");
+        rest.end_json_msg();
+        bytes += rest.get_buffer_length();
+    }
+    uint64_t total_ns = elapsed_ns(start, BenchClock::now());
+    bRESTAllocCounters allocations_after = bRESTAllocCounters::instance();
+    rest.resetBuffer();
+
+    printf("  \"writer\":{\"responses\":%lu,\"ns_per_response\":%.1f,\"bytes_per_sec\":%.0f,\"allocations_per_response\":%.3f}",
+           iterations, (double)total_ns / iterations, (double)bytes * 1e9 / total_ns,
+           (double)(allocations_after.allocations - allocations_before.allocations) / iterations);
+}
+
+// The response of bench_writer(), declared once for the serializer
+struct WriterState {
+    const __FlashStringHelper* message;
+    int code;
+    bool is_switch_open;
+    float sum;
+    const char* name;
+};
+BREST_SERIALIZER(WriterState, message, code, is_switch_open, sum, name)
+
+/**
+ * @brief bench_serializer render the response of bench_writer() from a struct with serialize_state()
+ */
+static void bench_serializer(BenchREST& rest, unsigned long iterations) {
+    WriterState state = {F("PowerPlug get fire up!"), CODE_OK, true, 22.2f, "living \"room\" lamp"};
+    size_t bytes = 0;
+    BenchClock::time_point start = BenchClock::now();
+    for (unsigned long n = 0; n < iterations; n++) {
+        rest.resetBuffer();
+        serialize_state(&rest, state);
+        bytes += rest.get_buffer_length();
+    }
+    uint64_t total_ns = elapsed_ns(start, BenchClock::now());
+    rest.resetBuffer();
+
+    printf("  \"serializer\":{\"responses\":%lu,\"ns_per_response\":%.1f,\"bytes_per_sec\":%.0f}",
+           iterations, (double)total_ns / iterations, (double)bytes * 1e9 / total_ns);
+}
+
+// The response of bench_writer(), as a template
+constexpr char WRITER_TEMPLATE[] PROGMEM =
+    "{\"message\":\"PowerPlug get fire up!\",\"code\":" BREST_INT_SLOT ",\"is_switch_open\":" BREST_BOOL_SLOT
+    ",\"sum\":" BREST_FLOAT_SLOT ",\"name\":" BREST_STRING_SLOT "}\r\n";
+
+/**
+ * @brief bench_template render the response of bench_writer() by filling a template
+ */
+static void bench_template(BenchREST& rest, unsigned long iterations) {
+    size_t bytes = 0;
+    BenchClock::time_point start = BenchClock::now();
+    for (unsigned long n = 0; n < iterations; n++) {
+        rest.resetBuffer();
+        BREST_TEMPLATE(WRITER_TEMPLATE)::fill(&rest, (int)CODE_OK, true, 22.2f, "living \"room\" lamp");
+        bytes += rest.get_buffer_length();
+    }
+    uint64_t total_ns = elapsed_ns(start, BenchClock::now());
+    rest.resetBuffer();
+
+    printf("  \"template\":{\"responses\":%lu,\"ns_per_response\":%.1f,\"bytes_per_sec\":%.0f}",
+           iterations, (double)total_ns / iterations, (double)bytes * 1e9 / total_ns);
+}
+
+/**
+ * @brief bench_transports time the same request through each transport entry point, parsing included
+ */
+static void bench_transports(BenchREST& rest, unsigned long iterations) {
+    static const char COMPACT[] = "GET calc input1=1.2 input2=23";
+    static const char PAYLOAD[] = "input1=1.2&input2=23";
+    char* parms[] = {(char*)"input1", (char*)"input2"};
+    char* values[] = {(char*)"1.2", (char*)"23"};
+    uint64_t ns[4] = {0, 0, 0, 0};
+
+    for (unsigned long n = 0; n < iterations; n++) {
+        char line[] = "GET /calc/?input1=1.2&input2=23 ";
+        char resource[] = "calc";
+        bRESTRequest request = {HTTP_METHOD_GET, resource, parms, values, 2, NULL, 0, RESPONSE_FORMAT_JSON};
+
+        BenchClock::time_point t0 = BenchClock::now();
+        rest.handle(line);
+        rest.resetBuffer();
+        BenchClock::time_point t1 = BenchClock::now();
+        rest.handle_compact(COMPACT, sizeof(COMPACT) - 1);
+        rest.resetBuffer();
+        BenchClock::time_point t2 = BenchClock::now();
+        rest.handle_message(HTTP_METHOD_GET, resource, (const uint8_t*)PAYLOAD, sizeof(PAYLOAD) - 1);
+        rest.resetBuffer();
+        BenchClock::time_point t3 = BenchClock::now();
+        rest.handle_request(request);
+        rest.resetBuffer();
+        BenchClock::time_point t4 = BenchClock::now();
+        ns[0] += elapsed_ns(t0, t1);
+        ns[1] += elapsed_ns(t1, t2);
+        ns[2] += elapsed_ns(t2, t3);
+        ns[3] += elapsed_ns(t3, t4);
+    }
+
+    printf("  \"transports_ns_per_request\":{\"string\":%.1f,\"compact\":%.1f,\"message\":%.1f,\"request\":%.1f}",
+           (double)ns[0] / iterations, (double)ns[1] / iterations, (double)ns[2] / iterations,
+           (double)ns[3] / iterations);
+}
+
+/**
+ * @brief bench_formats time the same numeric response in each format, and report its size
+ */
+static void bench_formats(BenchREST& rest, unsigned long iterations) {
+    static const RESPONSE_FORMAT FORMATS[] = {RESPONSE_FORMAT_JSON, RESPONSE_FORMAT_CBOR, RESPONSE_FORMAT_MSGPACK};
+    char resource[] = "sensor";
+
+    printf("  \"formats\":{");
+    for (size_t i = 0; i < sizeof(FORMATS) / sizeof(FORMATS[0]); i++) {
+        bRESTRequest request = {HTTP_METHOD_GET, resource, NULL, NULL, 0, NULL, 0, FORMATS[i]};
+        rest.handle_request(request);
+        uint16_t bytes = rest.get_buffer_length();
+        rest.resetBuffer();
+
+        BenchClock::time_point start = BenchClock::now();
+        for (unsigned long n = 0; n < iterations; n++) {
+            rest.handle_request(request);
+            rest.resetBuffer();
+        }
+        uint64_t total_ns = elapsed_ns(start, BenchClock::now());
+
+        printf("%s\"%s\":{\"response_bytes\":%u,\"ns_per_request\":%.1f}", (0 == i)? "": ",",
+               get_format_name(FORMATS[i]), bytes, (double)total_ns / iterations);
+    }
+    printf("}");
+}
+
+/**
+ * @brief bench_observers time the same PUT to a switch served by on_request() and by StaticObserver handlers
+ */
+static void bench_observers(BenchREST& rest, unsigned long iterations) {
+    static const char* const RESOURCES[] = {"switch", "static_switch"};
+    char* parms[] = {(char*)"open"};
+    char* values[] = {(char*)"true"};
+    uint64_t ns[2] = {0, 0};
+
+    for (size_t i = 0; i < 2; i++) {
+        char resource[16];
+        strcpy(resource, RESOURCES[i]);
+        bRESTRequest request = {HTTP_METHOD_PUT, resource, parms, values, 1, NULL, 0, RESPONSE_FORMAT_JSON};
+
+        BenchClock::time_point start = BenchClock::now();
+        for (unsigned long n = 0; n < iterations; n++) {
+            rest.handle_request(request);
+            rest.resetBuffer();
+        }
+        ns[i] = elapsed_ns(start, BenchClock::now());
+    }
+
+    printf("  \"observers_ns_per_request\":{\"virtual\":%.1f,\"static\":%.1f}",
+           (double)ns[0] / iterations, (double)ns[1] / iterations);
+}
+
+int main(int argc, char* argv[]) {
+    std::string corpus_dir = (argc > 1)? argv[1]: "bench/corpus";
+    unsigned long iterations = (argc > 2)? strtoul(argv[2], NULL, 10): 20000;
+
+    std::vector<BenchCorpus> corpora = bench_load_corpora(corpus_dir);
+    if (corpora.empty()) {
+        fprintf(stderr, "No request corpus found in %s\n", corpus_dir.c_str());
+        return 1;
+    }
+
+    static BenchREST rest;
+    rest.set_route_table(BREST_ROUTE_TABLE(ROUTES));
+    rest.add_observer(&calculator);
+    rest.add_observer(&legacy);
+    rest.add_observer(&sensor);
+
+    printf("{\n  \"iterations\":%lu,\n  \"metrics\":%d,\n  \"corpora\":[", iterations, BREST_METRICS);
+    for (size_t i = 0; i < corpora.size(); i++)
+        bench_corpus(rest, corpora[i], iterations, 0 == i);
+    printf("\n  ],\n");
+    bench_writer(rest, iterations * 10);
+    printf(",\n");
+    bench_serializer(rest, iterations * 10);
+    printf(",\n");
+    bench_template(rest, iterations * 10);
+    printf(",\n");
+    bench_transports(rest, iterations);
+    printf(",\n");
+    bench_formats(rest, iterations);
+    printf(",\n");
+    bench_observers(rest, iterations * 10);
+    printf("\n}\n");
+    return 0;
+}
@@ -0,0 +1,192 @@
+/*
+  Request corpus of host benchmarks.
+
+  A corpus file holds one raw request per line. Lines starting with '#' and empty lines are skipped. Requests are
+  written with C escapes: \r, \n, \t, \\ and \xHH. A capture dump (*.json) of bRESTCapture.h is a corpus as well.
+*/
+#ifndef bREST_BENCH_CORPUS_H
+#define bREST_BENCH_CORPUS_H
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <bRESTReplay.h>
+
+/**
+ * @brief The BenchClient class replays one request and discards response. Request may be delivered in segments of
+ *        segment_size bytes, as if it arrived in several TCP segments.
+ */
+class BenchClient {
+protected:
+    const std::string* request;
+    size_t position;
+
+public:
+    size_t response_bytes;
+    // 0 delivers whole request at once
+    size_t segment_size;
+
+    BenchClient() {
+        request = NULL;
+        position = 0;
+        response_bytes = 0;
+        segment_size = 0;
+    }
+
+    void set_request(const std::string& request) {
+        this->request = &request;
+        this->position = 0;
+    }
+
+    int available() {
+        size_t remaining = request->size() - position;
+        if (0 == segment_size)
+            return remaining;
+        size_t segment_remaining = segment_size - position % segment_size;
+        return (remaining < segment_remaining)? remaining: segment_remaining;
+    }
+
+    int read() {
+        return (unsigned char)(*request)[position++];
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) {
+        response_bytes += size;
+        return size;
+    }
+
+    uint8_t connected() {
+        return 1;
+    }
+
+    void stop() {}
+};
+
+struct BenchCorpus {
+    std::string name;
+    std::vector<std::string> requests;
+    size_t bytes;
+};
+
+static int bench_hex_digit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * @brief bench_unescape decode C escapes of one corpus line
+ * @param line corpus line
+ * @return raw request
+ */
+static std::string bench_unescape(const std::string& line) {
+    std::string raw;
+    for (size_t i = 0; i < line.size(); i++) {
+        if (line[i] != '\\' || i + 1 == line.size()) {
+            raw += line[i];
+            continue;
+        }
+
+        char c = line[++i];
+        if ('r' == c) {
+            raw += '\r';
+        } else if ('n' == c) {
+            raw += '\n';
+        } else if ('t' == c) {
+            raw += '\t';
+        } else if ('x' == c && i + 2 < line.size()
+                   && bench_hex_digit(line[i + 1]) >= 0 && bench_hex_digit(line[i + 2]) >= 0) {
+            raw += (char)(16 * bench_hex_digit(line[i + 1]) + bench_hex_digit(line[i + 2]));
+            i += 2;
+        } else {
+            raw += c;
+        }
+    }
+    return raw;
+}
+
+/**
+ * @brief bench_load_corpus load one corpus file
+ * @param path path of corpus file, or capture dump if it ends with .json
+ * @param corpus loaded corpus. Its name is file name without extension.
+ * @return true if file is loaded and has requests. Otherwise, false.
+ */
+static bool bench_load_corpus(const std::string& path, BenchCorpus& corpus) {
+    size_t slash = path.find_last_of('/');
+    std::string file_name = (std::string::npos == slash)? path: path.substr(slash + 1);
+    corpus.name = file_name.substr(0, file_name.find_last_of('.'));
+    corpus.requests.clear();
+    corpus.bytes = 0;
+
+    if (path.size() > 5 && 0 == path.compare(path.size() - 5, 5, ".json")) {
+        std::vector<bRESTCapturedRequest> captured;
+        if (!brest_load_capture(path, captured))
+            return false;
+        for (size_t i = 0; i < captured.size(); i++) {
+            corpus.requests.push_back(captured[i].get_bytes());
+            corpus.bytes += corpus.requests.back().size();
+        }
+        return !corpus.requests.empty();
+    }
+
+    FILE* file = fopen(path.c_str(), "r");
+    if (NULL == file)
+        return false;
+
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, file)) != -1) {
+        std::string text(line, length);
+        while (!text.empty() && ('\n' == text[text.size() - 1] || '\r' == text[text.size() - 1]))
+            text.erase(text.size() - 1);
+        if (text.empty() || '#' == text[0])
+            continue;
+
+        corpus.requests.push_back(bench_unescape(text));
+        corpus.bytes += corpus.requests.back().size();
+    }
+    free(line);
+    fclose(file);
+    return !corpus.requests.empty();
+}
+
+/**
+ * @brief bench_load_corpora load all *.txt corpus files and *.json capture dumps of directory in name order
+ * @param directory corpus directory
+ * @return corpora
+ */
+static std::vector<BenchCorpus> bench_load_corpora(const std::string& directory) {
+    std::vector<std::string> paths;
+    DIR* dir = opendir(directory.c_str());
+    if (dir != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            std::string name = entry->d_name;
+            if ((name.size() > 4 && 0 == name.compare(name.size() - 4, 4, ".txt"))
+                    || (name.size() > 5 && 0 == name.compare(name.size() - 5, 5, ".json")))
+                paths.push_back(directory + "/" + name);
+        }
+        closedir(dir);
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::vector<BenchCorpus> corpora;
+    for (size_t i = 0; i < paths.size(); i++) {
+        BenchCorpus corpus;
+        if (bench_load_corpus(paths[i], corpus))
+            corpora.push_back(corpus);
+    }
+    return corpora;
+}
+
+#endif // bREST_BENCH_CORPUS_H
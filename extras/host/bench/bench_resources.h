@@ -0,0 +1,119 @@
+/*
+  Resources served by host benchmarks and replay.
+
+  Captures replayed by build/replay must be recorded with the same resources.
+*/
+#ifndef bREST_BENCH_RESOURCES_H
+#define bREST_BENCH_RESOURCES_H
+
+#include <bREST.h>
+#include <bRESTStaticObserver.h>
+
+class CalculatorResource: public Observer {
+public:
+    CalculatorResource(const __FlashStringHelper* resource_id): Observer(resource_id) {}
+
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
+        float sum = 0;
+        for (int i = 0; i < parm_count; i++)
+            sum += atof(value[i]);
+
+        rest->start_json_msg();
+        rest->append_key_value_pair_to_json(F("message"), F("CalculatorResource get fire up!"));
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("sum"), sum);
+        rest->end_json_msg();
+    }
+};
+
+class SwitchResource: public Observer {
+public:
+    bool is_open;
+
+    SwitchResource() {
+        is_open = true;
+    }
+
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
+        int open_index = find_parm(parms, parm_count, "open");
+        if (HTTP_METHOD_PUT == method && open_index != -1)
+            is_open = (0 == strcmp(value[open_index], "true"));
+
+        rest->start_json_msg();
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("is_switch_open"), is_open);
+        rest->end_json_msg();
+    }
+};
+
+// SwitchResource with per-method handlers
+class StaticSwitchResource: public StaticObserver<StaticSwitchResource> {
+public:
+    bool is_open;
+
+    StaticSwitchResource() {
+        is_open = true;
+    }
+
+    void on_get(const bRESTRequest& request, bREST* rest) {
+        rest->start_json_msg();
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("is_switch_open"), is_open);
+        rest->end_json_msg();
+    }
+
+    void on_put(const bRESTRequest& request, bREST* rest) {
+        const char* open = request.get("open");
+        if (open != NULL)
+            is_open = (0 == strcmp(open, "true"));
+        on_get(request, rest);
+    }
+};
+
+// Resource with String call back, i.e. parameters copied into Strings held by bREST per request
+class LegacyResource: public Observer {
+public:
+    LegacyResource(String resource_id): Observer(resource_id) {}
+
+    void update(HTTP_METHOD method, String parms[], String value[], int parm_count, bREST* rest) override {
+        rest->start_json_msg();
+        for (int i = 0; i < parm_count; i++) {
+            if (i > 0)
+                rest->append_comma_to_json();
+            rest->append_key_value_pair_to_json(parms[i], value[i]);
+        }
+        rest->end_json_msg();
+    }
+};
+
+// Numeric readings rendered with put(), in the format client asked for
+class SensorResource: public Observer {
+public:
+    SensorResource(const __FlashStringHelper* resource_id): Observer(resource_id) {}
+
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
+        rest->start_json_msg();
+        rest->put(F("code"), CODE_OK);
+        rest->put(F("temperature"), 21.5f);
+        rest->put(F("humidity"), 48.25f);
+        rest->put(F("pressure"), 1013);
+        rest->put(F("battery"), 87);
+        rest->put(F("rssi"), -67);
+        rest->put(F("uptime"), 3600);
+        rest->put(F("charging"), false);
+        rest->end_json_msg();
+    }
+};
+
+CalculatorResource calculator(F("calc"));
+SwitchResource power_switch;
+StaticSwitchResource static_switch;
+LegacyResource legacy("legacy");
+SensorResource sensor(F("sensor"));
+constexpr Route ROUTES[] PROGMEM = {{"switch", &power_switch}, {"static_switch", &static_switch}};
+
+#endif // bREST_BENCH_RESOURCES_H
@@ -0,0 +1,105 @@
+/*
+  Round trip of serial frames on host.
+
+  Encodes frames with bRESTFrames::write_frame() and decodes them with bRESTCobsDecoder: payloads around full COBS
+  blocks of 254 bytes, with and without zeros at block boundaries, then oversized and cut frames that must be
+  dropped and counted. Exit status is 1 if any frame differs:
+      ./build/frames
+*/
+#define MAX_SERIAL_FRAME_SIZE 1024
+
+#include <bREST.h>
+#include <bRESTSerialFrames.h>
+
+#include <vector>
+
+// Print that keeps encoded bytes
+struct FrameSink {
+    std::vector<uint8_t> bytes;
+
+    size_t write(uint8_t c) {
+        bytes.push_back(c);
+        return 1;
+    }
+};
+
+static std::vector<uint8_t> encode(uint8_t id, const std::vector<uint8_t>& payload) {
+    FrameSink sink;
+    bRESTFrameSegments segments;
+    segments.add(&id, SERIAL_FRAME_ID_SIZE);
+    segments.add(payload.data(), payload.size());
+    bRESTFrames::write_frame(sink, segments);
+    return sink.bytes;
+}
+
+/**
+ * @brief round_trip encode and decode one frame
+ * @return true if decoded frame is valid and carries id and payload
+ */
+static bool round_trip(uint8_t id, const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> encoded = encode(id, payload);
+    bRESTCobsDecoder decoder;
+    uint16_t length = 0;
+    for (size_t i = 0; i < encoded.size(); i++) {
+        if (encoded[i] == 0 && i + 1 != encoded.size())
+            return false;
+        length = decoder.feed(encoded[i]);
+    }
+
+    const uint8_t* frame = decoder.get_frame();
+    return length == SERIAL_FRAME_ID_SIZE + payload.size() + SERIAL_FRAME_CRC_SIZE &&
+           bRESTFrames::is_valid(frame, length) && frame[0] == id &&
+           0 == memcmp(frame + SERIAL_FRAME_ID_SIZE, payload.data(), payload.size());
+}
+
+int main() {
+    static const size_t ZERO_POSITIONS[] = {0, 1, 252, 253, 254, 255, 256, 507, 508, 509};
+    unsigned long frames = 0;
+    unsigned long mismatches = 0;
+
+    for (size_t length = 0; length <= 3 * 254 + 8; length++) {
+        std::vector<uint8_t> payload(length, 'a');
+        frames++;
+        if (!round_trip(1, payload))
+            mismatches++;
+
+        // id takes the first byte of frame, so payload zero at p is frame byte p + 1
+        for (size_t i = 0; i < sizeof(ZERO_POSITIONS) / sizeof(ZERO_POSITIONS[0]); i++) {
+            if (ZERO_POSITIONS[i] >= length)
+                continue;
+            std::vector<uint8_t> zeroed = payload;
+            zeroed[ZERO_POSITIONS[i]] = 0;
+            frames++;
+            if (!round_trip(2, zeroed))
+                mismatches++;
+        }
+
+        std::vector<uint8_t> zeros(length, 0);
+        frames++;
+        if (!round_trip(0, zeros))
+            mismatches++;
+    }
+
+    // oversized, cut and empty frames are dropped and counted. Delimiters between frames are not.
+    bRESTCobsDecoder decoder;
+    std::vector<uint8_t> oversized = encode(3, std::vector<uint8_t>(MAX_SERIAL_FRAME_SIZE, 'a'));
+    std::vector<uint8_t> cut = encode(4, std::vector<uint8_t>(300, 'a'));
+    cut.erase(cut.begin() + 100, cut.end() - 1);
+    std::vector<uint8_t> stream(1, 0);
+    stream.insert(stream.end(), oversized.begin(), oversized.end());
+    stream.insert(stream.end(), cut.begin(), cut.end());
+    stream.push_back(1);
+    stream.push_back(0);
+    stream.push_back(0);
+    uint16_t completed = 0;
+    for (size_t i = 0; i < stream.size(); i++) {
+        if (decoder.feed(stream[i]) != 0)
+            completed++;
+    }
+    frames += 3;
+    if (completed != 0 || decoder.get_dropped() != 3)
+        mismatches++;
+
+    printf("{\"frames\":%lu,\"mismatches\":%lu}\n", frames, mismatches);
+    return (0 == mismatches)? 0: 1;
+}
@@ -0,0 +1,192 @@
+/*
+  End-to-end loopback benchmark of host socket backend.
+
+  It serves bREST with bRESTShardedServer on an ephemeral port of 127.0.0.1. Client threads connect, send one request,
+  and read the response until the server closes connection. It reports throughput and latency percentiles as JSON:
+      ./build/loopback [num_workers] [num_clients] [requests_per_client] [corpus_file]
+  Without corpus file, clients send a short GET request.
+*/
+#include <bREST.h>
+#include <bRESTShardedServer.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <chrono>
+
+#include "bench_corpus.h"
+
+typedef std::chrono::steady_clock BenchClock;
+
+class CalculatorResource: public Observer {
+public:
+    CalculatorResource(const __FlashStringHelper* resource_id): Observer(resource_id) {}
+
+    bool is_concurrent() override {
+        return true;
+    }
+
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
+        float sum = 0;
+        for (int i = 0; i < parm_count; i++)
+            sum += atof(value[i]);
+
+        rest->start_json_msg();
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("sum"), sum);
+        rest->end_json_msg();
+    }
+};
+
+class SwitchResource: public Observer {
+public:
+    SwitchResource(const __FlashStringHelper* resource_id): Observer(resource_id) {
+        is_open = true;
+    }
+
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
+        int open_index = find_parm(parms, parm_count, "open");
+        if (HTTP_METHOD_PUT == method && open_index != -1)
+            is_open = (0 == strcmp(value[open_index], "true"));
+
+        rest->start_json_msg();
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("is_switch_open"), is_open);
+        rest->end_json_msg();
+    }
+
+protected:
+    bool is_open;
+};
+
+CalculatorResource calculator(F("calc"));
+SwitchResource power_switch(F("switch"));
+
+struct ClientResult {
+    std::vector<uint32_t> latency_ns;
+    size_t response_bytes;
+    unsigned long failures;
+};
+
+/**
+ * @brief exchange send one request over a new connection and read the response until close
+ * @param port server port
+ * @param request raw request
+ * @return response bytes. -1 if failed.
+ */
+static long exchange(uint16_t port, const std::string& request) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    // skip TIME_WAIT so that long runs do not run out of ephemeral ports
+    struct linger no_linger = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &no_linger, sizeof(no_linger));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    long total = -1;
+    if (0 == connect(fd, (struct sockaddr*)&address, sizeof(address))
+            && send(fd, request.data(), request.size(), MSG_NOSIGNAL) == (ssize_t)request.size()) {
+        char buffer[4096];
+        ssize_t n;
+        total = 0;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+            total += n;
+        if (n < 0 || 0 == total)
+            total = -1;
+    }
+    close(fd);
+    return total;
+}
+
+static void run_client(uint16_t port, const std::vector<std::string>* requests, unsigned long count,
+                       unsigned int client_index, ClientResult* result) {
+    result->latency_ns.reserve(count);
+    result->response_bytes = 0;
+    result->failures = 0;
+    for (unsigned long n = 0; n < count; n++) {
+        const std::string& request = (*requests)[(client_index + n) % requests->size()];
+        BenchClock::time_point start = BenchClock::now();
+        long bytes = exchange(port, request);
+        BenchClock::time_point end = BenchClock::now();
+        if (bytes < 0) {
+            result->failures++;
+            continue;
+        }
+        result->response_bytes += bytes;
+        result->latency_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+}
+
+static double percentile(const std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+int main(int argc, char* argv[]) {
+    unsigned int num_workers = (argc > 1)? atoi(argv[1]): 1;
+    unsigned int num_clients = (argc > 2)? atoi(argv[2]): 4;
+    unsigned long requests_per_client = (argc > 3)? strtoul(argv[3], NULL, 10): 5000;
+
+    BenchCorpus corpus;
+    if (argc > 4) {
+        if (!bench_load_corpus(argv[4], corpus)) {
+            fprintf(stderr, "No request found in %s\n", argv[4]);
+            return 1;
+        }
+    } else {
+        corpus.name = "default";
+        corpus.requests.push_back("GET /calc/?input1=1.2&input2=23 HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    }
+    if (0 == num_clients)
+        num_clients = 1;
+
+    bRESTShardedServer<> server(0, num_workers);
+    server.add_observer(&calculator);
+    server.add_observer(&power_switch);
+    if (!server.begin()) {
+        perror("bRESTShardedServer::begin");
+        return 1;
+    }
+
+    std::vector<ClientResult> results(num_clients);
+    std::vector<std::thread> clients;
+    BenchClock::time_point start = BenchClock::now();
+    for (unsigned int i = 0; i < num_clients; i++)
+        clients.push_back(std::thread(run_client, server.get_port(), &corpus.requests, requests_per_client, i, &results[i]));
+    for (size_t i = 0; i < clients.size(); i++)
+        clients[i].join();
+    double elapsed_s = std::chrono::duration<double>(BenchClock::now() - start).count();
+    server.end();
+
+    std::vector<uint32_t> latency_ns;
+    size_t response_bytes = 0;
+    unsigned long failures = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        latency_ns.insert(latency_ns.end(), results[i].latency_ns.begin(), results[i].latency_ns.end());
+        response_bytes += results[i].response_bytes;
+        failures += results[i].failures;
+    }
+    std::sort(latency_ns.begin(), latency_ns.end());
+
+    printf("{\n  \"corpus\":\"%s\",\n  \"workers\":%u,\n  \"clients\":%u,\n  \"requests\":%lu,\n  \"failures\":%lu,\n"
+           "  \"requests_per_sec\":%.0f,\n  \"response_bytes_per_sec\":%.0f,\n"
+           "  \"latency_us\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"max\":%.1f}\n}\n",
+           corpus.name.c_str(), server.get_num_workers(), num_clients, (unsigned long)latency_ns.size(), failures,
+           latency_ns.size() / elapsed_s, response_bytes / elapsed_s,
+           percentile(latency_ns, 0.5) / 1000, percentile(latency_ns, 0.9) / 1000,
+           percentile(latency_ns, 0.99) / 1000, percentile(latency_ns, 1.0) / 1000);
+    return (0 == failures)? 0: 1;
+}
@@ -0,0 +1,114 @@
+/*
+  Capture requests and replay them deterministically on host.
+
+  Replay captures and compare responses and timing. Exit status is 1 if any response differs, so that committed
+  captures serve as regression suite:
+      ./build/replay [--recorded] [--verbose] bench/captures/short_get.json bench/captures/junk.json
+  Capture a request corpus through bREST::handle(), optionally split into TCP segments of N bytes:
+      ./build/replay --capture bench/corpus/short_get.txt [--segment N] > capture.json
+  Captures of a device, downloaded from GET /_capture, replay the same way if this tool serves the same resources.
+*/
+#define BREST_CAPTURE 1
+#define MAX_CAPTURE_BYTES 32768
+
+#include <bREST.h>
+#include <bRESTReplay.h>
+
+#include "bench_corpus.h"
+#include "bench_resources.h"
+
+static int capture(const char* path, size_t segment_size) {
+    BenchCorpus corpus;
+    if (!bench_load_corpus(path, corpus)) {
+        fprintf(stderr, "No request found in %s\n", path);
+        return 1;
+    }
+
+    static bRESTInstance<> rest;
+    rest.set_route_table(BREST_ROUTE_TABLE(ROUTES));
+    rest.add_observer(&calculator);
+    rest.add_observer(&legacy);
+
+    BenchClient client;
+    client.segment_size = segment_size;
+    for (size_t i = 0; i < corpus.requests.size(); i++) {
+        client.set_request(corpus.requests[i]);
+        rest.handle(client);
+    }
+
+    bRESTCapture& capture = bRESTCapture::instance();
+    if (capture.get_dropped() != 0)
+        fprintf(stderr, "%u requests are dropped. Raise MAX_CAPTURE_BYTES.\n", (unsigned int)capture.get_dropped());
+    capture.dump(Serial);
+    Serial.flush();
+    return 0;
+}
+
+static int replay(const std::vector<const char*>& paths, bool recorded_speed, bool verbose) {
+    static bRESTReplay<> rest;
+    rest.set_route_table(BREST_ROUTE_TABLE(ROUTES));
+    rest.add_observer(&calculator);
+    rest.add_observer(&legacy);
+
+    unsigned long mismatches = 0;
+    printf("{\n  \"speed\":\"%s\",\n  \"captures\":[", recorded_speed? "recorded": "max");
+    for (size_t i = 0; i < paths.size(); i++) {
+        std::vector<bRESTCapturedRequest> requests;
+        if (!brest_load_capture(paths[i], requests)) {
+            fprintf(stderr, "Malformed capture %s\n", paths[i]);
+            return 1;
+        }
+
+        std::vector<bRESTReplayResult> results;
+        bRESTReplaySummary summary = rest.replay_all(requests, recorded_speed, &results);
+        mismatches += summary.mismatches;
+
+        printf("%s\n    {\"path\":\"%s\",\"requests\":%lu,\"mismatches\":%lu,"
+               "\"recorded_us_per_request\":%.1f,\"replay_us_per_request\":%.1f",
+               (0 == i)? "": ",", paths[i], summary.requests, summary.mismatches,
+               (double)summary.recorded_duration / summary.requests, (double)summary.replay_duration / summary.requests);
+        if (verbose) {
+            printf(",\"results\":[");
+            for (size_t j = 0; j < results.size(); j++) {
+                printf("%s\n      {\"match\":%s,\"length\":%u,\"crc\":\"%08x\",\"recorded_us\":%u,\"replay_us\":%u}",
+                       (0 == j)? "": ",", results[j].match? "true": "false",
+                       (unsigned int)results[j].response_length, (unsigned int)results[j].response_crc,
+                       (unsigned int)results[j].recorded_duration, (unsigned int)results[j].replay_duration);
+            }
+            printf("]");
+        }
+        printf("}");
+    }
+    printf("\n  ],\n  \"mismatches\":%lu\n}\n", mismatches);
+    return (0 == mismatches)? 0: 1;
+}
+
+int main(int argc, char* argv[]) {
+    const char* capture_path = NULL;
+    size_t segment_size = 0;
+    bool recorded_speed = false;
+    bool verbose = false;
+    std::vector<const char*> paths;
+
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "--capture") && i + 1 < argc)
+            capture_path = argv[++i];
+        else if (0 == strcmp(argv[i], "--segment") && i + 1 < argc)
+            segment_size = strtoul(argv[++i], NULL, 10);
+        else if (0 == strcmp(argv[i], "--recorded"))
+            recorded_speed = true;
+        else if (0 == strcmp(argv[i], "--verbose"))
+            verbose = true;
+        else
+            paths.push_back(argv[i]);
+    }
+
+    if (capture_path != NULL)
+        return capture(capture_path, segment_size);
+    if (paths.empty()) {
+        fprintf(stderr, "Usage: %s [--recorded] [--verbose] capture.json...\n"
+                        "       %s --capture corpus.txt [--segment N]\n", argv[0], argv[0]);
+        return 2;
+    }
+    return replay(paths, recorded_speed, verbose);
+}
@@ -0,0 +1,60 @@
+/*
+  The RESTful calculator of example 1, served natively on Linux.
+
+  Build with make in extras/host, then:
+      ./build/calculator 8080
+      curl 'http://localhost:8080/calc/?input1=1.2&input2=23&input3=-2'
+*/
+#include <bREST.h>
+#include <bRESTHostServer.h>
+
+// Step1: Define customized resource by inheriting Observer
+//        Override call back method on_request()
+class CalculatorResource: public Observer {
+public:
+    CalculatorResource(const __FlashStringHelper* resource_id): Observer(resource_id) {}
+    virtual ~CalculatorResource(){}
+    // override call back function
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
+        float sum = 0;
+        // Iterate parameter array and value array
+        for (int i = 0; i < parm_count; i++)
+            sum += atof(value[i]);
+
+        // Send back JSON message to client.
+        rest->start_json_msg();
+        rest->append_key_value_pair_to_json(F("message"), F("CalculatorResource get fire up!"));
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("sum"), sum);
+        rest->end_json_msg();
+    }
+};
+
+// Step 2: Allocate resource with unique ID
+CalculatorResource calculator(F("calc"));
+// Create bREST instance
+bRESTInstance<> rest;
+
+int main(int argc, char* argv[]) {
+    uint16_t port = (argc > 1)? atoi(argv[1]): 8080;
+
+    // Step 3: Add observer
+    rest.add_observer(&calculator);
+
+    bRESTHostServer server(rest, port);
+    if (!server.begin()) {
+        perror("bRESTHostServer::begin");
+        return 1;
+    }
+    Serial.print(F("Listening on port "));
+    Serial.println(server.get_port());
+    Serial.flush();
+
+    while (server.loop() >= 0)
+        ;
+
+    perror("bRESTHostServer::loop");
+    return 1;
+}
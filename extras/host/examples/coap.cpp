@@ -0,0 +1,67 @@
+/*
+  The smart power plug, served over CoAP on Linux.
+
+  Each request is one UDP datagram, answered with a piggybacked acknowledgement:
+      ./build/coap 5683
+      coap-client -m get coap://localhost/switch
+      coap-client -m get -A 60 coap://localhost/switch
+      coap-client -m put 'coap://localhost/switch?open=false'
+*/
+#include <errno.h>
+#include <poll.h>
+
+#include <bREST.h>
+#include <bRESTCoap.h>
+#include <bRESTHostUdp.h>
+
+bRESTInstance<> rest;
+
+class PowerPlug: public Observer {
+public:
+    PowerPlug(const __FlashStringHelper* resource_id): Observer(resource_id) {
+        this->isPowerPlugOpen = true;
+    }
+
+    virtual ~PowerPlug(){}
+
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
+        int open_index = find_parm(parms, parm_count, "open");
+        if (HTTP_METHOD_PUT == method && open_index != -1)
+            isPowerPlugOpen = (0 == strcmp(value[open_index], "true"));
+
+        rest->start_json_msg();
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("is_switch_open"), isPowerPlugOpen);
+        rest->end_json_msg();
+    }
+
+protected:
+    bool isPowerPlugOpen;
+};
+
+const char SWITCH_ID[] PROGMEM = "switch";
+PowerPlug powerPlug(FPSTR(SWITCH_ID));
+
+int main(int argc, char* argv[]) {
+    uint16_t port = (argc > 1)? atoi(argv[1]): COAP_DEFAULT_PORT;
+
+    rest.add_observer(&powerPlug);
+
+    bRESTHostUdp udp;
+    bRESTCoap<bRESTHostUdp> coap(rest, udp);
+    if (!coap.begin(port)) {
+        perror("bRESTCoap::begin");
+        return 1;
+    }
+    Serial.print(F("Listening on UDP port "));
+    Serial.println(udp.get_port());
+    Serial.flush();
+
+    struct pollfd readable = {udp.get_fd(), POLLIN, 0};
+    while (poll(&readable, 1, -1) >= 0 || EINTR == errno)
+        coap.poll();
+
+    perror("poll");
+    return 1;
+}
@@ -0,0 +1,93 @@
+/*
+  The smart power plug of example 2, served natively on Linux with Server-Sent Events.
+
+  A simulated button toggles the switch every few seconds. Subscribers are pushed the new state instead of polling:
+      ./build/power_plug 8080 5000
+      curl -N 'http://localhost:8080/switch/?stream=1'
+      curl -X PUT 'http://localhost:8080/switch/?open=false'
+*/
+#include <bREST.h>
+#include <bRESTHostServer.h>
+
+bRESTInstance<> rest;
+
+class PowerPlug: public Observer {
+public:
+    PowerPlug(const __FlashStringHelper* resource_id): Observer(resource_id) {
+        this->isPowerPlugOpen = true;
+    }
+
+    virtual ~PowerPlug(){}
+
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
+        int open_index = find_parm(parms, parm_count, "open");
+        if (HTTP_METHOD_PUT == method) {
+            if (open_index != -1 && 0 == strcmp(value[open_index], "true"))
+                openSwitch();
+            else if (open_index != -1 && 0 == strcmp(value[open_index], "false"))
+                closeSwitch();
+        }
+
+        rest->start_json_msg();
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("is_switch_open"), isSwitchOpen());
+        rest->end_json_msg();
+    }
+
+    // simulated button press
+    void toggleSwitch() {
+        if (isSwitchOpen())
+            closeSwitch();
+        else
+            openSwitch();
+    }
+
+    void openSwitch() {
+        isPowerPlugOpen = true;
+        rest.notify_change(this);
+    }
+
+    void closeSwitch() {
+        isPowerPlugOpen = false;
+        rest.notify_change(this);
+    }
+
+    bool isSwitchOpen() {
+        return isPowerPlugOpen;
+    }
+
+protected:
+    bool isPowerPlugOpen;
+};
+
+const char SWITCH_ID[] PROGMEM = "switch";
+PowerPlug powerPlug(FPSTR(SWITCH_ID));
+
+int main(int argc, char* argv[]) {
+    uint16_t port = (argc > 1)? atoi(argv[1]): 8080;
+    unsigned long toggle_period = (argc > 2)? strtoul(argv[2], NULL, 10): 5000;
+
+    rest.add_observer(&powerPlug);
+
+    bRESTHostServer server(rest, port);
+    if (!server.begin()) {
+        perror("bRESTHostServer::begin");
+        return 1;
+    }
+    Serial.print(F("Listening on port "));
+    Serial.println(server.get_port());
+    Serial.flush();
+
+    unsigned long last_toggle = millis();
+    // wake up periodically to press button and push events
+    while (server.loop(100) >= 0) {
+        if (toggle_period != 0 && millis() - last_toggle >= toggle_period) {
+            powerPlug.toggleSwitch();
+            last_toggle = millis();
+        }
+    }
+
+    perror("bRESTHostServer::loop");
+    return 1;
+}
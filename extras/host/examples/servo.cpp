@@ -0,0 +1,74 @@
+/*
+  A simulated servo, controlled over WebSocket on Linux.
+
+  Each WebSocket message is a compact request, and each response comes back as one message:
+      ./build/servo 8080
+      websocat ws://localhost:8080/
+      PUT servo1 angle=120
+      {"code":200,"angle":120}
+  Plain HTTP requests are served as usual:
+      curl 'http://localhost:8080/servo1/?angle=45' -X PUT
+*/
+#include <bREST.h>
+#include <bRESTHostServer.h>
+
+bRESTInstance<> rest;
+
+class Servo: public Observer {
+public:
+    Servo(const __FlashStringHelper* resource_id): Observer(resource_id) {
+        this->angle = 90;
+    }
+
+    virtual ~Servo(){}
+
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
+        int angle_index = find_parm(parms, parm_count, "angle");
+        if (HTTP_METHOD_PUT == method && angle_index != -1) {
+            int new_angle = atoi(value[angle_index]);
+            if (new_angle < 0 || new_angle > 180) {
+                rest->start_json_msg();
+                rest->append_key_value_pair_to_json(F("code"), CODE_ERROR_INVALID_COMMAND);
+                rest->append_comma_to_json();
+                rest->append_key_value_pair_to_json(F("message"), F("angle is out of range 0-180"));
+                rest->end_json_msg();
+                return;
+            }
+            angle = new_angle;
+        }
+
+        rest->start_json_msg();
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("angle"), angle);
+        rest->end_json_msg();
+    }
+
+protected:
+    int angle;
+};
+
+const char SERVO_ID[] PROGMEM = "servo1";
+Servo servo(FPSTR(SERVO_ID));
+
+int main(int argc, char* argv[]) {
+    uint16_t port = (argc > 1)? atoi(argv[1]): 8080;
+
+    rest.add_observer(&servo);
+
+    bRESTHostServer server(rest, port);
+    if (!server.begin()) {
+        perror("bRESTHostServer::begin");
+        return 1;
+    }
+    Serial.print(F("Listening on port "));
+    Serial.println(server.get_port());
+    Serial.flush();
+
+    // WebSocket messages wake up epoll, too
+    while (server.loop() >= 0)
+        ;
+
+    perror("bRESTHostServer::loop");
+    return 1;
+}
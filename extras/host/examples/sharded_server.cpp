@@ -0,0 +1,82 @@
+/*
+  Serve bREST with one worker thread per CPU on Linux host.
+
+  Build with make in extras/host, then:
+      ./build/sharded_server 8080 4
+      curl 'http://localhost:8080/calc/?input1=1.2&input2=23'
+      curl -X PUT 'http://localhost:8080/counter/?add=5'
+*/
+#include <bREST.h>
+#include <bRESTShardedServer.h>
+
+// Stateless resource. Its call backs may run on all workers at the same time.
+class CalculatorResource: public Observer {
+public:
+    CalculatorResource(const __FlashStringHelper* resource_id): Observer(resource_id) {}
+    virtual ~CalculatorResource(){}
+
+    bool is_concurrent() override {
+        return true;
+    }
+
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
+        float sum = 0;
+        for (int i = 0; i < parm_count; i++)
+            sum += atof(value[i]);
+
+        rest->start_json_msg();
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("sum"), sum);
+        rest->end_json_msg();
+    }
+};
+
+// Stateful resource. Its call backs are serialized across workers, so count needs no lock.
+class CounterResource: public Observer {
+public:
+    CounterResource(const __FlashStringHelper* resource_id): Observer(resource_id) {
+        count = 0;
+    }
+    virtual ~CounterResource(){}
+
+    void on_request(HTTP_METHOD method, char* parms[], char* value[], int parm_count, bREST* rest) override {
+        int add_index = find_parm(parms, parm_count, "add");
+        if (HTTP_METHOD_PUT == method && add_index != -1)
+            count += atol(value[add_index]);
+
+        rest->start_json_msg();
+        rest->append_key_value_pair_to_json(F("code"), CODE_OK);
+        rest->append_comma_to_json();
+        rest->append_key_value_pair_to_json(F("count"), count);
+        rest->end_json_msg();
+    }
+
+protected:
+    int count;
+};
+
+CalculatorResource calculator(F("calc"));
+CounterResource counter(F("counter"));
+
+int main(int argc, char* argv[]) {
+    uint16_t port = (argc > 1)? atoi(argv[1]): 8080;
+    unsigned int num_workers = (argc > 2)? atoi(argv[2]): 0;
+
+    bRESTShardedServer<> server(port, num_workers);
+    server.add_observer(&calculator);
+    server.add_observer(&counter);
+    if (!server.begin()) {
+        perror("bRESTShardedServer::begin");
+        return 1;
+    }
+
+    Serial.print(F("Listening on port "));
+    Serial.print(server.get_port());
+    Serial.print(F(" with workers "));
+    Serial.println(server.get_num_workers());
+    Serial.flush();
+
+    server.join();
+    return 0;
+}